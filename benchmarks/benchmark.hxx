@@ -0,0 +1,61 @@
+#ifndef REPLXX_BENCHMARK_HXX_INCLUDED
+#define REPLXX_BENCHMARK_HXX_INCLUDED 1
+
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+namespace replxx {
+
+namespace benchmark {
+
+class Stopwatch {
+	typedef std::chrono::steady_clock clock_t;
+	clock_t::time_point _start;
+public:
+	Stopwatch( void )
+		: _start( clock_t::now() ) {
+	}
+	void reset( void ) {
+		_start = clock_t::now();
+	}
+	double elapsed_ms( void ) const {
+		return ( std::chrono::duration<double, std::milli>( clock_t::now() - _start ).count() );
+	}
+};
+
+inline bool selected( int argc_, char** argv_, char const* name_ ) {
+	if ( argc_ < 2 ) {
+		return ( true );
+	}
+	for ( int i( 1 ); i < argc_; ++ i ) {
+		if ( strcmp( argv_[i], name_ ) == 0 ) {
+			return ( true );
+		}
+	}
+	return ( false );
+}
+
+inline void report( char const* name_, char const* variant_, long long size_, int repeat_, double ms_ ) {
+	printf(
+		"%-16s %-16s size=%-9lld runs=%-6d total=%10.3f ms  per-run=%10.3f us\n",
+		name_, variant_, size_, repeat_, ms_, 1000. * ms_ / repeat_
+	);
+	fflush( stdout );
+}
+
+/* Deterministic, shell-like history lines. */
+inline std::string sample_line( int no_ ) {
+	static char const* verbs[] = { "git commit -m", "ls -la", "make -j8", "grep -rn", "cd", "ssh", "docker run", "vim" };
+	static char const* nouns[] = { "src/history.cxx", "build", "include/replxx.hxx", "/tmp", "host-", "image:", "README.md", "tests.py" };
+	std::string line( verbs[no_ % 8] );
+	line.append( " " ).append( nouns[( no_ / 8 ) % 8] ).append( std::to_string( no_ ) );
+	return ( line );
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,581 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#include "history.hxx"
+#include "historywriter.hxx"
+#include "unicodestring.hxx"
+#include "benchmark.hxx"
+
+using namespace replxx;
+using namespace replxx::benchmark;
+
+namespace {
+
+char const historyFile[] = "./replxx_benchmark_history.txt";
+char const binaryFile[] = "./replxx_benchmark_history.bin";
+
+/*
+ * Simulate a shell that saves its history after every command
+ * to compare full rewrite with append-only persistence.
+ */
+void benchmark_save( void ) {
+	int const commands( 100 );
+	for ( int size : { 1000, 10000, 100000 } ) {
+		for ( bool appendOnly : { false, true } ) {
+			History h;
+			h.set_max_size( size );
+			h.set_append_only( appendOnly );
+			for ( int i( 0 ); i < size; ++ i ) {
+				h.add( sample_line( i ) );
+			}
+			h.save( historyFile );
+			Stopwatch sw;
+			for ( int i( 0 ); i < commands; ++ i ) {
+				h.add( sample_line( size + i ) );
+				h.save( historyFile );
+			}
+			report( "save", appendOnly ? "append-only" : "full-rewrite", size, commands, sw.elapsed_ms() );
+		}
+		/* time spent on the caller's thread only */
+		History h;
+		h.set_max_size( size );
+		HistoryWriter writer( historyFile, 1000 );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( i ) );
+		}
+		Stopwatch sw;
+		for ( int i( 0 ); i < commands; ++ i ) {
+			std::string line( sample_line( size + i ) );
+			h.add( line );
+			writer.append( line.data(), static_cast<int>( line.length() ) );
+		}
+		report( "save", "background", size, commands, sw.elapsed_ms() );
+		writer.sync();
+	}
+	remove( historyFile );
+}
+
+/*
+ * Cost of adding a line to a history that is already full.
+ */
+void benchmark_add( void ) {
+	int const adds( 100000 );
+	for ( int size : { 1000, 100000, 1000000 } ) {
+		History h;
+		h.set_max_size( size );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( i ) );
+		}
+		std::vector<std::string> lines;
+		for ( int i( 0 ); i < adds; ++ i ) {
+			lines.push_back( sample_line( size + i ) );
+		}
+		Stopwatch sw;
+		for ( std::string const& l : lines ) {
+			h.add( l );
+		}
+		report( "add", "at-capacity", size, adds, sw.elapsed_ms() );
+	}
+}
+
+/*
+ * Adding lines to a full history of 1M entries with and without
+ * duplicate elimination, for brand new lines, for re-entered recent
+ * commands and for lines re-entered from anywhere in history.
+ */
+void benchmark_unique( void ) {
+	int const size( 1000000 );
+	int const adds( 100000 );
+	for ( bool unique : { false, true } ) {
+		History h;
+		h.set_max_size( size );
+		h.set_unique( unique );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( i ) );
+		}
+		char const* workloads[] = { "fresh", "recent", "anywhere" };
+		int next( size );
+		for ( char const* workload : workloads ) {
+			std::vector<std::string> lines;
+			for ( int i( 0 ); i < adds; ++ i ) {
+				int no( next + i );
+				if ( workload[0] == 'r' ) {
+					no = next - 1 - ( i * 7 ) % 100;
+				} else if ( workload[0] == 'a' ) {
+					no = next - 1 - static_cast<int>( ( i * 2654435761ULL ) % static_cast<unsigned long long>( size / 2 ) );
+				}
+				lines.push_back( sample_line( no ) );
+			}
+			if ( workload[0] == 'f' ) {
+				next += adds;
+			}
+			Stopwatch sw;
+			for ( std::string const& l : lines ) {
+				h.add( l );
+			}
+			std::string variant( unique ? "unique/" : "default/" );
+			variant.append( workload );
+			report( "unique", variant.c_str(), size, adds, sw.elapsed_ms() );
+		}
+	}
+}
+
+/*
+ * Memory needed to hold the history, compared with an estimate
+ * of what one heap allocated std::string per line costs.
+ */
+void benchmark_memory( void ) {
+	for ( int size : { 10000, 100000, 1000000 } ) {
+		Stopwatch sw;
+		History h;
+		h.set_max_size( size );
+		long long stringBytes( 0 );
+		for ( int i( 0 ); i < size; ++ i ) {
+			std::string line( sample_line( i ) );
+			stringBytes += static_cast<long long>( sizeof ( std::string ) );
+			if ( line.length() >= sizeof ( std::string ) - sizeof ( char* ) ) {
+				stringBytes += static_cast<long long>( line.length() + 1 );
+			}
+			h.add( line );
+		}
+		report( "fill", "arena", size, size, sw.elapsed_ms() );
+		printf(
+			"memory           arena            size=%-9d total=%10lld B   per-entry=%7.2f B (std::string estimate %7.2f B)\n",
+			size, h.memory_usage(), static_cast<double>( h.memory_usage() ) / h.size(),
+			static_cast<double>( stringBytes ) / size
+		);
+	}
+}
+
+/*
+ * Startup cost of loading a history file, the line by line
+ * std::getline() loader used before serves as the reference.
+ */
+void load_getline( History& h_, char const* file_ ) {
+	std::ifstream f( file_ );
+	std::string line;
+	while ( getline( f, line ).good() ) {
+		std::string::size_type eol( line.find_first_of( "\r\n" ) );
+		if ( eol != std::string::npos ) {
+			line.erase( eol );
+		}
+		if ( ! line.empty() ) {
+			h_.add( line );
+		}
+	}
+}
+
+void benchmark_load( void ) {
+	for ( int size : { 10000, 100000, 1000000 } ) {
+		{
+			std::ofstream f( historyFile );
+			for ( int i( 0 ); i < size; ++ i ) {
+				f << sample_line( i ) << '\n';
+			}
+		}
+		{
+			History h;
+			h.set_max_size( size );
+			h.load( historyFile );
+			h.set_binary( true );
+			h.save( binaryFile );
+		}
+		for ( int maxSize : { 1000, size } ) {
+			int const repeat( size >= 1000000 ? 3 : 10 );
+			Stopwatch sw;
+			for ( int i( 0 ); i < repeat; ++ i ) {
+				History h;
+				h.set_max_size( maxSize );
+				load_getline( h, historyFile );
+			}
+			report( "load", maxSize < size ? "getline/1000" : "getline/all", size, repeat, sw.elapsed_ms() );
+			sw.reset();
+			for ( int i( 0 ); i < repeat; ++ i ) {
+				History h;
+				h.set_max_size( maxSize );
+				h.load( historyFile );
+			}
+			report( "load", maxSize < size ? "mmap/1000" : "mmap/all", size, repeat, sw.elapsed_ms() );
+			sw.reset();
+			for ( int i( 0 ); i < repeat; ++ i ) {
+				History h;
+				h.set_max_size( maxSize );
+				h.load( binaryFile );
+			}
+			report( "load", maxSize < size ? "binary/1000" : "binary/all", size, repeat, sw.elapsed_ms() );
+			/* time until the prompt is usable, the rest is loaded in background */
+			double lazy( 0 );
+			for ( int i( 0 ); i < repeat; ++ i ) {
+				History h;
+				h.set_max_size( maxSize );
+				h.set_lazy_load( 100 );
+				sw.reset();
+				h.load( historyFile );
+				lazy += sw.elapsed_ms();
+				h.absorb_loaded( true );
+			}
+			report( "load", maxSize < size ? "lazy/1000" : "lazy/all", size, repeat, lazy );
+		}
+	}
+	remove( historyFile );
+	remove( binaryFile );
+}
+
+/*
+ * Memory saved by keeping older entries compressed, against the time
+ * it costs to reach them: browsing back through the oldest entries,
+ * a short needle search (no index) that scans whole history,
+ * and saving in binary format.
+ */
+void benchmark_compression( void ) {
+	int const steps( 2000 );
+	int const lookups( 5 );
+	for ( int size : { 100000, 1000000 } ) {
+		for ( bool compressed : { false, true } ) {
+			char const* variant( compressed ? "compressed" : "plain" );
+			History h;
+			h.set_max_size( size );
+			h.set_compression( compressed );
+			Stopwatch sw;
+			for ( int i( 0 ); i < size; ++ i ) {
+				h.add( sample_line( i ) );
+			}
+			report( "compression", compressed ? "fill-compressed" : "fill-plain", size, size, sw.elapsed_ms() );
+			printf(
+				"memory           %-16s size=%-9d total=%10lld B   per-entry=%7.2f B\n",
+				variant, size, h.memory_usage(), static_cast<double>( h.memory_usage() ) / h.size()
+			);
+			sw.reset();
+			long long bytes( 0 );
+			for ( int i( 0 ); i < steps; ++ i ) {
+				bytes += static_cast<long long>( strlen( h.line( i ) ) );
+			}
+			report( "compression", compressed ? "browse-old-c" : "browse-old", size, steps, sw.elapsed_ms() );
+			sw.reset();
+			int found( 0 );
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				found += h.find( "~", 1, h.size() - 1 - i, -1 );
+			}
+			report( "compression", compressed ? "scan-c" : "scan", size, lookups, sw.elapsed_ms() );
+			sw.reset();
+			h.set_binary( true );
+			h.save( binaryFile );
+			report( "compression", compressed ? "save-binary-c" : "save-binary", size, 1, sw.elapsed_ms() );
+			std::ifstream f( binaryFile, std::ios::binary | std::ios::ate );
+			printf( "file             %-16s size=%-9d total=%10lld B\n", variant, size, static_cast<long long>( f.tellg() ) );
+			if ( ( found != -lookups ) || ( bytes == 0 ) ) {
+				printf( "unexpected results!\n" );
+			}
+		}
+	}
+	remove( binaryFile );
+}
+
+/*
+ * Ctrl-R style lookup of the nearest older entry containing given text,
+ * the linear variant converts every visited entry to UTF-32 as the
+ * search loop used to.
+ */
+void benchmark_search( void ) {
+	int const lookups( 20 );
+	char const* needles[] = { "README", "host-7", "make -j8 /tmp", "no such command" };
+	for ( int size : { 10000, 100000, 1000000 } ) {
+		History h;
+		h.set_max_size( size );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( i ) );
+		}
+		Stopwatch build;
+		h.find( "build", 5, h.size() - 1, -1 );
+		report( "search", "index-build", size, 1, build.elapsed_ms() );
+		for ( char const* needle : needles ) {
+			UnicodeString text( needle );
+			Stopwatch sw;
+			int found( 0 );
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				UnicodeString line;
+				int idx( h.size() - 1 - i * 17 );
+				for ( ; idx >= 0; -- idx ) {
+					line.assign( h.line( idx ) );
+					if ( std::search( line.begin(), line.end(), text.begin(), text.end() ) != line.end() ) {
+						break;
+					}
+				}
+				found += idx;
+			}
+			report( "search", "linear", size, lookups, sw.elapsed_ms() );
+			sw.reset();
+			int indexed( 0 );
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				indexed += h.find( needle, static_cast<int>( strlen( needle ) ), h.size() - 1 - i * 17, -1 );
+			}
+			report( "search", needle, size, lookups, sw.elapsed_ms() );
+			if ( indexed != found ) {
+				printf( "search results differ!\n" );
+			}
+		}
+	}
+}
+
+/*
+ * Meta-P lookups of the nearest older entry with given prefix, compared
+ * with the circular strncmp() scan common_prefix_search() used to do.
+ */
+void benchmark_prefix( void ) {
+	int const lookups( 20 );
+	char const* prefixes[] = { "vim", "ssh host-1", "docker run image:99", "no such command" };
+	for ( int size : { 10000, 100000, 1000000 } ) {
+		History h;
+		h.set_max_size( size );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( i ) );
+		}
+		Stopwatch build;
+		h.reset_pos();
+		h.common_prefix_search( "x", 1, true );
+		report( "prefix", "index-build", size, 1, build.elapsed_ms() );
+		for ( char const* prefix : prefixes ) {
+			int prefixSize( static_cast<int>( strlen( prefix ) ) );
+			int found( 0 );
+			Stopwatch sw;
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				int from( h.size() - 1 - i * 17 );
+				int idx( from - 1 );
+				for ( ; idx != from; idx = ( idx + h.size() - 1 ) % h.size() ) {
+					if ( ( strncmp( prefix, h.line( idx ), prefixSize ) == 0 ) && ( strcmp( prefix, h.line( idx ) ) != 0 ) ) {
+						break;
+					}
+				}
+				found += idx;
+			}
+			report( "prefix", "linear", size, lookups, sw.elapsed_ms() );
+			int indexed( 0 );
+			sw.reset();
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				h.reset_pos( h.size() - 1 - i * 17 );
+				h.common_prefix_search( prefix, prefixSize, true );
+				indexed += h.current_pos();
+			}
+			report( "prefix", prefix, size, lookups, sw.elapsed_ms() );
+			if ( indexed != found ) {
+				printf( "prefix search results differ!\n" );
+			}
+		}
+	}
+}
+
+/*
+ * Ctrl-R and Meta-P style lookups scanning the whole history in parallel,
+ * with 1 to N threads, against the indexed search.  Needles either do
+ * not occur at all or only in the oldest entry, the worst case for a scan.
+ */
+void benchmark_scaling( void ) {
+	int const size( 2000000 );
+	int const lookups( 5 );
+	History h;
+	h.set_max_size( size );
+	h.add( "oldest entry" );
+	for ( int i( 1 ); i < size; ++ i ) {
+		h.add( sample_line( i ) );
+	}
+	int cores( std::max( 1, static_cast<int>( std::thread::hardware_concurrency() ) ) );
+	std::vector<int> threads( 1, 0 );
+	for ( int t( 1 ); t < cores; t *= 2 ) {
+		threads.push_back( t );
+	}
+	threads.push_back( cores );
+	for ( int t : threads ) {
+		h.set_search_threads( t );
+		char variant[32];
+		snprintf( variant, sizeof ( variant ), t > 0 ? "threads=%d" : "indexed", t );
+		Stopwatch sw;
+		int found( 0 );
+		for ( int i( 0 ); i < lookups; ++ i ) {
+			found += h.find( "oldest", 6, h.size() - 1, -1 );
+			found += h.find( "no such command", 15, h.size() - 1, -1 );
+		}
+		report( "scaling/find", variant, size, lookups * 2, sw.elapsed_ms() );
+		sw.reset();
+		for ( int i( 0 ); i < lookups; ++ i ) {
+			found += h.find( "q", 1, h.size() - 1, -1 );
+		}
+		report( "scaling/short", variant, size, lookups, sw.elapsed_ms() );
+		sw.reset();
+		for ( int i( 0 ); i < lookups; ++ i ) {
+			h.reset_pos();
+			h.common_prefix_search( "oldest", 6, true );
+			found += h.current_pos();
+		}
+		report( "scaling/prefix", variant, size, lookups, sw.elapsed_ms() );
+		if ( found != lookups * -2 ) {
+			printf( "unexpected results!\n" );
+		}
+	}
+}
+
+/*
+ * Up/Down through the most recent entries and back, as history_move()
+ * does it: every step gets UTF-32 form and width of an entry.
+ */
+void benchmark_recall( void ) {
+	int const steps( 2000 );
+	for ( int length : { 80, 1000, 8000 } ) {
+		History h;
+		h.set_max_size( 1000 );
+		for ( int i( 0 ); i < 1000; ++ i ) {
+			std::string line( sample_line( i ) );
+			while ( static_cast<int>( line.length() ) < length ) {
+				line.append( " \xc5\xbc\xc3\xb3\xc5\x82w " ).append( sample_line( i + static_cast<int>( line.length() ) ) );
+			}
+			h.add( line );
+		}
+		for ( long long budget : { 0LL, 1LL << 20 } ) {
+			h.set_decoded_cache_budget( budget );
+			UnicodeString data;
+			long long width( 0 );
+			Stopwatch sw;
+			for ( int i( 0 ); i < steps; ++ i ) {
+				/* wander up and down over the last 20 entries */
+				History::Decoded const& d( h.decoded( h.size() - 1 - ( i % 40 < 20 ? i % 20 : 19 - i % 20 ) ) );
+				data.assign( d._text );
+				width += d.widths().column( d.widths().length() );
+			}
+			report( "recall", budget > 0 ? "cached" : "uncached", length, steps, sw.elapsed_ms() );
+			if ( width == 0 ) {
+				printf( "no width!\n" );
+			}
+		}
+	}
+}
+
+/*
+ * Top four hints by frecency for a prefix, the linear variant rescans
+ * the whole history counting uses the way a hint callback had to.
+ */
+void benchmark_hints( void ) {
+	int const lookups( 20 );
+	int const hints( 4 );
+	char const* prefixes[] = { "g", "vim", "ssh host-1", "no such command" };
+	for ( int size : { 10000, 100000, 1000000 } ) {
+		History h;
+		h.set_max_size( size );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( ( i * 7 ) % ( size / 10 ) ) );
+		}
+		Stopwatch build;
+		h.set_frecency( true );
+		report( "hints", "index-build", size, 1, build.elapsed_ms() );
+		for ( char const* prefix : prefixes ) {
+			int prefixSize( static_cast<int>( strlen( prefix ) ) );
+			Stopwatch sw;
+			int found( 0 );
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				std::unordered_map<std::string, int> counts;
+				for ( int idx( 0 ); idx < h.size(); ++ idx ) {
+					if ( ( h.line_length( idx ) > prefixSize ) && ( strncmp( prefix, h.line( idx ), prefixSize ) == 0 ) ) {
+						++ counts[std::string( h.line( idx ), h.line_length( idx ) )];
+					}
+				}
+				std::vector<std::pair<int, std::string>> ranked;
+				for ( auto const& c : counts ) {
+					ranked.emplace_back( -c.second, c.first );
+				}
+				int top( std::min( hints, static_cast<int>( ranked.size() ) ) );
+				std::partial_sort( ranked.begin(), ranked.begin() + top, ranked.end() );
+				found += top;
+			}
+			report( "hints", "linear", size, lookups, sw.elapsed_ms() );
+			FrecencyIndex::lines_t lines;
+			int indexed( 0 );
+			sw.reset();
+			for ( int i( 0 ); i < lookups; ++ i ) {
+				h.frecent( prefix, prefixSize, hints, lines );
+				indexed += static_cast<int>( lines.size() );
+			}
+			report( "hints", prefix, size, lookups, sw.elapsed_ms() );
+			if ( indexed != found ) {
+				printf( "hint counts differ!\n" );
+			}
+		}
+	}
+}
+
+/*
+ * Ranking the whole history against fuzzy queries,
+ * single threaded and with all available cores.
+ */
+void benchmark_fuzzy( void ) {
+	int const searches( 10 );
+	char const* queries[] = { "g", "gcm", "dkrimg", "vimREADME", "zzz" };
+	std::vector<int> threadCounts( { 1 } );
+	if ( std::thread::hardware_concurrency() > 1 ) {
+		threadCounts.push_back( static_cast<int>( std::thread::hardware_concurrency() ) );
+	}
+	for ( int size : { 10000, 100000, 1000000 } ) {
+		History h;
+		h.set_max_size( size );
+		for ( int i( 0 ); i < size; ++ i ) {
+			h.add( sample_line( i ) );
+		}
+		FuzzyMatcher::matches_t matches;
+		for ( char const* query : queries ) {
+			for ( int threads : threadCounts ) {
+				Stopwatch sw;
+				for ( int i( 0 ); i < searches; ++ i ) {
+					h.fuzzy_search( query, 10, matches, threads );
+				}
+				std::string variant( query );
+				variant.append( "/t" ).append( std::to_string( threads ) );
+				report( "fuzzy", variant.c_str(), size, searches, sw.elapsed_ms() );
+			}
+		}
+	}
+}
+
+}
+
+int main( int argc_, char** argv_ ) {
+	if ( selected( argc_, argv_, "save" ) ) {
+		benchmark_save();
+	}
+	if ( selected( argc_, argv_, "add" ) ) {
+		benchmark_add();
+	}
+	if ( selected( argc_, argv_, "unique" ) ) {
+		benchmark_unique();
+	}
+	if ( selected( argc_, argv_, "memory" ) ) {
+		benchmark_memory();
+	}
+	if ( selected( argc_, argv_, "load" ) ) {
+		benchmark_load();
+	}
+	if ( selected( argc_, argv_, "search" ) ) {
+		benchmark_search();
+	}
+	if ( selected( argc_, argv_, "prefix" ) ) {
+		benchmark_prefix();
+	}
+	if ( selected( argc_, argv_, "fuzzy" ) ) {
+		benchmark_fuzzy();
+	}
+	if ( selected( argc_, argv_, "hints" ) ) {
+		benchmark_hints();
+	}
+	if ( selected( argc_, argv_, "recall" ) ) {
+		benchmark_recall();
+	}
+	if ( selected( argc_, argv_, "scaling" ) ) {
+		benchmark_scaling();
+	}
+	if ( selected( argc_, argv_, "compression" ) ) {
+		benchmark_compression();
+	}
+	return ( 0 );
+}
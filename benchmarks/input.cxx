@@ -0,0 +1,285 @@
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "replxx.hxx"
+#include "io.hxx"
+#include "conversion.hxx"
+#include "benchmark.hxx"
+
+using namespace replxx;
+using namespace replxx::benchmark;
+
+namespace {
+
+/*
+ * Keyboard reader as it was before input buffering,
+ * one read() and one conversion attempt per byte.
+ */
+char32_t read_unicode_character_bytewise( void ) {
+	static char8_t utf8String[5];
+	static size_t utf8Count = 0;
+	while ( true ) {
+		char8_t c;
+		ssize_t nread;
+		do {
+			nread = read( 0, &c, 1 );
+		} while ( ( nread == -1 ) && ( errno == EINTR ) );
+		if ( nread <= 0 ) {
+			return ( 0 );
+		}
+		if ( c <= 0x7F ) {
+			utf8Count = 0;
+			return ( c );
+		} else if ( utf8Count < sizeof ( utf8String ) - 1 ) {
+			utf8String[utf8Count++] = c;
+			utf8String[utf8Count] = 0;
+			char32_t unicodeChar[2];
+			int ucharCount( 0 );
+			ConversionResult res = copyString8to32( unicodeChar, 2, ucharCount, utf8String );
+			if ( ( res == conversionOK ) && ucharCount ) {
+				utf8Count = 0;
+				return ( unicodeChar[0] );
+			}
+		} else {
+			utf8Count = 0;
+		}
+	}
+}
+
+/* A paste of shell-like lines with some non-ASCII text in it. */
+std::string make_paste( int size_ ) {
+	std::string paste;
+	for ( int i( 0 ); static_cast<int>( paste.length() ) < size_; ++ i ) {
+		paste.append( sample_line( i ) );
+		if ( ( i % 4 ) == 0 ) {
+			paste.append( " # za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87 g\xc4\x99\xc5\x9bl\xc4\x85 ja\xc5\xba\xc5\x84 \xe2\x9c\x93" );
+		}
+		paste.append( " ; " );
+	}
+	paste.resize( static_cast<size_t>( size_ ) );
+	/* do not cut a multi byte character in half */
+	while ( ( static_cast<unsigned char>( paste.back() ) & 0xC0 ) == 0x80 ) {
+		paste.pop_back();
+	}
+	if ( static_cast<unsigned char>( paste.back() ) >= 0xC0 ) {
+		paste.pop_back();
+	}
+	return ( paste );
+}
+
+int count_characters( std::string const& text_ ) {
+	int count( 0 );
+	for ( char c : text_ ) {
+		if ( ( static_cast<unsigned char>( c ) & 0xC0 ) != 0x80 ) {
+			++ count;
+		}
+	}
+	return ( count );
+}
+
+/*
+ * Paste given text into the pipe that stands for the terminal
+ * and time reading it back character by character.
+ */
+template<typename reader_t>
+void paste( char const* variant_, int feed_, std::string const& text_, int repeat_, reader_t reader_ ) {
+	int characters( count_characters( text_ ) );
+	double ms( 0 );
+	for ( int r( 0 ); r < repeat_; ++ r ) {
+		if ( write( feed_, text_.data(), text_.length() ) != static_cast<ssize_t>( text_.length() ) ) {
+			printf( "write failed!\n" );
+			return;
+		}
+		Stopwatch sw;
+		for ( int i( 0 ); i < characters; ++ i ) {
+			if ( reader_() == 0 ) {
+				printf( "read failed!\n" );
+				return;
+			}
+		}
+		ms += sw.elapsed_ms();
+	}
+	report( "paste", variant_, static_cast<long long>( text_.length() ), repeat_, ms );
+	printf(
+		"paste            %-16s size=%-9d throughput=%8.2f MB/s\n",
+		variant_, static_cast<int>( text_.length() ),
+		static_cast<double>( text_.length() ) * repeat_ / ( ms * 1000. )
+	);
+}
+
+/*
+ * Throughput of reading pasted text, the byte at a time reader
+ * against the buffered one, also with full key dispatch on top.
+ */
+void benchmark_paste( void ) {
+	int fds[2];
+	if ( pipe( fds ) != 0 ) {
+		printf( "pipe failed!\n" );
+		return;
+	}
+	dup2( fds[0], 0 );
+	close( fds[0] );
+	Terminal terminal;
+	for ( int size : { 1000, 10000, 60000 } ) {
+		std::string text( make_paste( size ) );
+		int repeat( 2000000 / size );
+		paste( "bytewise", fds[1], text, repeat, read_unicode_character_bytewise );
+		paste( "buffered", fds[1], text, repeat, [&terminal]() { return ( terminal.read_unicode_character() ); } );
+		paste( "read_char", fds[1], text, repeat, [&terminal]() { return ( terminal.read_char() ); } );
+	}
+	close( fds[1] );
+}
+
+/* Color every other word, enough to need a full redraw on each key. */
+void highlight_words( std::string const& input_, Replxx::colors_t& colors_ ) {
+	bool odd( false );
+	for ( size_t i( 0 ); i < input_.length(); ++ i ) {
+		if ( input_[i] == ' ' ) {
+			odd = ! odd;
+		} else if ( odd && ( i < colors_.size() ) ) {
+			colors_[i] = Replxx::Color::BRIGHTBLUE;
+		}
+	}
+}
+
+/*
+ * Type given text (without bracketed paste markers) into replxx running
+ * on a pseudo terminal, count bytes it writes back to the terminal.
+ */
+long long typed_output( std::string const& text_, int coalesceLatency_, bool differential_, std::string const& preload_, double& ms_ ) {
+	int master( posix_openpt( O_RDWR | O_NOCTTY ) );
+	if ( ( master < 0 ) || ( grantpt( master ) != 0 ) || ( unlockpt( master ) != 0 ) ) {
+		return ( -1 );
+	}
+	int slave( open( ptsname( master ), O_RDWR | O_NOCTTY ) );
+	if ( slave < 0 ) {
+		close( master );
+		return ( -1 );
+	}
+	winsize ws;
+	ws.ws_row = 40;
+	ws.ws_col = 120;
+	ws.ws_xpixel = ws.ws_ypixel = 0;
+	ioctl( slave, TIOCSWINSZ, &ws );
+	long long written( 0 );
+	std::thread reader( [master, &written]() {
+		char buf[4096];
+		ssize_t nread( 0 );
+		while ( ( nread = read( master, buf, sizeof ( buf ) ) ) > 0 ) {
+			written += nread;
+		}
+	} );
+	int savedIn( dup( 0 ) );
+	int savedOut( dup( 1 ) );
+	fflush( stdout );
+	dup2( slave, 0 );
+	dup2( slave, 1 );
+	tty::in = tty::out = true;
+	{
+		Replxx rx;
+		rx.set_highlighter_callback( highlight_words );
+		rx.set_input_coalescing( coalesceLatency_ );
+		rx.set_differential_rendering( differential_ );
+		rx.set_preload_buffer( preload_ );
+		std::string keys( text_ );
+		keys.push_back( '\r' );
+		static_cast<void>( write( master, keys.data(), keys.length() ) >= 0 );
+		Stopwatch sw;
+		rx.input( "> " );
+		ms_ = sw.elapsed_ms();
+	}
+	dup2( savedIn, 0 );
+	dup2( savedOut, 1 );
+	close( savedIn );
+	close( savedOut );
+	close( slave );
+	reader.join();
+	close( master );
+	return ( written );
+}
+
+/*
+ * Terminal output per typed character with a redraw after every key
+ * against redraws once per batch of keys already waiting to be read.
+ */
+void benchmark_coalescing( void ) {
+	setenv( "TERM", "xterm", 1 );
+	/* keep below the pseudo terminal input queue size */
+	for ( int size : { 100, 500, 2000 } ) {
+		std::string text( make_paste( size ) );
+		int characters( count_characters( text ) );
+		for ( int latency : { 0, 50 } ) {
+			double ms( 0 );
+			long long written( typed_output( text, latency, false, std::string(), ms ) );
+			char const* variant( latency > 0 ? "coalesced" : "per-key" );
+			report( "coalescing", variant, static_cast<long long>( text.length() ), 1, ms );
+			printf(
+				"coalescing       %-16s size=%-9d bytes/char=%10.2f\n",
+				variant, static_cast<int>( text.length() ), static_cast<double>( written ) / characters
+			);
+		}
+	}
+}
+
+/*
+ * Terminal output per key when editing a long line, the whole
+ * input redrawn on every key against only the changed cells.
+ */
+void benchmark_redraw( void ) {
+	setenv( "TERM", "xterm", 1 );
+	std::string keys;
+	for ( int i( 0 ); i < 20; ++ i ) {
+		keys.append( "x" );
+	}
+	for ( int i( 0 ); i < 20; ++ i ) {
+		keys.append( "\033[D" );
+	}
+	for ( int i( 0 ); i < 20; ++ i ) {
+		keys.append( "\010" ); // not DEL, the line discipline takes it before raw mode is on
+	}
+	for ( int i( 0 ); i < 20; ++ i ) {
+		keys.append( "\033[F\010" ); // end, backspace
+	}
+	int keyCount( 100 );
+	for ( int size : { 100, 500, 2000 } ) {
+		std::string preload;
+		for ( int i( 0 ); static_cast<int>( preload.length() ) < size; ++ i ) {
+			preload.append( sample_line( i ) ).append( " ; " );
+		}
+		preload.resize( static_cast<size_t>( size ) );
+		for ( bool differential : { false, true } ) {
+			double ms( 0 );
+			long long written( typed_output( keys, 0, differential, preload, ms ) );
+			char const* variant( differential ? "differential" : "full" );
+			report( "redraw", variant, static_cast<long long>( preload.length() ), keyCount, ms );
+			printf(
+				"redraw           %-16s size=%-9d bytes/key=%11.2f\n",
+				variant, static_cast<int>( preload.length() ), static_cast<double>( written ) / keyCount
+			);
+		}
+	}
+}
+
+}
+
+int main( int argc_, char** argv_ ) {
+	if ( selected( argc_, argv_, "paste" ) ) {
+		benchmark_paste();
+	}
+	if ( selected( argc_, argv_, "coalescing" ) ) {
+		benchmark_coalescing();
+	}
+	if ( selected( argc_, argv_, "redraw" ) ) {
+		benchmark_redraw();
+	}
+	return ( 0 );
+}
+
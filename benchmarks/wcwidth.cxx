@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark.hxx"
+
+namespace replxx {
+
+int mk_wcwidth( char32_t );
+int mk_wcswidth( char32_t const*, size_t );
+
+}
+
+using namespace replxx;
+using namespace replxx::benchmark;
+
+namespace {
+
+typedef std::vector<char32_t> text_t;
+
+/* Repeat \e pattern_ up to \e size_ characters. */
+text_t sample_text( char32_t const* pattern_, int size_ ) {
+	std::u32string pattern( pattern_ );
+	text_t text;
+	text.reserve( static_cast<size_t>( size_ ) );
+	for ( int i( 0 ); i < size_; ++ i ) {
+		text.push_back( pattern[static_cast<size_t>( i ) % pattern.length()] );
+	}
+	return ( text );
+}
+
+/*
+ * Width of whole line as calculateColumnPosition() asks for it,
+ * and of every character alone as cursor movement and screen layout do.
+ */
+void benchmark_width( char const* name_, char32_t const* pattern_ ) {
+	long long sink( 0 );
+	for ( int size : { 80, 1000, 100000 } ) {
+		text_t text( sample_text( pattern_, size ) );
+		int const repeat( 20000000 / size );
+		Stopwatch sw;
+		for ( int r( 0 ); r < repeat; ++ r ) {
+			sink += mk_wcswidth( text.data(), text.size() );
+		}
+		report( name_, "wcswidth", size, repeat, sw.elapsed_ms() );
+		sw.reset();
+		for ( int r( 0 ); r < repeat; ++ r ) {
+			for ( char32_t c : text ) {
+				sink += mk_wcwidth( c );
+			}
+		}
+		report( name_, "wcwidth", size, repeat, sw.elapsed_ms() );
+	}
+	if ( sink == 0 ) {
+		printf( "no width\n" );
+	}
+}
+
+}
+
+int main( int argc_, char** argv_ ) {
+	if ( selected( argc_, argv_, "ascii" ) ) {
+		benchmark_width( "ascii", U"git commit -m \"Fix cursor position after paste\" && make -j8 " );
+	}
+	if ( selected( argc_, argv_, "cjk" ) ) {
+		benchmark_width( "cjk", U"日本語の入力を編集する、漢字とかなの混じった行。한국어 문장도 있다。" );
+	}
+	if ( selected( argc_, argv_, "emoji" ) ) {
+		benchmark_width( "emoji", U"😀 deploy 🚀🔥 done ✅👍 café 🎉 " );
+	}
+	return ( 0 );
+}
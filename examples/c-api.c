@@ -47,6 +47,11 @@ void colorHook( char const* str_, ReplxxColor* colors_, int size_, void* ud ) {
 	}
 }
 
+int historyHook( int index, char const* line, int length, void* ud ) {
+	replxx_print( (Replxx*)( ud ), "%4d: %.*s\n", index, length, line );
+	return ( 1 );
+}
+
 char const* recode( char* s ) {
 	char const* r = s;
 	while ( *s ) {
@@ -105,6 +110,8 @@ int main( int argc, char** argv ) {
 			case 'i': replxx_set_preload_buffer( replxx, recode( (*argv) + 1 ) );          break;
 			case 'w': replxx_set_word_break_characters( replxx, (*argv) + 1 );             break;
 			case 'm': replxx_set_no_color( replxx, (*argv)[1] - '0' );                     break;
+			case 'l': replxx_set_input_coalescing( replxx, atoi( (*argv) + 1 ) );          break;
+			case 'r': replxx_set_differential_rendering( replxx, (*argv)[1] - '0' );       break;
 			case 'p': prompt = recode( (*argv) + 1 );                                      break;
 			case 'q': quiet = atoi( (*argv) + 1 );                                         break;
 			case 'x': split( (*argv) + 1, examples, MAX_EXAMPLE_COUNT );                   break;
@@ -132,15 +139,7 @@ int main( int argc, char** argv ) {
 			break;
 		} else if (!strncmp(result, "/history", 8)) {
 			/* Display the current history. */
-			int index = 0;
-			int size = replxx_history_size( replxx );
-			for ( ; index < size; ++index) {
-				char const* hist = replxx_history_line( replxx, index );
-				if (hist == NULL) {
-					break;
-				}
-				replxx_print( replxx, "%4d: %s\n", index, hist );
-			}
+			replxx_history_scan( replxx, NULL, NULL, historyHook, replxx );
 		}
 		if (*result != '\0') {
 			replxx_print( replxx, quiet ? "%s\n" : "thanks for the input: %s\n", result );
@@ -248,9 +248,10 @@ int main() {
 			rx.history_add(input);
 		} else if (input.compare(0, 8, ".history") == 0) {
 			// display the current history
-			for (size_t i = 0, sz = rx.history_size(); i < sz; ++i) {
-				std::cout << std::setw(4) << i << ": " << rx.history_line(i) << "\n";
-			}
+			rx.history_scan([](int index, std::string_view line) {
+				std::cout << std::setw(4) << index << ": " << line << "\n";
+				return true;
+			});
 
 			rx.history_add(input);
 		} else if (input.compare(0, 6, ".clear") == 0) {
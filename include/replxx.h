@@ -255,12 +255,203 @@ void replxx_set_beep_on_ambiguous_completion( Replxx*, int val );
  */
 void replxx_set_no_color( Replxx*, int val );
 
+/*! \brief Redraw input line once per batch of keystrokes.
+ *
+ * With coalescing enabled, keystrokes that are already waiting to be read
+ * (fast typing, pastes without bracketed paste mode, slow remote links)
+ * are all applied before the line is redrawn, but the redraw is never
+ * postponed for longer than \e maxLatency.
+ *
+ * \param maxLatency - longest delay of a redraw in milliseconds, 0 disables coalescing.
+ */
+void replxx_set_input_coalescing( Replxx*, int maxLatency );
+
+/*! \brief Redraw only the parts of input line that changed.
+ *
+ * Instead of clearing and rewriting the whole input line with its hints
+ * on every change, remember what is on screen and send only changed
+ * spans and the cursor moves to reach them.  Full redraws are still
+ * used after other output, on resize and for text whose on-screen
+ * layout cannot be predicted.  Has no effect on Windows.
+ *
+ * \param val - redraw only changes (if != 0).
+ */
+void replxx_set_differential_rendering( Replxx*, int val );
+
 /*! \brief Set maximum number of entries in history list.
  */
 void replxx_set_max_history_size( Replxx*, int len );
+
+/*! \brief Set history persistence behavior.
+ *
+ * In append-only mode replxx_history_save() writes only the lines added since
+ * the previous save (or load) of the same file. The file is rewritten
+ * in full when it was changed by someone else in the meantime or when
+ * it has grown past twice the maximum history size.
+ *
+ * \param val - save history incrementally (if != 0).
+ */
+void replxx_set_history_append_only( Replxx*, int val );
+
+/*! \brief Share history file with other processes.
+ *
+ * In shared mode replxx_history_save() appends new lines under an advisory
+ * lock after merging lines appended by other sessions since the
+ * previous replxx_history_load() or replxx_history_save(). Such lines are
+ * also picked up each time replxx_input() starts reading a new line.
+ *
+ * \param val - share history file (if != 0).
+ */
+void replxx_set_history_shared( Replxx*, int val );
+
+/*! \brief Set history duplicate entries behavior.
+ *
+ * \param val - should history keep only the most recent occurrence of every entry (if != 0).
+ */
+void replxx_set_unique_history( Replxx*, int val );
+
+/*! \brief Save history in binary format.
+ *
+ * Binary history files keep the time every entry was added at
+ * and load only the entries that fit in history. replxx_history_load()
+ * recognizes both formats. Binary files are always rewritten as
+ * a whole by replxx_history_save(), background appends are suspended.
+ *
+ * \param val - save history in binary format (if != 0).
+ */
+void replxx_set_history_binary( Replxx*, int val );
+
+/*! \brief Load text history files starting from their end.
+ *
+ * replxx_history_load() reads only the last \e lines lines of the file and
+ * returns, older entries are read on a background thread and put in
+ * front of history once ready, they show up as soon as the user
+ * navigates history.  Entry indexes shift at that point.
+ *
+ * \param lines - number of lines loaded synchronously, 0 loads the whole file.
+ */
+void replxx_set_history_lazy_load( Replxx*, int lines );
+
+/*! \brief Keep usage statistics of history entries.
+ *
+ * Statistics (use count and time of last use of every distinct
+ * entry) are updated as entries are added and evicted and make
+ * replxx_history_frecent() available.  Without a hint callback, hints
+ * are then served from replxx_history_frecent() for the whole input.
+ *
+ * \param val - keep usage statistics (if != 0).
+ */
+void replxx_set_history_frecency( Replxx*, int val );
+
+/*! \brief Add history entries starting with given prefix ranked by frecency to hints.
+ *
+ * Frecency is the use count weighted by how recently the entry
+ * was used.  Requires replxx_set_history_frecency( replxx, 1 ).
+ *
+ * \param prefix - UTF-8 encoded prefix, entries equal to it are skipped.
+ * \param count - maximum number of entries to add.
+ * \param hints - list to append found entries to, best first.
+ */
+void replxx_history_frecent( Replxx*, const char* prefix, int count, replxx_hints* hints );
+
+/*! \brief Cache history entries in decoded form.
+ *
+ * Recalling an entry (history navigation and searches) converts it
+ * from UTF-8 each time.  With the cache enabled the most recently
+ * recalled entries are kept decoded, along with their display width.
+ *
+ * \param bytes - memory available for the cache, 0 disables it (default).
+ */
+void replxx_set_history_decode_cache( Replxx*, int bytes );
+
+/*! \brief Search very large histories with several threads.
+ *
+ * Incremental (Ctrl-R) and common prefix (Meta-P) searches in histories
+ * of at least 100000 entries then scan history in parallel instead of
+ * building search indexes, which saves memory for the indexes.
+ *
+ * \param threads - number of threads, 0 disables parallel search (default), -1 uses all cores.
+ */
+void replxx_set_history_search_threads( Replxx*, int threads );
+
+/*! \brief Keep older history entries compressed in memory.
+ *
+ * Only the most recent entries are kept as they are, older ones are
+ * decompressed in blocks as history navigation or search reaches them,
+ * which makes searches of old entries slower.  Searches of compressed
+ * history are not run in parallel.  Binary history files
+ * (see replxx_set_history_binary()) are written compressed as well.
+ *
+ * \param val - compress older entries (if != 0).
+ */
+void replxx_set_history_compression( Replxx*, int val );
+
+/*! \brief Save history from a background thread.
+ *
+ * Once enabled, every line passed to replxx_history_add() is queued to a writer
+ * thread that appends it to \e filename, replxx_history_save() of that file
+ * rewrites it with a snapshot of the history, also in the background.
+ * Queued lines are flushed by replxx_history_sync() and by replxx_end().
+ *
+ * \param filename - history file, NULL or empty string stops background saving.
+ * \param syncInterval - fsync() the file at most that often (in milliseconds),
+ * 0 syncs after every write, -1 only in replxx_history_sync() and replxx_end().
+ */
+void replxx_set_history_async_save( Replxx*, const char* filename, int syncInterval );
+
+/*! \brief Get given history entry.
+ *
+ * \param index - index of the entry, 0 is the oldest one.
+ * \return UTF-8 encoded entry owned by the library, valid until the entry
+ * is changed or leaves history, or NULL if there is no such entry.
+ */
 char const* replxx_history_line( Replxx*, int index );
+
+/*! \brief Time given history entry was added at.
+ *
+ * \param index - index of the entry, 0 is the oldest one.
+ * \return Seconds since the epoch, 0 for entries loaded from a text history file,
+ * -1 if there is no such entry.
+ */
+long long replxx_history_timestamp( Replxx*, int index );
+
+/*! \brief History visitor type definition.
+ *
+ * \param index - index of the entry, as in replxx_history_line().
+ * \param line - UTF-8 encoded entry, not NUL terminated, valid only for the duration of the call.
+ * \param length - length of \e line in bytes.
+ * \param userData - pointer to opaque user data block.
+ * \return 0 to stop the scan.
+ */
+typedef int (replxx_history_visitor_t)( int index, const char* line, int length, void* userData );
+
+/*! \brief Visit history entries, oldest first, without copying them.
+ *
+ * \param prefix - visit only entries starting with it, NULL or empty string matches all.
+ * \param substring - visit only entries containing it, NULL or empty string matches all.
+ * \param fn - called for every matching entry.
+ * \param userData - pointer to opaque user data block passed to \e fn.
+ * \return Number of visited entries.
+ */
+int replxx_history_scan( Replxx*, const char* prefix, const char* substring, replxx_history_visitor_t* fn, void* userData );
+
+/*! \brief Save history to given file.
+ *
+ * With background saving to \e filename enabled (see replxx_set_history_async_save())
+ * saving is asynchronous: a snapshot of the history is queued to the writer
+ * thread and 0 is returned before anything is written, errors are reported
+ * by the following replxx_history_sync().
+ *
+ * \return 0 on success, -1 on error.
+ */
 int replxx_history_save( Replxx*, const char* filename );
 int replxx_history_load( Replxx*, const char* filename );
+
+/*! \brief Wait for background history saving to catch up.
+ *
+ * \return 0 on success, -1 if writing failed since previous call.
+ */
+int replxx_history_sync( Replxx* );
 void replxx_clear_screen( Replxx* );
 #ifdef __REPLXX_DEBUG__
 void replxx_debug_dump_print_codes(void);
@@ -34,6 +34,7 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <functional>
 
 namespace replxx {
@@ -122,6 +123,14 @@ public:
 	 */
 	typedef std::function<hints_t ( std::string const& input, int& contextLen, Color& color )> hint_callback_t;
 
+	/*! \brief History visitor type definition.
+	 *
+	 * \param index - index of the entry, as in history_line().
+	 * \param line - UTF-8 encoded entry, valid only for the duration of the call.
+	 * \return false to stop the scan.
+	 */
+	typedef std::function<bool ( int index, std::string_view line )> history_visitor_t;
+
 	class ReplxxImpl;
 private:
 	typedef std::unique_ptr<ReplxxImpl, void (*)( ReplxxImpl* )> impl_t;
@@ -174,11 +183,55 @@ public:
 	void emulate_key_press( char32_t code );
 
 	void history_add( std::string const& line );
+
+	/*! \brief Save history to given file.
+	 *
+	 * With background saving to \e filename enabled (see set_history_async_save())
+	 * saving is asynchronous: a snapshot of the history is queued to the writer
+	 * thread and 0 is returned before anything is written, errors are reported
+	 * by the following history_sync().
+	 *
+	 * \return 0 on success, -1 on error.
+	 */
 	int history_save( std::string const& filename );
 	int history_load( std::string const& filename );
+
+	/*! \brief Wait for background history saving to catch up.
+	 *
+	 * Blocks until every line queued so far is written and synced to disk.
+	 *
+	 * \return 0 on success, -1 if writing failed since previous call.
+	 */
+	int history_sync( void );
 	int history_size( void ) const;
+
+	/*! \brief Get given history entry.
+	 *
+	 * \param index - index of the entry, 0 is the oldest one.
+	 * \return UTF-8 encoded entry, valid until the entry is changed or leaves history.
+	 */
 	std::string const& history_line( int index );
 
+	/*! \brief Time given history entry was added at.
+	 *
+	 * \param index - index of the entry, 0 is the oldest one.
+	 * \return Seconds since the epoch, 0 for entries loaded from a text history file,
+	 * -1 if there is no such entry.
+	 */
+	long long history_timestamp( int index ) const;
+
+	/*! \brief Visit history entries, oldest first, without copying them.
+	 *
+	 * Entries are passed straight from history storage, filtering
+	 * is done in the same single pass.
+	 *
+	 * \param visitor - called for every matching entry.
+	 * \param prefix - visit only entries starting with it, empty matches all.
+	 * \param substring - visit only entries containing it, empty matches all.
+	 * \return Number of visited entries.
+	 */
+	int history_scan( history_visitor_t const& visitor, std::string_view prefix = std::string_view(), std::string_view substring = std::string_view() ) const;
+
 	void set_preload_buffer( std::string const& preloadText );
 
 	/*! \brief Set set of word break characters.
@@ -221,9 +274,149 @@ public:
 	 */
 	void set_no_color( bool val );
 
+	/*! \brief Redraw input line once per batch of keystrokes.
+	 *
+	 * With coalescing enabled, keystrokes that are already waiting to be read
+	 * (fast typing, pastes without bracketed paste mode, slow remote links)
+	 * are all applied before the line is redrawn, but the redraw is never
+	 * postponed for longer than \e maxLatency.
+	 *
+	 * \param maxLatency - longest delay of a redraw in milliseconds, 0 disables coalescing.
+	 */
+	void set_input_coalescing( int maxLatency );
+
+	/*! \brief Redraw only the parts of input line that changed.
+	 *
+	 * Instead of clearing and rewriting the whole input line with its hints
+	 * on every change, remember what is on screen and send only changed
+	 * spans and the cursor moves to reach them.  Full redraws are still
+	 * used after other output, on resize and for text whose on-screen
+	 * layout cannot be predicted.  Has no effect on Windows.
+	 *
+	 * \param val - redraw only changes.
+	 */
+	void set_differential_rendering( bool val );
+
 	/*! \brief Set maximum number of entries in history list.
 	 */
 	void set_max_history_size( int len );
+
+	/*! \brief Set history persistence behavior.
+	 *
+	 * In append-only mode history_save() writes only the lines added since
+	 * the previous save (or load) of the same file. The file is rewritten
+	 * in full when it was changed by someone else in the meantime or when
+	 * it has grown past twice the maximum history size.
+	 *
+	 * \param val - save history incrementally.
+	 */
+	void set_history_append_only( bool val );
+
+	/*! \brief Share history file with other processes.
+	 *
+	 * In shared mode history_save() appends new lines under an advisory
+	 * lock after merging lines appended by other sessions since the
+	 * previous history_load() or history_save(). Such lines are also
+	 * picked up each time input() starts reading a new line.
+	 *
+	 * \param val - share history file.
+	 */
+	void set_history_shared( bool val );
+
+	/*! \brief Set history duplicate entries behavior.
+	 *
+	 * \param val - should history keep only the most recent occurrence of every entry.
+	 */
+	void set_unique_history( bool val );
+
+	/*! \brief Save history in binary format.
+	 *
+	 * Binary history files keep the time every entry was added at
+	 * and load only the entries that fit in history. history_load()
+	 * recognizes both formats. Binary files are always rewritten as
+	 * a whole by history_save(), background appends are suspended.
+	 *
+	 * \param val - save history in binary format.
+	 */
+	void set_history_binary( bool val );
+
+	/*! \brief Load text history files starting from their end.
+	 *
+	 * history_load() reads only the last \e lines lines of the file and
+	 * returns, older entries are read on a background thread and put in
+	 * front of history once ready, they show up as soon as the user
+	 * navigates history.  Entry indexes shift at that point.
+	 *
+	 * \param lines - number of lines loaded synchronously, 0 loads the whole file.
+	 */
+	void set_history_lazy_load( int lines );
+
+	/*! \brief Keep usage statistics of history entries.
+	 *
+	 * Statistics (use count and time of last use of every distinct
+	 * entry) are updated as entries are added and evicted and make
+	 * history_frecent() available.  Without a hint callback, hints are
+	 * then served from history_frecent() for the whole input.
+	 *
+	 * \param val - keep usage statistics.
+	 */
+	void set_history_frecency( bool val );
+
+	/*! \brief Find history entries starting with given prefix ranked by frecency.
+	 *
+	 * Frecency is the use count weighted by how recently the entry
+	 * was used.  Requires set_history_frecency( true ).
+	 *
+	 * \param prefix - UTF-8 encoded prefix, entries equal to it are skipped.
+	 * \param count - maximum number of entries to return.
+	 * \return Found entries, best first.
+	 */
+	hints_t history_frecent( std::string const& prefix, int count ) const;
+
+	/*! \brief Cache history entries in decoded form.
+	 *
+	 * Recalling an entry (history navigation and searches) converts it
+	 * from UTF-8 each time.  With the cache enabled the most recently
+	 * recalled entries are kept decoded, along with their display width.
+	 *
+	 * \param bytes - memory available for the cache, 0 disables it (default).
+	 */
+	void set_history_decode_cache( int bytes );
+
+	/*! \brief Search very large histories with several threads.
+	 *
+	 * Incremental (Ctrl-R) and common prefix (Meta-P) searches in histories
+	 * of at least 100000 entries then scan history in parallel instead of
+	 * building search indexes, which saves memory for the indexes.
+	 *
+	 * \param threads - number of threads, 0 disables parallel search (default), -1 uses all cores.
+	 */
+	void set_history_search_threads( int threads );
+
+	/*! \brief Keep older history entries compressed in memory.
+	 *
+	 * Only the most recent entries are kept as they are, older ones are
+	 * decompressed in blocks as history navigation or search reaches them,
+	 * which makes searches of old entries slower.  Searches of compressed
+	 * history are not run in parallel.  Binary history files
+	 * (see set_history_binary()) are written compressed as well.
+	 *
+	 * \param val - compress older entries.
+	 */
+	void set_history_compression( bool val );
+
+	/*! \brief Save history from a background thread.
+	 *
+	 * Once enabled, every line passed to history_add() is queued to a writer
+	 * thread that appends it to \e filename, history_save() of that file
+	 * rewrites it with a snapshot of the history, also in the background.
+	 * Queued lines are flushed by history_sync() and on destruction.
+	 *
+	 * \param filename - history file, empty string stops background saving.
+	 * \param syncInterval - fsync() the file at most that often (in milliseconds),
+	 * 0 syncs after every write, -1 only in history_sync() and on destruction.
+	 */
+	void set_history_async_save( std::string const& filename, int syncInterval );
 	void clear_screen( void );
 	int install_window_change_handler( void );
 
@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "columnindex.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+int mk_wcwidth( char32_t );
+
+namespace {
+
+/* Counted apart from widths, in upper half of tree sums. */
+long long const UNPRINTABLE = 1LL << 32;
+
+inline long long weight( signed char width_ ) {
+	return ( width_ < 0 ? UNPRINTABLE : width_ );
+}
+
+}
+
+ColumnIndex::ColumnIndex( void )
+	: _widths()
+	, _tree( 1, 0 )
+	, _built( 0 ) {
+}
+
+void ColumnIndex::assign( char32_t const* text_, int len_ ) {
+	_widths.clear();
+	insert( 0, text_, len_ );
+}
+
+void ColumnIndex::insert( int pos_, char32_t const* text_, int len_ ) {
+	if ( len_ <= 0 ) {
+		return;
+	}
+	_widths.insert( _widths.begin() + pos_, static_cast<size_t>( len_ ), 0 );
+	for ( int i( 0 ); i < len_; ++ i ) {
+		_widths[static_cast<size_t>( pos_ + i )] = static_cast<signed char>( mk_wcwidth( text_[i] ) );
+	}
+	invalidate( pos_ );
+}
+
+void ColumnIndex::erase( int pos_, int len_ ) {
+	if ( len_ <= 0 ) {
+		return;
+	}
+	_widths.erase( _widths.begin() + pos_, _widths.begin() + pos_ + len_ );
+	invalidate( pos_ );
+}
+
+void ColumnIndex::clear( void ) {
+	_widths.clear();
+	invalidate( 0 );
+}
+
+void ColumnIndex::swap( ColumnIndex& other_ ) {
+	_widths.swap( other_._widths );
+	_tree.swap( other_._tree );
+	std::swap( _built, other_._built );
+}
+
+void ColumnIndex::assign_widths( ColumnIndex const& other_ ) {
+	_widths.assign( other_._widths.begin(), other_._widths.end() );
+	invalidate( 0 );
+}
+
+/*
+ * Node i sums characters ( i - lowbit( i ), i ], nodes up to
+ * the first changed character cover none of the changed ones.
+ */
+void ColumnIndex::invalidate( int pos_ ) {
+	_built = min( _built, pos_ );
+	_tree.resize( _widths.size() + 1 );
+}
+
+/*
+ * Node i is its own character plus the nodes i - 1, i - 2, i - 4, ...
+ * below its lowest bit, all of them built before it.
+ */
+void ColumnIndex::build( int upTo_ ) const {
+	for ( int i( _built + 1 ); i <= upTo_; ++ i ) {
+		long long sum( weight( _widths[static_cast<size_t>( i - 1 )] ) );
+		for ( int step( 1 ); step < ( i & -i ); step <<= 1 ) {
+			sum += _tree[static_cast<size_t>( i - step )];
+		}
+		_tree[static_cast<size_t>( i )] = sum;
+	}
+	_built = max( _built, upTo_ );
+}
+
+int ColumnIndex::column( int pos_ ) const {
+	pos_ = min( pos_, length() );
+	if ( pos_ > _built ) {
+		build( pos_ );
+	}
+	long long sum( 0 );
+	for ( int i( pos_ ); i > 0; i -= ( i & -i ) ) {
+		sum += _tree[static_cast<size_t>( i )];
+	}
+	return ( sum >= UNPRINTABLE ? pos_ : static_cast<int>( sum ) );
+}
+
+}
+
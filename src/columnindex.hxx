@@ -0,0 +1,55 @@
+#ifndef REPLXX_COLUMNINDEX_HXX_INCLUDED
+#define REPLXX_COLUMNINDEX_HXX_INCLUDED 1
+
+#include <vector>
+
+namespace replxx {
+
+/*
+ * Screen widths of characters of the edited line with their prefix sums.
+ *
+ * Widths are looked up once, when characters enter the line, and are
+ * summed by a Fenwick tree, so column of any position comes in O(log n).
+ * Edits shift everything past the edit point, tree nodes covering
+ * shifted characters are rebuilt lazily, only as far as the next query
+ * reaches.
+ */
+class ColumnIndex {
+private:
+	typedef std::vector<signed char> widths_t;
+	typedef std::vector<long long> tree_t;
+	widths_t _widths;       // mk_wcwidth() of every character
+	mutable tree_t _tree;   // Fenwick tree over _widths, 1-based
+	mutable int _built;     // _tree entries up to this one are up to date
+public:
+	ColumnIndex( void );
+	void assign( char32_t const*, int );
+	void insert( int pos_, char32_t const*, int );
+	void erase( int pos_, int len_ );
+	void clear( void );
+	void swap( ColumnIndex& );
+	/*! \brief Take over widths of another index.
+	 *
+	 * Only the widths are copied (into storage already held), sums are
+	 * rebuilt as queries reach them.
+	 */
+	void assign_widths( ColumnIndex const& );
+	/*! \brief Width of first \e pos_ characters.
+	 *
+	 * Same as calculateColumnPosition() on the line: if any of them
+	 * is not printable each character counts as one column.
+	 * Positions past the end count as the end.
+	 */
+	int column( int pos_ ) const;
+	int length( void ) const {
+		return ( static_cast<int>( _widths.size() ) );
+	}
+private:
+	void invalidate( int );
+	void build( int ) const;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,156 @@
+#include <cstring>
+#include <algorithm>
+
+#include "compression.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+/*
+ * Block is a sequence of:
+ *   token:    literal count (high nibble) and match length - 4 (low nibble),
+ *             15 in either nibble means more bytes follow, each adding its value,
+ *             until a byte other than 255
+ *   literals: copied verbatim
+ *   offset:   u16 little endian, distance back to match source
+ * The last sequence has literals only and ends the block.
+ */
+int const MIN_MATCH( 4 );
+int const MAX_OFFSET( 65535 );
+int const HASH_BITS( 13 );
+
+unsigned int read32( unsigned char const* p_ ) {
+	unsigned int v( 0 );
+	memcpy( &v, p_, sizeof ( v ) );
+	return ( v );
+}
+
+int hash( unsigned int seq_ ) {
+	return ( static_cast<int>( ( seq_ * 2654435761U ) >> ( 32 - HASH_BITS ) ) );
+}
+
+void put_length( unsigned char*& out_, int length_ ) {
+	while ( length_ >= 255 ) {
+		*out_ ++ = 255;
+		length_ -= 255;
+	}
+	*out_ ++ = static_cast<unsigned char>( length_ );
+}
+
+bool get_length( unsigned char const*& in_, unsigned char const* end_, int& length_ ) {
+	unsigned char b( 255 );
+	while ( b == 255 ) {
+		if ( ( in_ == end_ ) || ( length_ > ( 0x7fffffff - 255 ) ) ) {
+			return ( false );
+		}
+		b = *in_ ++;
+		length_ += b;
+	}
+	return ( true );
+}
+
+void put_sequence( unsigned char*& out_, unsigned char const* literals_, int literalCount_, int offset_, int matchLength_ ) {
+	int matchCode( matchLength_ - MIN_MATCH );
+	*out_ ++ = static_cast<unsigned char>( ( min( literalCount_, 15 ) << 4 ) | min( max( matchCode, 0 ), 15 ) );
+	if ( literalCount_ >= 15 ) {
+		put_length( out_, literalCount_ - 15 );
+	}
+	memcpy( out_, literals_, static_cast<size_t>( literalCount_ ) );
+	out_ += literalCount_;
+	if ( offset_ == 0 ) {
+		return;
+	}
+	*out_ ++ = static_cast<unsigned char>( offset_ & 0xff );
+	*out_ ++ = static_cast<unsigned char>( offset_ >> 8 );
+	if ( matchCode >= 15 ) {
+		put_length( out_, matchCode - 15 );
+	}
+}
+
+}
+
+int lz_bound( int size_ ) {
+	return ( size_ + size_ / 255 + 16 );
+}
+
+int lz_compress( char const* src_, int size_, char* dst_ ) {
+	unsigned char const* in( reinterpret_cast<unsigned char const*>( src_ ) );
+	unsigned char* out( reinterpret_cast<unsigned char*>( dst_ ) );
+	int table[1 << HASH_BITS];
+	fill( table, table + ( 1 << HASH_BITS ), -1 );
+	int anchor( 0 );
+	int pos( 0 );
+	while ( pos <= ( size_ - MIN_MATCH ) ) {
+		unsigned int seq( read32( in + pos ) );
+		int h( hash( seq ) );
+		int ref( table[h] );
+		table[h] = pos;
+		if ( ( ref < 0 ) || ( ( pos - ref ) > MAX_OFFSET ) || ( read32( in + ref ) != seq ) ) {
+			++ pos;
+			continue;
+		}
+		int length( MIN_MATCH );
+		while ( ( ( pos + length ) < size_ ) && ( in[ref + length] == in[pos + length] ) ) {
+			++ length;
+		}
+		put_sequence( out, in + anchor, pos - anchor, pos - ref, length );
+		pos += length;
+		anchor = pos;
+	}
+	put_sequence( out, in + anchor, size_ - anchor, 0, 0 );
+	return ( static_cast<int>( out - reinterpret_cast<unsigned char*>( dst_ ) ) );
+}
+
+bool lz_decompress( char const* src_, int size_, char* dst_, int rawSize_ ) {
+	unsigned char const* in( reinterpret_cast<unsigned char const*>( src_ ) );
+	unsigned char const* end( in + size_ );
+	unsigned char* out( reinterpret_cast<unsigned char*>( dst_ ) );
+	int produced( 0 );
+	while ( in < end ) {
+		unsigned char token( *in ++ );
+		int literalCount( token >> 4 );
+		if ( ( literalCount == 15 ) && ! get_length( in, end, literalCount ) ) {
+			return ( false );
+		}
+		if ( ( literalCount > ( end - in ) ) || ( literalCount > ( rawSize_ - produced ) ) ) {
+			return ( false );
+		}
+		memcpy( out + produced, in, static_cast<size_t>( literalCount ) );
+		in += literalCount;
+		produced += literalCount;
+		if ( in == end ) {
+			break;
+		}
+		if ( ( end - in ) < 2 ) {
+			return ( false );
+		}
+		int offset( in[0] | ( in[1] << 8 ) );
+		in += 2;
+		int length( token & 0x0f );
+		if ( ( length == 15 ) && ! get_length( in, end, length ) ) {
+			return ( false );
+		}
+		length += MIN_MATCH;
+		if ( ( offset == 0 ) || ( offset > produced ) || ( length > ( rawSize_ - produced ) ) ) {
+			return ( false );
+		}
+		unsigned char* dst( out + produced );
+		unsigned char const* from( dst - offset );
+		if ( offset >= length ) {
+			memcpy( dst, from, static_cast<size_t>( length ) );
+		} else {
+			/* overlapping match repeats the last offset bytes */
+			for ( int i( 0 ); i < length; ++ i ) {
+				dst[i] = from[i];
+			}
+		}
+		produced += length;
+	}
+	return ( produced == rawSize_ );
+}
+
+}
+
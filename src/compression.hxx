@@ -0,0 +1,36 @@
+#ifndef REPLXX_COMPRESSION_HXX_INCLUDED
+#define REPLXX_COMPRESSION_HXX_INCLUDED 1
+
+namespace replxx {
+
+/*
+ * Byte oriented LZ77 block compression (in the spirit of LZ4),
+ * fast to decompress and good enough for repetitive text like
+ * shell history.  Blocks are compressed independently, matches
+ * reach at most 64KiB back.
+ */
+
+/*! \brief Size of the output buffer lz_compress() may need for \e size_ input bytes.
+ */
+int lz_bound( int size_ );
+
+/*! \brief Compress a block.
+ *
+ * \param dst_ - output buffer of at least lz_bound( size_ ) bytes.
+ * \return Compressed size.
+ */
+int lz_compress( char const* src_, int size_, char* dst_ );
+
+/*! \brief Decompress a block produced by lz_compress().
+ *
+ * Malformed input is detected, never read or written out of bounds.
+ *
+ * \param dst_ - output buffer of exactly \e rawSize_ bytes.
+ * \return True iff the block decompressed to exactly \e rawSize_ bytes.
+ */
+bool lz_decompress( char const* src_, int size_, char* dst_, int rawSize_ );
+
+}
+
+#endif
+
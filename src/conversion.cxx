@@ -109,5 +109,41 @@ void copyString32to8(
 	}
 }
 
+/*
+ * Encode straight into the end of a reused buffer, no intermediate
+ * allocation, ASCII is copied as is.
+ */
+void appendString32to8( std::string& dst, char32_t const* src, int srcSize ) {
+	if ( srcSize <= 0 ) {
+		return;
+	}
+	size_t used( dst.size() );
+	dst.resize( used + 4 * static_cast<size_t>( srcSize ) );
+	char* out( &dst[used] );
+	for ( int i( 0 ); i < srcSize; ++ i ) {
+		char32_t c( src[i] );
+		if ( ( c < 0x80 ) || locale::is8BitEncoding ) {
+			*out ++ = static_cast<char>( c );
+			continue;
+		}
+		if ( c > UNI_MAX_LEGAL_UTF32 ) {
+			c = UNI_REPLACEMENT_CHAR;
+		}
+		if ( c < 0x800 ) {
+			*out ++ = static_cast<char>( 0xC0 | ( c >> 6 ) );
+		} else {
+			if ( c < 0x10000 ) {
+				*out ++ = static_cast<char>( 0xE0 | ( c >> 12 ) );
+			} else {
+				*out ++ = static_cast<char>( 0xF0 | ( c >> 18 ) );
+				*out ++ = static_cast<char>( 0x80 | ( ( c >> 12 ) & 0x3F ) );
+			}
+			*out ++ = static_cast<char>( 0x80 | ( ( c >> 6 ) & 0x3F ) );
+		}
+		*out ++ = static_cast<char>( 0x80 | ( c & 0x3F ) );
+	}
+	dst.resize( static_cast<size_t>( out - dst.data() ) );
+}
+
 }
 
@@ -39,6 +39,11 @@ namespace EscapeSequenceProcessing { // move these out of global namespace
 
 
 static char32_t thisKeyMetaCtrl = 0;	// holds pre-set Meta and/or Ctrl modifiers
+static Terminal* thisTerminal = nullptr;	// terminal the sequence is read from
+
+static char32_t read_unicode_character( void ) {
+	return ( thisTerminal->read_unicode_character() );
+}
 
 // This dispatch routine is given a dispatch table and then farms work out to
 // routines
@@ -99,6 +104,8 @@ static char32_t ctrlRightArrowKeyRoutine(char32_t) {
 static char32_t ctrlLeftArrowKeyRoutine(char32_t) {
 	return thisKeyMetaCtrl | CTRL | LEFT_ARROW_KEY;
 }
+static char32_t pasteStartRoutine(char32_t) { return PASTE_START_KEY; }
+static char32_t pasteEndRoutine(char32_t) { return PASTE_END_KEY; }
 static char32_t escFailureRoutine(char32_t) {
 	beep();
 	return -1;
@@ -144,6 +151,42 @@ static CharacterDispatchRoutine escLeftBracket1Routines[] = {
 static CharacterDispatch escLeftBracket1Dispatch = {2, "~;",
 																										escLeftBracket1Routines};
 
+// Handle ESC [ 2 <more stuff> escape sequences, ESC [ 2 0 0 ~ starts
+// a bracketed paste, its end marker is consumed by Terminal::read_paste(),
+// ESC [ 2 0 1 ~ seen on its own is a stray end marker
+//
+static CharacterDispatchRoutine escLeftBracket200Routines[] = {
+		pasteStartRoutine, escFailureRoutine};
+static CharacterDispatch escLeftBracket200Dispatch = {1, "~",
+																											escLeftBracket200Routines};
+static char32_t escLeftBracket200Routine(char32_t c) {
+	c = read_unicode_character();
+	if (c == 0) return 0;
+	return doDispatch(c, escLeftBracket200Dispatch);
+}
+static CharacterDispatchRoutine escLeftBracket201Routines[] = {
+		pasteEndRoutine, escFailureRoutine};
+static CharacterDispatch escLeftBracket201Dispatch = {1, "~",
+																											escLeftBracket201Routines};
+static char32_t escLeftBracket201Routine(char32_t c) {
+	c = read_unicode_character();
+	if (c == 0) return 0;
+	return doDispatch(c, escLeftBracket201Dispatch);
+}
+static CharacterDispatchRoutine escLeftBracket20Routines[] = {
+		escLeftBracket200Routine, escLeftBracket201Routine, escFailureRoutine};
+static CharacterDispatch escLeftBracket20Dispatch = {2, "01",
+																										 escLeftBracket20Routines};
+static char32_t escLeftBracket20Routine(char32_t c) {
+	c = read_unicode_character();
+	if (c == 0) return 0;
+	return doDispatch(c, escLeftBracket20Dispatch);
+}
+static CharacterDispatchRoutine escLeftBracket2Routines[] = {
+		escLeftBracket20Routine, escFailureRoutine};	// Insert key, unused
+static CharacterDispatch escLeftBracket2Dispatch = {1, "0",
+																										escLeftBracket2Routines};
+
 // Handle ESC [ 3 <more stuff> escape sequences
 //
 static CharacterDispatchRoutine escLeftBracket3Routines[] = {deleteKeyRoutine,
@@ -198,7 +241,9 @@ static char32_t escLeftBracket1Routine(char32_t c) {
 	return doDispatch(c, escLeftBracket1Dispatch);
 }
 static char32_t escLeftBracket2Routine(char32_t c) {
-	return escFailureRoutine(c);	// Insert key, unused
+	c = read_unicode_character();
+	if (c == 0) return 0;
+	return doDispatch(c, escLeftBracket2Dispatch);
 }
 static char32_t escLeftBracket3Routine(char32_t c) {
 	c = read_unicode_character();
@@ -296,8 +341,9 @@ static char32_t setMetaRoutine(char32_t c) {
 	return doDispatch(c, initialDispatch);
 }
 
-char32_t doDispatch(char32_t c) {
+char32_t doDispatch( Terminal& terminal_, char32_t c ) {
 	EscapeSequenceProcessing::thisKeyMetaCtrl = 0;	// no modifiers yet at initialDispatch
+	EscapeSequenceProcessing::thisTerminal = &terminal_;
 	return doDispatch(c, initialDispatch);
 }
 
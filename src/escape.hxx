@@ -3,6 +3,8 @@
 
 namespace replxx {
 
+class Terminal;
+
 namespace EscapeSequenceProcessing {
 
 // This is a typedef for the routine called by doDispatch().	It takes the
@@ -27,7 +29,7 @@ struct CharacterDispatch {
 	CharacterDispatchRoutine* dispatch; // array of routines to call
 };
 
-char32_t doDispatch(char32_t c);
+char32_t doDispatch( Terminal&, char32_t c );
 
 }
 
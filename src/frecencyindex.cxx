@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <climits>
+
+#include "frecencyindex.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+/* Candidates kept per ranking, hints asked for beyond that come from a full scan. */
+static int const CANDIDATES( 16 );
+/* Prefixes get candidates once a scan finds that many lines. */
+static int const NODE_MIN_LINES( 256 );
+/* Limit on prefixes with candidates, all of them are dropped past it. */
+static int const MAX_NODES( 1024 );
+
+}
+
+FrecencyIndex::Node::Node( void )
+	: _mostUsed()
+	, _lastUsed()
+	, _leastCount( 0 )
+	, _countBound( 0 )
+	, _useBound( LLONG_MIN )
+	, _useBoundLine() {
+}
+
+FrecencyIndex::FrecencyIndex( void )
+	: _stats()
+	, _nodes()
+	, _nodeDepth( 0 ) {
+}
+
+void FrecencyIndex::add( char const* data_, int length_, long long timestamp_ ) {
+	string_view line( data_, static_cast<size_t>( length_ ) );
+	stats_t::iterator it( _stats.lower_bound( line ) );
+	if ( ( it == _stats.end() ) || ( it->first != line ) ) {
+		it = _stats.emplace_hint( it, string( line ), Stats{ 0, timestamp_ } );
+	}
+	++ it->second._count;
+	if ( timestamp_ > it->second._lastUse ) {
+		it->second._lastUse = timestamp_;
+	}
+	if ( _nodes.empty() ) {
+		return;
+	}
+	for ( int i( 0 ); ( i <= length_ ) && ( i <= _nodeDepth ); ++ i ) {
+		nodes_t::iterator node( _nodes.find( string( data_, static_cast<size_t>( i ) ) ) );
+		if ( node != _nodes.end() ) {
+			admit( node->second, it );
+		}
+	}
+}
+
+void FrecencyIndex::remove( char const* data_, int length_ ) {
+	stats_t::iterator it( _stats.find( string_view( data_, static_cast<size_t>( length_ ) ) ) );
+	if ( ( it != _stats.end() ) && ( -- it->second._count <= 0 ) ) {
+		drop( it );
+		_stats.erase( it );
+	}
+}
+
+void FrecencyIndex::forget( char const* data_, int length_ ) {
+	stats_t::iterator it( _stats.find( string_view( data_, static_cast<size_t>( length_ ) ) ) );
+	if ( it != _stats.end() ) {
+		drop( it );
+		_stats.erase( it );
+	}
+}
+
+/*
+ * Lines leaving the index leave the candidates behind too,
+ * the bounds stay valid.
+ */
+void FrecencyIndex::drop( stats_t::const_iterator it_ ) {
+	if ( _nodes.empty() ) {
+		return;
+	}
+	int length( static_cast<int>( it_->first.length() ) );
+	for ( int i( 0 ); ( i <= length ) && ( i <= _nodeDepth ); ++ i ) {
+		nodes_t::iterator node( _nodes.find( it_->first.substr( 0, static_cast<size_t>( i ) ) ) );
+		if ( node == _nodes.end() ) {
+			continue;
+		}
+		for ( candidates_t* candidates : { &node->second._mostUsed, &node->second._lastUsed } ) {
+			candidates_t::iterator c( find( candidates->begin(), candidates->end(), it_ ) );
+			if ( c != candidates->end() ) {
+				candidates->erase( c );
+			}
+		}
+	}
+}
+
+FrecencyIndex::Stats const* FrecencyIndex::stats( char const* data_, int length_ ) const {
+	stats_t::const_iterator it( _stats.find( string_view( data_, static_cast<size_t>( length_ ) ) ) );
+	return ( it != _stats.end() ? &it->second : nullptr );
+}
+
+/*
+ * Age buckets as used by browsers for URL bar ranking,
+ * a line used in the last hour counts four times its use count.
+ */
+double FrecencyIndex::score( Stats const& stats_, long long now_ ) {
+	long long age( now_ - stats_._lastUse );
+	double weight(
+		age < 3600 ? 4.0 : (
+			age < 86400 ? 2.0 : (
+				age < 7 * 86400 ? 1.0 : 0.5
+			)
+		)
+	);
+	return ( stats_._count * weight );
+}
+
+/* Tell if line \e l_ was used after \e r_, ties go to the line sorting first. */
+bool FrecencyIndex::later( long long lUse_, std::string const& l_, long long rUse_, std::string const& r_ ) {
+	return ( ( lUse_ > rUse_ ) || ( ( lUse_ == rUse_ ) && ( l_ < r_ ) ) );
+}
+
+/* Better hits compare less, ties go to the most recently used line. */
+bool FrecencyIndex::better( hit_t const& l_, hit_t const& r_ ) {
+	if ( l_.first != r_.first ) {
+		return ( l_.first > r_.first );
+	}
+	return ( later( l_.second->second._lastUse, l_.second->first, r_.second->second._lastUse, r_.second->first ) );
+}
+
+/*
+ * Make given line (new or just used again) a candidate if it is among
+ * the most used or the most recently used ones, whatever loses its
+ * place, or the line itself if it does not get one, raises the bound.
+ */
+void FrecencyIndex::admit( Node& node_, stats_t::const_iterator it_ ) {
+	auto count_less = []( stats_t::const_iterator l_, stats_t::const_iterator r_ ) {
+		return ( l_->second._count < r_->second._count );
+	};
+	candidates_t& mostUsed( node_._mostUsed );
+	int count( it_->second._count );
+	if ( find( mostUsed.begin(), mostUsed.end(), it_ ) != mostUsed.end() ) {
+		/* already there */
+	} else if ( static_cast<int>( mostUsed.size() ) < CANDIDATES ) {
+		mostUsed.push_back( it_ );
+		if ( static_cast<int>( mostUsed.size() ) == CANDIDATES ) {
+			node_._leastCount = ( *min_element( mostUsed.begin(), mostUsed.end(), count_less ) )->second._count;
+		}
+	} else if ( count <= node_._leastCount ) {
+		node_._countBound = max( node_._countBound, count );
+	} else {
+		candidates_t::iterator least( min_element( mostUsed.begin(), mostUsed.end(), count_less ) );
+		if ( count > ( *least )->second._count ) {
+			node_._countBound = max( node_._countBound, ( *least )->second._count );
+			*least = it_;
+			least = min_element( mostUsed.begin(), mostUsed.end(), count_less );
+		} else {
+			node_._countBound = max( node_._countBound, count );
+		}
+		node_._leastCount = ( *least )->second._count;
+	}
+	candidates_t& lastUsed( node_._lastUsed );
+	candidates_t::iterator pos( find( lastUsed.begin(), lastUsed.end(), it_ ) );
+	if ( pos != lastUsed.end() ) {
+		lastUsed.erase( pos );
+	}
+	pos = find_if(
+		lastUsed.begin(), lastUsed.end(),
+		[it_]( stats_t::const_iterator c_ ) { return ( later( it_->second._lastUse, it_->first, c_->second._lastUse, c_->first ) ); }
+	);
+	lastUsed.insert( pos, it_ );
+	if ( static_cast<int>( lastUsed.size() ) > CANDIDATES ) {
+		stats_t::const_iterator out( lastUsed.back() );
+		lastUsed.pop_back();
+		if ( later( out->second._lastUse, out->first, node_._useBound, node_._useBoundLine ) ) {
+			node_._useBound = out->second._lastUse;
+			node_._useBoundLine = out->first;
+		}
+	}
+}
+
+/*
+ * Rank candidates of given prefix, any other line scores at most
+ * _countBound uses at the weight of _useBound, so once the last hit
+ * to return beats such a line the answer is exact.
+ */
+bool FrecencyIndex::rank( Node const& node_, std::string_view prefix_, int count_, long long now_, lines_t& lines_ ) const {
+	if ( count_ > CANDIDATES ) {
+		return ( false );
+	}
+	vector<hit_t> hits;
+	for ( candidates_t const* candidates : { &node_._mostUsed, &node_._lastUsed } ) {
+		for ( stats_t::const_iterator it : *candidates ) {
+			if ( it->first.length() == prefix_.length() ) {
+				continue;
+			}
+			if ( ( candidates == &node_._lastUsed ) && ( find( node_._mostUsed.begin(), node_._mostUsed.end(), it ) != node_._mostUsed.end() ) ) {
+				continue;
+			}
+			hits.emplace_back( score( it->second, now_ ), it );
+		}
+	}
+	sort( hits.begin(), hits.end(), better );
+	bool others( ( node_._countBound > 0 ) && ( node_._useBound > LLONG_MIN ) );
+	if ( others ) {
+		if ( static_cast<int>( hits.size() ) < count_ ) {
+			return ( false );
+		}
+		hit_t const& last( hits[static_cast<size_t>( count_ - 1 )] );
+		double bound( score( Stats{ node_._countBound, node_._useBound }, now_ ) );
+		if (
+			( last.first < bound )
+			|| ( ( last.first == bound ) && ! later( last.second->second._lastUse, last.second->first, node_._useBound, node_._useBoundLine ) )
+		) {
+			return ( false );
+		}
+	}
+	if ( static_cast<int>( hits.size() ) > count_ ) {
+		hits.resize( static_cast<size_t>( count_ ) );
+	}
+	for ( hit_t const& hit : hits ) {
+		lines_.push_back( hit.second->first );
+	}
+	return ( true );
+}
+
+/*
+ * Lines sharing the prefix are a contiguous range of the map,
+ * best ones are kept in a min-heap of at most \e count_ elements.
+ * Candidates of the prefix are collected on the way.
+ */
+void FrecencyIndex::scan( std::string_view prefix_, int count_, long long now_, lines_t& lines_ ) const {
+	vector<hit_t> heap;
+	heap.reserve( static_cast<size_t>( count_ ) + 1 );
+	Node node;
+	int lines( 0 );
+	for ( stats_t::const_iterator it( _stats.lower_bound( prefix_ ) ), end( _stats.end() ); it != end; ++ it ) {
+		if ( it->first.compare( 0, prefix_.length(), prefix_ ) != 0 ) {
+			break;
+		}
+		admit( node, it );
+		++ lines;
+		if ( it->first.length() == prefix_.length() ) {
+			continue;
+		}
+		hit_t hit( score( it->second, now_ ), it );
+		if ( static_cast<int>( heap.size() ) < count_ ) {
+			heap.push_back( hit );
+			push_heap( heap.begin(), heap.end(), better );
+		} else if ( better( hit, heap.front() ) ) {
+			pop_heap( heap.begin(), heap.end(), better );
+			heap.back() = hit;
+			push_heap( heap.begin(), heap.end(), better );
+		}
+	}
+	sort_heap( heap.begin(), heap.end(), better );
+	for ( hit_t const& hit : heap ) {
+		lines_.push_back( hit.second->first );
+	}
+	if ( lines < NODE_MIN_LINES ) {
+		return;
+	}
+	if ( static_cast<int>( _nodes.size() ) >= MAX_NODES ) {
+		_nodes.clear();
+		_nodeDepth = 0;
+	}
+	_nodes[string( prefix_ )] = std::move( node );
+	_nodeDepth = max( _nodeDepth, static_cast<int>( prefix_.length() ) );
+}
+
+void FrecencyIndex::top( char const* prefix_, int length_, int count_, long long now_, lines_t& lines_ ) const {
+	lines_.clear();
+	if ( count_ <= 0 ) {
+		return;
+	}
+	string_view prefix( prefix_, static_cast<size_t>( length_ ) );
+	nodes_t::const_iterator node( _nodes.find( string( prefix ) ) );
+	if ( ( node != _nodes.end() ) && rank( node->second, prefix, count_, now_, lines_ ) ) {
+		return;
+	}
+	scan( prefix, count_, now_, lines_ );
+}
+
+void FrecencyIndex::clear( void ) {
+	_stats.clear();
+	_nodes.clear();
+	_nodeDepth = 0;
+}
+
+}
@@ -0,0 +1,98 @@
+#ifndef REPLXX_FRECENCYINDEX_HXX_INCLUDED
+#define REPLXX_FRECENCYINDEX_HXX_INCLUDED 1
+
+#include <map>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+namespace replxx {
+
+/*
+ * Usage statistics of distinct history lines.
+ *
+ * Every line keeps the number of times it was used and the time of
+ * its last use.  Lines are kept in lexicographic order, so lines
+ * starting with given prefix form a contiguous range that is ranked
+ * by frecency: the use count weighted by how recent the last use is.
+ *
+ * Ranking a range means scoring every line in it, so prefixes found
+ * to have many lines keep a few candidates that are likely to rank best
+ * along with upper bounds on all the other lines, updated as lines are
+ * added and removed.  Queries answered from candidates alone are checked
+ * against the bounds, whatever the time is, and fall back to scoring
+ * the whole range (which refreshes the candidates) when the bounds
+ * are too loose.
+ */
+class FrecencyIndex {
+public:
+	struct Stats {
+		int _count;
+		long long _lastUse; // seconds since epoch
+	};
+	typedef std::vector<std::string> lines_t;
+private:
+	typedef std::map<std::string, Stats, std::less<>> stats_t;
+	typedef std::vector<stats_t::const_iterator> candidates_t;
+	/*
+	 * Lines of one prefix that are likely to rank best: the most used ones
+	 * and the most recently used ones.  No other line of the prefix was used
+	 * more than _countBound times, nor later than _useBound (or as late
+	 * and sorting before _useBoundLine).  Bounds only ever grow looser
+	 * as candidates are replaced or removed.
+	 */
+	struct Node {
+		candidates_t _mostUsed;
+		candidates_t _lastUsed; // most recently used first
+		int _leastCount;        // no more than use count of any of _mostUsed, once it is full
+		int _countBound;
+		long long _useBound;
+		std::string _useBoundLine;
+		Node( void );
+	};
+	typedef std::unordered_map<std::string, Node> nodes_t;
+	typedef std::pair<double, stats_t::const_iterator> hit_t;
+	stats_t _stats;
+	mutable nodes_t _nodes; // keyed by prefix
+	mutable int _nodeDepth; // length of the longest prefix with a node
+public:
+	FrecencyIndex( void );
+	void add( char const*, int, long long timestamp );
+	/*! \brief Forget one use of given line.
+	 *
+	 * The line is dropped once its use count gets to zero.
+	 */
+	void remove( char const*, int );
+	/*! \brief Forget given line altogether.
+	 */
+	void forget( char const*, int );
+	/*! \brief Find most frecent lines starting with given prefix.
+	 *
+	 * The prefix itself is never returned.
+	 *
+	 * \param count_ - maximum number of lines to return.
+	 * \param now_ - current time, in seconds since epoch.
+	 * \param lines_[out] - found lines, most frecent first.
+	 */
+	void top( char const* prefix_, int length_, int count_, long long now_, lines_t& lines_ ) const;
+	Stats const* stats( char const*, int ) const;
+	static double score( Stats const&, long long now_ );
+	int size( void ) const {
+		return ( static_cast<int>( _stats.size() ) );
+	}
+	void clear( void );
+private:
+	static void admit( Node&, stats_t::const_iterator );
+	static bool later( long long, std::string const&, long long, std::string const& );
+	static bool better( hit_t const&, hit_t const& );
+	bool rank( Node const&, std::string_view, int, long long, lines_t& ) const;
+	void scan( std::string_view, int, long long, lines_t& ) const;
+	void drop( stats_t::const_iterator );
+	FrecencyIndex( FrecencyIndex const& ) = delete;
+	FrecencyIndex& operator = ( FrecencyIndex const& ) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fuzzyindex.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+/* Set in signatures of all live non-empty lines, so dead slots never match. */
+unsigned int const LIVE( 1u << 31 );
+
+/*
+ * Bit of every byte value: one per ASCII letter regardless of case,
+ * one for all digits, a few for common punctuation, one for the rest.
+ */
+struct ByteBits {
+	unsigned int _bits[256];
+	ByteBits( void ) {
+		for ( int c( 0 ); c < 256; ++ c ) {
+			int bit( 30 );
+			if ( ( c >= 'a' ) && ( c <= 'z' ) ) {
+				bit = c - 'a';
+			} else if ( ( c >= 'A' ) && ( c <= 'Z' ) ) {
+				bit = c - 'A';
+			} else if ( ( c >= '0' ) && ( c <= '9' ) ) {
+				bit = 26;
+			} else if ( c == ' ' ) {
+				bit = 27;
+			} else if ( ( c == '-' ) || ( c == '_' ) ) {
+				bit = 28;
+			} else if ( ( c == '.' ) || ( c == '/' ) ) {
+				bit = 29;
+			}
+			_bits[c] = 1u << bit;
+		}
+	}
+};
+
+inline unsigned int signature( char const* data_, int length_ ) {
+	static ByteBits const byteBits;
+	unsigned char const* data( reinterpret_cast<unsigned char const*>( data_ ) );
+	unsigned int sig( 0 );
+	for ( int i( 0 ); i < length_; ++ i ) {
+		sig |= byteBits._bits[data[i]];
+	}
+	return ( sig );
+}
+
+}
+
+FuzzyIndex::FuzzyIndex( void )
+	: _signatures()
+	, _base( 0 )
+	, _first( 0 ) {
+}
+
+unsigned int FuzzyIndex::query( char const* data_, int length_ ) {
+	return ( signature( data_, length_ ) | LIVE );
+}
+
+void FuzzyIndex::add( serial_t serial_, char const* data_, int length_ ) {
+	if ( _signatures.empty() ) {
+		_base = serial_;
+		_first = 0;
+	}
+	/* serials skipped over (reserved for lazily loaded lines) stay dead */
+	_signatures.resize( serial_ - _base, 0 );
+	_signatures.push_back( length_ > 0 ? ( signature( data_, length_ ) | LIVE ) : 0 );
+}
+
+void FuzzyIndex::remove( serial_t serial_ ) {
+	long long slot( static_cast<long long>( serial_ ) - _base );
+	if ( ( slot >= _first ) && ( slot < static_cast<long long>( _signatures.size() ) ) ) {
+		_signatures[static_cast<size_t>( slot )] = 0;
+	}
+}
+
+void FuzzyIndex::remove_last( serial_t serial_ ) {
+	long long slot( static_cast<long long>( serial_ ) - _base );
+	if ( slot < static_cast<long long>( _signatures.size() ) ) {
+		_signatures.resize( static_cast<size_t>( max( slot, static_cast<long long>( _first ) ) ) );
+	}
+}
+
+/*
+ * Dead slots at the front are dropped in bulk
+ * once they outnumber the remaining ones.
+ */
+void FuzzyIndex::remove_first( serial_t serial_ ) {
+	long long slot( static_cast<long long>( serial_ ) - _base );
+	if ( slot < _first ) {
+		return;
+	}
+	_first = static_cast<int>( min( slot + 1, static_cast<long long>( _signatures.size() ) ) );
+	if ( _first > ( static_cast<int>( _signatures.size() ) - _first ) ) {
+		_signatures.erase( _signatures.begin(), _signatures.begin() + _first );
+		_base += static_cast<serial_t>( _first );
+		_first = 0;
+	}
+}
+
+void FuzzyIndex::candidates( unsigned int query_, serial_t from_, serial_t to_, serials_t& found_ ) const {
+	int i( static_cast<int>( max( static_cast<long long>( from_ ) - _base, static_cast<long long>( _first ) ) ) );
+	int end( static_cast<int>( min( static_cast<long long>( to_ ) - _base, static_cast<long long>( _signatures.size() ) ) ) );
+	unsigned int const* sig( _signatures.data() );
+#ifdef __SSE2__
+	__m128i const q( _mm_set1_epi32( static_cast<int>( query_ ) ) );
+	for ( ; ( i + 16 ) <= end; i += 16 ) {
+		__m128i const* block( reinterpret_cast<__m128i const*>( sig + i ) );
+		__m128i m0( _mm_cmpeq_epi32( _mm_and_si128( _mm_loadu_si128( block ), q ), q ) );
+		__m128i m1( _mm_cmpeq_epi32( _mm_and_si128( _mm_loadu_si128( block + 1 ), q ), q ) );
+		__m128i m2( _mm_cmpeq_epi32( _mm_and_si128( _mm_loadu_si128( block + 2 ), q ), q ) );
+		__m128i m3( _mm_cmpeq_epi32( _mm_and_si128( _mm_loadu_si128( block + 3 ), q ), q ) );
+		unsigned mask( static_cast<unsigned>( _mm_movemask_epi8( _mm_packs_epi16( _mm_packs_epi32( m0, m1 ), _mm_packs_epi32( m2, m3 ) ) ) ) );
+		while ( mask != 0 ) {
+			found_.push_back( _base + static_cast<serial_t>( i + __builtin_ctz( mask ) ) );
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for ( ; i < end; ++ i ) {
+		if ( ( sig[i] & query_ ) == query_ ) {
+			found_.push_back( _base + static_cast<serial_t>( i ) );
+		}
+	}
+}
+
+void FuzzyIndex::clear( void ) {
+	_signatures.clear();
+	_base = 0;
+	_first = 0;
+}
+
+}
+
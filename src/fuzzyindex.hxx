@@ -0,0 +1,61 @@
+#ifndef REPLXX_FUZZYINDEX_HXX_INCLUDED
+#define REPLXX_FUZZYINDEX_HXX_INCLUDED 1
+
+#include <vector>
+
+namespace replxx {
+
+/*
+ * Character presence signatures of history lines for fuzzy search.
+ *
+ * Every line gets a 32 bit mask of the byte classes it contains (ASCII
+ * letters case folded, digits and a few groups of punctuation), a line
+ * can contain a query as a subsequence only if its signature covers
+ * the query's one.  Signatures are kept in one array indexed by serial
+ * number, so candidates are picked 16 lines at a time without touching
+ * the lines themselves.
+ * Lines are expected to be added with increasing serial numbers.
+ * Slots of lines removed from the middle (and of empty lines) are
+ * zero and never match.
+ */
+class FuzzyIndex {
+public:
+	typedef unsigned int serial_t;
+	typedef std::vector<serial_t> serials_t;
+private:
+	typedef std::vector<unsigned int> signatures_t;
+	signatures_t _signatures;
+	serial_t _base; // serial of _signatures[0]
+	int _first;     // slots before this one belong to evicted lines
+public:
+	FuzzyIndex( void );
+	/*! \brief Signature a line must cover to match given query.
+	 */
+	static unsigned int query( char const*, int );
+	void add( serial_t, char const*, int );
+	/*! \brief Forget a line removed from the middle.
+	 */
+	void remove( serial_t );
+	/*! \brief Forget the most recently added line (and anything newer).
+	 */
+	void remove_last( serial_t );
+	/*! \brief Forget the oldest line (and anything older).
+	 */
+	void remove_first( serial_t );
+	/*! \brief Find lines that may match the query.
+	 *
+	 * \param query_ - signature from query().
+	 * \param from_, to_ - range of serials to search, \e to_ excluded.
+	 * \param found_ - serials of candidate lines are appended here, ascending.
+	 */
+	void candidates( unsigned int query_, serial_t from_, serial_t to_, serials_t& found_ ) const;
+	void clear( void );
+private:
+	FuzzyIndex( FuzzyIndex const& ) = delete;
+	FuzzyIndex& operator = ( FuzzyIndex const& ) = delete;
+};
+
+}
+
+#endif
+
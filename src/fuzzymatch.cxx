@@ -0,0 +1,191 @@
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fuzzymatch.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+/* Scoring constants follow fzf. */
+static int const SCORE_MATCH( 16 );
+static int const SCORE_GAP_START( -3 );
+static int const SCORE_GAP_EXTENSION( -1 );
+static int const BONUS_BOUNDARY( SCORE_MATCH / 2 );
+static int const BONUS_NON_WORD( SCORE_MATCH / 2 );
+static int const BONUS_CAMEL( BONUS_BOUNDARY - 1 );
+static int const BONUS_CONSECUTIVE( -( SCORE_GAP_START + SCORE_GAP_EXTENSION ) );
+static int const BONUS_FIRST_CHAR_MULTIPLIER( 2 );
+
+enum class CHAR_CLASS {
+	NON_WORD,
+	LOWER,
+	UPPER,
+	NUMBER
+};
+
+inline CHAR_CLASS char_class( unsigned char c_ ) {
+	if ( ( c_ >= 'a' ) && ( c_ <= 'z' ) ) {
+		return ( CHAR_CLASS::LOWER );
+	} else if ( ( c_ >= 'A' ) && ( c_ <= 'Z' ) ) {
+		return ( CHAR_CLASS::UPPER );
+	} else if ( ( c_ >= '0' ) && ( c_ <= '9' ) ) {
+		return ( CHAR_CLASS::NUMBER );
+	}
+	return ( c_ >= 0x80 ? CHAR_CLASS::LOWER : CHAR_CLASS::NON_WORD );
+}
+
+inline int bonus( CHAR_CLASS prev_, CHAR_CLASS class_ ) {
+	if ( ( prev_ == CHAR_CLASS::NON_WORD ) && ( class_ != CHAR_CLASS::NON_WORD ) ) {
+		return ( BONUS_BOUNDARY );
+	} else if (
+		( ( prev_ == CHAR_CLASS::LOWER ) && ( class_ == CHAR_CLASS::UPPER ) )
+		|| ( ( prev_ != CHAR_CLASS::NUMBER ) && ( class_ == CHAR_CLASS::NUMBER ) )
+	) {
+		return ( BONUS_CAMEL );
+	} else if ( class_ == CHAR_CLASS::NON_WORD ) {
+		return ( BONUS_NON_WORD );
+	}
+	return ( 0 );
+}
+
+/*
+ * Position of the first occurrence of either \e a_ or \e b_ in data_[from_, length_),
+ * 16 bytes are examined at a time where SSE2 is available.
+ */
+inline int find_either( unsigned char const* data_, int from_, int length_, char a_, char b_ ) {
+	int i( from_ );
+#ifdef __SSE2__
+	__m128i const va( _mm_set1_epi8( a_ ) );
+	__m128i const vb( _mm_set1_epi8( b_ ) );
+	for ( ; ( i + 16 ) <= length_; i += 16 ) {
+		__m128i chunk( _mm_loadu_si128( reinterpret_cast<__m128i const*>( data_ + i ) ) );
+		int mask( _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( chunk, va ), _mm_cmpeq_epi8( chunk, vb ) ) ) );
+		if ( mask != 0 ) {
+			return ( i + __builtin_ctz( static_cast<unsigned>( mask ) ) );
+		}
+	}
+	if ( ( i < length_ ) && ( length_ >= 16 ) ) {
+		/* the tail is covered by one more block overlapping bytes already examined */
+		int base( length_ - 16 );
+		__m128i chunk( _mm_loadu_si128( reinterpret_cast<__m128i const*>( data_ + base ) ) );
+		unsigned mask( static_cast<unsigned>( _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( chunk, va ), _mm_cmpeq_epi8( chunk, vb ) ) ) ) );
+		mask &= ~0u << ( i - base );
+		return ( mask != 0 ? base + __builtin_ctz( mask ) : -1 );
+	}
+#endif
+	for ( ; i < length_; ++ i ) {
+		if ( ( data_[i] == static_cast<unsigned char>( a_ ) ) || ( data_[i] == static_cast<unsigned char>( b_ ) ) ) {
+			return ( i );
+		}
+	}
+	return ( -1 );
+}
+
+}
+
+FuzzyMatcher::FuzzyMatcher( std::string const& query_ )
+	: _query( query_ )
+	, _alternate( query_ ) {
+	bool caseSensitive( any_of( query_.begin(), query_.end(), []( char c_ ) { return ( ( c_ >= 'A' ) && ( c_ <= 'Z' ) ); } ) );
+	if ( ! caseSensitive ) {
+		for ( char& c : _alternate ) {
+			if ( ( c >= 'a' ) && ( c <= 'z' ) ) {
+				c = static_cast<char>( c - 'a' + 'A' );
+			}
+		}
+	}
+}
+
+inline bool FuzzyMatcher::equal( char c_, int pos_ ) const {
+	return ( ( c_ == _query[pos_] ) || ( c_ == _alternate[pos_] ) );
+}
+
+bool FuzzyMatcher::match( char const* line_, int length_, int& score_ ) const {
+	int queryLength( static_cast<int>( _query.length() ) );
+	if ( queryLength == 0 ) {
+		score_ = 0;
+		return ( true );
+	}
+	if ( length_ < queryLength ) {
+		return ( false );
+	}
+	unsigned char const* line( reinterpret_cast<unsigned char const*>( line_ ) );
+	/* find the first complete match */
+	int pos( 0 );
+	int first( -1 );
+	for ( int i( 0 ); i < queryLength; ++ i ) {
+		pos = find_either( line, pos, length_, _query[i], _alternate[i] );
+		if ( pos < 0 ) {
+			return ( false );
+		}
+		if ( first < 0 ) {
+			first = pos;
+		}
+		++ pos;
+	}
+	int end( pos );
+	/* walk back to find the shortest window ending there */
+	int start( first );
+	for ( int i( end - 1 ), q( queryLength - 1 ); i >= first; -- i ) {
+		if ( equal( line_[i], q ) && ( -- q < 0 ) ) {
+			start = i;
+			break;
+		}
+	}
+	score_ = score( line, start, end );
+	return ( true );
+}
+
+/*
+ * Every matched character gets at most a boundary bonus,
+ * the first one twice, gaps only take points away.
+ */
+int FuzzyMatcher::max_score( void ) const {
+	int queryLength( static_cast<int>( _query.length() ) );
+	return ( queryLength > 0 ? queryLength * SCORE_MATCH + ( queryLength + 1 ) * BONUS_BOUNDARY : 0 );
+}
+
+int FuzzyMatcher::score( unsigned char const* line_, int start_, int end_ ) const {
+	int queryLength( static_cast<int>( _query.length() ) );
+	int score( 0 );
+	int q( 0 );
+	int consecutive( 0 );
+	int firstBonus( 0 );
+	bool inGap( false );
+	CHAR_CLASS prev( start_ > 0 ? char_class( line_[start_ - 1] ) : CHAR_CLASS::NON_WORD );
+	for ( int i( start_ ); i < end_; ++ i ) {
+		CHAR_CLASS cls( char_class( line_[i] ) );
+		if ( ( q < queryLength ) && equal( static_cast<char>( line_[i] ), q ) ) {
+			score += SCORE_MATCH;
+			int b( bonus( prev, cls ) );
+			if ( consecutive == 0 ) {
+				firstBonus = b;
+			} else {
+				if ( b == BONUS_BOUNDARY ) {
+					firstBonus = b;
+				}
+				b = max( max( b, firstBonus ), BONUS_CONSECUTIVE );
+			}
+			score += ( q == 0 ) ? b * BONUS_FIRST_CHAR_MULTIPLIER : b;
+			inGap = false;
+			++ consecutive;
+			++ q;
+		} else {
+			score += inGap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+			inGap = true;
+			consecutive = 0;
+			firstBonus = 0;
+		}
+		prev = cls;
+	}
+	return ( score );
+}
+
+}
+
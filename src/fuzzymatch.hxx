@@ -0,0 +1,51 @@
+#ifndef REPLXX_FUZZYMATCH_HXX_INCLUDED
+#define REPLXX_FUZZYMATCH_HXX_INCLUDED 1
+
+#include <string>
+#include <vector>
+
+namespace replxx {
+
+/*
+ * fzf style fuzzy matching of a query against history lines.
+ *
+ * A line matches if it contains all query bytes in order.  The shortest
+ * window ending at the first complete match is scored, rewarding
+ * consecutive matched characters and characters at word boundaries
+ * and penalizing gaps.  Matching is case insensitive (for ASCII) unless
+ * the query contains an upper case letter.
+ */
+class FuzzyMatcher {
+public:
+	struct Match {
+		int _index; // history entry index
+		int _score;
+	};
+	typedef std::vector<Match> matches_t;
+private:
+	std::string _query;
+	std::string _alternate; // other case variant of each query byte
+public:
+	explicit FuzzyMatcher( std::string const& query_ );
+	/*! \brief Score given line against the query.
+	 *
+	 * \return True iff the line matches, its score is stored in \e score_.
+	 */
+	bool match( char const* line_, int length_, int& score_ ) const;
+	/*! \brief Highest score any line can get.
+	 */
+	int max_score( void ) const;
+	/*! \brief Tell if \e l_ should be ranked before \e r_.
+	 */
+	static bool better( Match const& l_, Match const& r_ ) {
+		return ( ( l_._score > r_._score ) || ( ( l_._score == r_._score ) && ( l_._index > r_._index ) ) );
+	}
+private:
+	bool equal( char, int ) const;
+	int score( unsigned char const*, int, int ) const;
+};
+
+}
+
+#endif
+
@@ -1,95 +1,1130 @@
 #include <fstream>
 #include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 
 #ifndef _WIN32
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
 
 #endif /* _WIN32 */
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "history.hxx"
+#include "compression.hxx"
+#include "util.hxx"
 
 using namespace std;
 
 namespace replxx {
 
 static int const REPLXX_DEFAULT_HISTORY_MAX_LEN( 1000 );
+/*
+ * In append-only mode the history file is allowed to grow up to
+ * this many times the maximum history size before it is compacted.
+ */
+static int const REPLXX_HISTORY_COMPACTION_RATIO( 2 );
+/*
+ * Number of trailing bytes of a shared history file we remember
+ * to tell appends by other processes from a rewrite.
+ */
+static int const REPLXX_HISTORY_TAIL_CHECK_SIZE( 64 );
+/*
+ * Fuzzy search spreads scoring over several threads
+ * only for histories at least this big.
+ */
+static int const REPLXX_FUZZY_SEARCH_PARALLEL_THRESHOLD( 100000 );
+/*
+ * Fuzzy search scans entries in blocks of that many,
+ * newest block first, and may stop between blocks.
+ */
+static int const REPLXX_FUZZY_SEARCH_BLOCK( 65536 );
+/*
+ * With parallel search enabled, histories at least this big are
+ * scanned by the search pool instead of being indexed.
+ */
+static int const REPLXX_PARALLEL_SEARCH_THRESHOLD( 100000 );
+/*
+ * With compression enabled that many newest arena chunks stay
+ * uncompressed, and that many older ones are kept decompressed
+ * once accessed.
+ */
+static int const REPLXX_HISTORY_HOT_CHUNKS( 2 );
+static int const REPLXX_HISTORY_INFLATED_CHUNKS( 8 );
+/*
+ * Binary history file layout, all integers are little endian:
+ *
+ * header:  "RPLXHIST", u32 version, u32 reserved
+ * records: u32 length, u32 flags (reserved), i64 timestamp, line bytes
+ * index:   u64 offset of every record
+ * footer:  u64 offset of the index, u64 number of records, "RPLXINDX"
+ *
+ * In the compressed version records are grouped in blocks of
+ * u32 compressed size, u32 raw size and lz_compress()ed records,
+ * the index holds u64 block offset and u64 record offset within
+ * the decompressed block.
+ */
+static char const REPLXX_HISTORY_BINARY_MAGIC[] = "RPLXHIST";
+static char const REPLXX_HISTORY_INDEX_MAGIC[] = "RPLXINDX";
+static int const REPLXX_HISTORY_MAGIC_SIZE( 8 );
+static int const REPLXX_HISTORY_BINARY_VERSION( 1 );
+static int const REPLXX_HISTORY_COMPRESSED_VERSION( 2 );
+static int const REPLXX_HISTORY_BLOCK_SIZE( 64 * 1024 );
+static int const REPLXX_HISTORY_BLOCK_HEADER_SIZE( 8 );
+static int const REPLXX_HISTORY_HEADER_SIZE( 16 );
+static int const REPLXX_HISTORY_RECORD_HEADER_SIZE( 16 );
+static int const REPLXX_HISTORY_FOOTER_SIZE( 24 );
+
+namespace {
+
+void put_int( std::string& out_, unsigned long long val_, int bytes_ ) {
+	for ( int i( 0 ); i < bytes_; ++ i ) {
+		out_.push_back( static_cast<char>( ( val_ >> ( 8 * i ) ) & 0xff ) );
+	}
+}
+
+unsigned long long get_int( char const* in_, int bytes_ ) {
+	unsigned long long val( 0 );
+	for ( int i( bytes_ - 1 ); i >= 0; -- i ) {
+		val = ( val << 8 ) | static_cast<unsigned char>( in_[i] );
+	}
+	return ( val );
+}
+
+long long file_size( std::string const& filename_ ) {
+	ifstream f( filename_, ios::binary | ios::ate );
+	return ( f ? static_cast<long long>( f.tellg() ) : -1 );
+}
+
+/*
+ * FNV-1a hash of a history line.
+ */
+unsigned long long line_hash( char const* data_, int length_ ) {
+	unsigned long long h( 14695981039346656037ULL );
+	for ( int i( 0 ); i < length_; ++ i ) {
+		h ^= static_cast<unsigned char>( data_[i] );
+		h *= 1099511628211ULL;
+	}
+	return ( h );
+}
+
+/*
+ * Size and modification time (in nanoseconds) of given file.
+ */
+bool file_stamp( std::string const& filename_, long long& size_, long long& stamp_ ) {
+#ifndef _WIN32
+	struct stat st;
+	if ( stat( filename_.c_str(), &st ) != 0 ) {
+		return ( false );
+	}
+	size_ = static_cast<long long>( st.st_size );
+#ifdef __APPLE__
+	stamp_ = static_cast<long long>( st.st_mtimespec.tv_sec ) * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+	stamp_ = static_cast<long long>( st.st_mtim.tv_sec ) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+	return ( true );
+#else
+	size_ = file_size( filename_ );
+	stamp_ = 0;
+	return ( size_ >= 0 );
+#endif
+}
+
+/*
+ * Advisory whole file lock held for the lifetime of the object.
+ * Where locking is not available (or fails) we carry on unlocked.
+ */
+class FileLock {
+	int _fd;
+public:
+	FileLock( void )
+		: _fd( -1 ) {
+	}
+	void acquire( std::string const& filename_, bool exclusive_ ) {
+#ifndef _WIN32
+		_fd = open( filename_.c_str(), exclusive_ ? ( O_RDWR | O_CREAT ) : O_RDONLY, S_IRUSR | S_IWUSR );
+		if ( _fd < 0 ) {
+			return;
+		}
+		while ( ( flock( _fd, exclusive_ ? LOCK_EX : LOCK_SH ) != 0 ) && ( errno == EINTR ) ) {
+		}
+#else
+		static_cast<void>( filename_ );
+		static_cast<void>( exclusive_ );
+#endif
+	}
+	~FileLock( void ) {
+#ifndef _WIN32
+		if ( _fd >= 0 ) {
+			flock( _fd, LOCK_UN );
+			::close( _fd );
+		}
+#endif
+	}
+private:
+	FileLock( FileLock const& ) = delete;
+	FileLock& operator = ( FileLock const& ) = delete;
+};
+
+/*
+ * Read-only view of a whole file, memory mapped where possible.
+ */
+class FileView {
+	char const* _data;
+	long long _size;
+	bool _mapped;
+	std::vector<char> _buffer;
+public:
+	explicit FileView( std::string const& filename_ )
+		: _data( nullptr )
+		, _size( -1 )
+		, _mapped( false )
+		, _buffer() {
+#ifndef _WIN32
+		int fd( open( filename_.c_str(), O_RDONLY ) );
+		if ( fd < 0 ) {
+			return;
+		}
+		struct stat st;
+		if ( ( fstat( fd, &st ) == 0 ) && S_ISREG( st.st_mode ) ) {
+			_size = static_cast<long long>( st.st_size );
+			if ( _size == 0 ) {
+				::close( fd );
+				return;
+			}
+			void* p( mmap( nullptr, static_cast<size_t>( _size ), PROT_READ, MAP_PRIVATE, fd, 0 ) );
+			if ( p != MAP_FAILED ) {
+#ifdef MADV_SEQUENTIAL
+				madvise( p, static_cast<size_t>( _size ), MADV_SEQUENTIAL );
+#endif
+				_data = static_cast<char const*>( p );
+				_mapped = true;
+				::close( fd );
+				return;
+			}
+		}
+		::close( fd );
+#endif
+		ifstream f( filename_, ios::binary | ios::ate );
+		if ( ! f ) {
+			_size = -1;
+			return;
+		}
+		_size = static_cast<long long>( f.tellg() );
+		_buffer.resize( static_cast<size_t>( _size ) );
+		f.seekg( 0 );
+		f.read( _buffer.data(), static_cast<streamsize>( _size ) );
+		_size = static_cast<long long>( f.gcount() );
+		_data = _buffer.data();
+	}
+	~FileView( void ) {
+#ifndef _WIN32
+		if ( _mapped ) {
+			munmap( const_cast<char*>( _data ), static_cast<size_t>( _size ) );
+		}
+#endif
+	}
+	bool valid( void ) const {
+		return ( _size >= 0 );
+	}
+	char const* data( void ) const {
+		return ( _data );
+	}
+	long long size( void ) const {
+		return ( _size );
+	}
+private:
+	FileView( FileView const& ) = delete;
+	FileView& operator = ( FileView const& ) = delete;
+};
+
+/*
+ * Collect offsets of all new line characters in the buffer,
+ * examining 16 bytes at a time where SSE2 is available.
+ */
+void find_line_ends( char const* data_, long long size_, std::vector<long long>& eols_ ) {
+	long long pos( 0 );
+#ifdef __SSE2__
+	__m128i const nl( _mm_set1_epi8( '\n' ) );
+	for ( ; ( pos + 16 ) <= size_; pos += 16 ) {
+		__m128i chunk( _mm_loadu_si128( reinterpret_cast<__m128i const*>( data_ + pos ) ) );
+		unsigned mask( static_cast<unsigned>( _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, nl ) ) ) );
+		while ( mask != 0 ) {
+			eols_.push_back( pos + __builtin_ctz( mask ) );
+			mask &= mask - 1;
+		}
+	}
+#endif
+	while ( pos < size_ ) {
+		void const* eol( memchr( data_ + pos, '\n', static_cast<size_t>( size_ - pos ) ) );
+		if ( ! eol ) {
+			break;
+		}
+		pos = static_cast<char const*>( eol ) - data_;
+		eols_.push_back( pos );
+		++ pos;
+	}
+}
+
+}
+
+/*
+ * Older part of a lazily loaded history file, scanned on a background
+ * thread.  The thread only touches this structure, the result is taken
+ * over by absorb_loaded() on the thread that owns the history.
+ */
+struct History::LazyLoad {
+	FileView _file;
+	long long _end;   // older lines lie in [0, _end) of the file
+	int _wanted;      // distinct lines needed to fill history, 0 for all
+	int _lineCount;   // lines in [0, _end)
+	std::vector<std::pair<long long, int>> _lines; // non-empty lines (offset, length), newest first
+	std::atomic<bool> _done;
+	std::thread _thread;
+	explicit LazyLoad( std::string const& filename_ )
+		: _file( filename_ )
+		, _end( 0 )
+		, _wanted( 0 )
+		, _lineCount( 0 )
+		, _lines()
+		, _done( false )
+		, _thread() {
+	}
+	void start( long long end_, int wanted_ ) {
+		_end = end_;
+		_wanted = wanted_;
+		_thread = std::thread( &LazyLoad::scan, this );
+	}
+	/*
+	 * Collect lines walking back from the end of the older part
+	 * until enough distinct consecutive ones are found.
+	 */
+	void scan( void ) {
+		char const* data( _file.data() );
+		std::vector<long long> eols;
+		eols.reserve( static_cast<size_t>( _end / 32 ) + 1 );
+		find_line_ends( data, _end, eols );
+		_lineCount = static_cast<int>( eols.size() );
+		int kept( 0 );
+		for ( int i( _lineCount - 1 ); i >= 0; -- i ) {
+			long long start( i > 0 ? eols[static_cast<size_t>( i - 1 )] + 1 : 0 );
+			long long end( eols[static_cast<size_t>( i )] );
+			void const* cr( memchr( data + start, '\r', static_cast<size_t>( end - start ) ) );
+			int len( static_cast<int>( ( cr ? static_cast<char const*>( cr ) - data : end ) - start ) );
+			if ( len == 0 ) {
+				continue;
+			}
+			if ( ! _lines.empty() ) {
+				std::pair<long long, int> const& newer( _lines.back() );
+				if ( ( len == newer.second ) && ( memcmp( data + start, data + newer.first, static_cast<size_t>( len ) ) == 0 ) ) {
+					continue;
+				}
+			}
+			_lines.emplace_back( start, len );
+			if ( ( _wanted > 0 ) && ( ++ kept >= _wanted ) ) {
+				break;
+			}
+		}
+		_done.store( true, std::memory_order_release );
+	}
+	~LazyLoad( void ) {
+		if ( _thread.joinable() ) {
+			_thread.join();
+		}
+	}
+};
 
 History::History()
-	: _data()
+	: _arena()
+	, _data( REPLXX_DEFAULT_HISTORY_MAX_LEN + 1 )
+	, _nextSerial( 0 )
+	, _searchIndex()
+	, _searchIndexed( false )
+	, _staleLines( 0 )
+	, _prefixIndex()
+	, _prefixIndexed( false )
+	, _fuzzyIndex()
+	, _fuzzyIndexed( false )
+	, _erasedLines( 0 )
+	, _uniqueIndex()
+	, _unique( false )
+	, _frecencyIndex()
+	, _frecent( false )
 	, _maxSize( REPLXX_DEFAULT_HISTORY_MAX_LEN )
 	, _maxLineLength( 0 )
 	, _index( 0 )
 	, _previousIndex( -2 )
-	, _recallMostRecent( false ) {
+	, _recallMostRecent( false )
+	, _appendOnly( false )
+	, _shared( false )
+	, _binary( false )
+	, _lazyLoad()
+	, _lazyLoadLines( 0 )
+	, _unsaved( 0 )
+	, _decoded()
+	, _decodedIndex()
+	, _decodedSize( 0 )
+	, _decodedBudget( 0 )
+	, _decodedScratch()
+	, _materialized()
+	, _searchPool()
+	, _persistedFile()
+	, _persistedSize( -1 )
+	, _persistedStamp( -1 )
+	, _persistedTail()
+	, _persistedLines( 0 ) {
+}
+
+History::~History( void ) {
 }
 
 void History::add( std::string const& line ) {
-	if ( ( _maxSize > 0 ) && ( _data.empty() || ( line != _data.back() ) ) ) {
-		if ( size() > _maxSize ) {
-			_data.erase( _data.begin() );
+	add( line.data(), static_cast<int>( line.length() ) );
+}
+
+void History::add( char const* line_, int length_ ) {
+	add( line_, length_, static_cast<long long>( time( nullptr ) ) );
+}
+
+void History::add( char const* line_, int length_, long long timestamp_ ) {
+	push( line_, length_, timestamp_, _unique );
+}
+
+void History::add_edit_slot( std::string const& line_ ) {
+	push( line_.data(), static_cast<int>( line_.length() ), static_cast<long long>( time( nullptr ) ), false );
+}
+
+void History::push( char const* line_, int length_, long long timestamp_, bool unique_ ) {
+	if ( ( _maxSize > 0 ) && ( _data.empty() || ! equals( _data.back(), line_, length_ ) ) ) {
+		if ( unique_ ) {
+			int duplicate( find_duplicate( line_, length_ ) );
+			if ( duplicate >= 0 ) {
+				erase( duplicate );
+			}
+		}
+		bool evict( _data.full() );
+		if ( evict ) {
+			unindex_first( _data.front() );
+			_arena.release( _data.front()._text );
 			if ( -- _previousIndex < -1 ) {
 				_previousIndex = -2;
 			}
 		}
-		if ( static_cast<int>( line.length() ) > _maxLineLength ) {
-			_maxLineLength = static_cast<int>( line.length() );
+		if ( length_ > _maxLineLength ) {
+			_maxLineLength = length_;
+		}
+		Entry e{ _arena.store( line_, length_ ), _nextSerial ++, timestamp_ };
+		_data.push_back( e );
+		index( e );
+		if ( evict ) {
+			compact_search_index();
+		}
+		if ( ++ _unsaved > size() ) {
+			_unsaved = size();
 		}
-		_data.push_back( line );
 	}
 }
 
 int History::save( std::string const& filename ) {
+	absorb_loaded( true );
+	if ( _binary ) {
+		return ( rewrite_binary( filename ) );
+	}
+	if ( _shared ) {
+		return ( sync( filename ) );
+	}
+	if (
+		_appendOnly
+		&& ( filename == _persistedFile )
+		&& ( file_size( filename ) == _persistedSize )
+		&& ( ( _persistedLines + _unsaved ) <= ( REPLXX_HISTORY_COMPACTION_RATIO * _maxSize ) )
+	) {
+		return ( append( filename ) );
+	}
+	return ( rewrite( filename ) );
+}
+
+int History::rewrite( std::string const& filename ) {
 #ifndef _WIN32
 	mode_t old_umask = umask( S_IXUSR | S_IRWXG| S_IRWXO );
 #endif
 	ofstream histFile( filename );
+#ifndef _WIN32
+	umask( old_umask );
+#endif
 	if ( ! histFile ) {
 		return ( -1 );
 	}
 #ifndef _WIN32
-	umask( old_umask );
 	chmod( filename.c_str(), S_IRUSR | S_IWUSR );
 #endif
-	for ( string const& h : _data ) {
-		if ( ! h.empty() ) {
-			histFile << h << endl;
+	string buffer;
+	int lines( 0 );
+	for ( Entry const& e : _data ) {
+		if ( e._text._length > 0 ) {
+			buffer.append( _arena.get( e._text ), e._text._length ).append( 1, '\n' );
+			++ lines;
 		}
 	}
+	histFile.write( buffer.data(), static_cast<streamsize>( buffer.length() ) );
+	histFile.close();
+	if ( ! histFile ) {
+		return ( -1 );
+	}
+	_persistedFile = filename;
+	remember_file( filename );
+	_persistedTail.clear();
+	remember_tail( buffer.data(), static_cast<long long>( buffer.length() ) );
+	_persistedLines = lines;
+	_unsaved = 0;
 	return ( 0 );
 }
 
-int History::load( std::string const& filename ) {
-	ifstream histFile( filename );
+std::function<void ( std::string& )> History::text_snapshot( void ) {
+	struct Snapshot {
+		LineArena::Snapshot _arena;
+		std::vector<LineArena::Line> _lines;
+	};
+	std::shared_ptr<Snapshot> snapshot( std::make_shared<Snapshot>() );
+	snapshot->_lines.reserve( _data.size() );
+	for ( Entry const& e : _data ) {
+		if ( e._text._length > 0 ) {
+			snapshot->_lines.push_back( e._text );
+		}
+	}
+	snapshot->_arena = _arena.snapshot();
+	return (
+		[snapshot]( std::string& contents_ ) {
+			for ( LineArena::Line const& line : snapshot->_lines ) {
+				contents_.append( snapshot->_arena.get( line ), static_cast<size_t>( line._length ) ).append( 1, '\n' );
+			}
+		}
+	);
+}
+
+int History::append( std::string const& filename ) {
+	string buffer;
+	int lines( 0 );
+	for ( int i( size() - _unsaved ); i < size(); ++ i ) {
+		if ( line_length( i ) > 0 ) {
+			buffer.append( line( i ), line_length( i ) ).append( 1, '\n' );
+			++ lines;
+		}
+	}
+	if ( lines > 0 ) {
+		ofstream histFile( filename, ios::app );
+		if ( ! histFile ) {
+			return ( -1 );
+		}
+		histFile.write( buffer.data(), static_cast<streamsize>( buffer.length() ) );
+		histFile.close();
+		if ( ! histFile ) {
+			return ( -1 );
+		}
+	}
+	remember_file( filename );
+	remember_tail( buffer.data(), static_cast<long long>( buffer.length() ) );
+	_persistedLines += lines;
+	_unsaved = 0;
+	return ( 0 );
+}
+
+/*
+ * Binary history is written to a temporary file first and renamed
+ * over the target, so a crash never leaves a truncated index behind.
+ */
+int History::rewrite_binary( std::string const& filename ) {
+	bool compressed( _arena.is_compressed() );
+	string buffer;
+	buffer.append( REPLXX_HISTORY_BINARY_MAGIC, REPLXX_HISTORY_MAGIC_SIZE );
+	put_int( buffer, static_cast<unsigned long long>( compressed ? REPLXX_HISTORY_COMPRESSED_VERSION : REPLXX_HISTORY_BINARY_VERSION ), 4 );
+	put_int( buffer, 0, 4 );
+	/* index entries, pairs of block offset and record offset in compressed version */
+	std::vector<unsigned long long> offsets;
+	offsets.reserve( static_cast<size_t>( size() ) * ( compressed ? 2 : 1 ) );
+	string block;
+	std::vector<char> packed;
+	auto flush = [&]() {
+		if ( block.empty() ) {
+			return;
+		}
+		packed.resize( static_cast<size_t>( lz_bound( static_cast<int>( block.length() ) ) ) );
+		int packedSize( lz_compress( block.data(), static_cast<int>( block.length() ), packed.data() ) );
+		put_int( buffer, static_cast<unsigned long long>( packedSize ), 4 );
+		put_int( buffer, block.length(), 4 );
+		buffer.append( packed.data(), static_cast<size_t>( packedSize ) );
+		block.clear();
+	};
+	for ( Entry const& e : _data ) {
+		if ( e._text._length == 0 ) {
+			continue;
+		}
+		string* out( &buffer );
+		if ( compressed ) {
+			if ( static_cast<int>( block.length() ) >= REPLXX_HISTORY_BLOCK_SIZE ) {
+				flush();
+			}
+			offsets.push_back( buffer.length() );
+			out = &block;
+		}
+		offsets.push_back( out->length() );
+		put_int( *out, static_cast<unsigned long long>( e._text._length ), 4 );
+		put_int( *out, 0, 4 );
+		put_int( *out, static_cast<unsigned long long>( e._timestamp ), 8 );
+		out->append( _arena.get( e._text ), e._text._length );
+	}
+	flush();
+	unsigned long long indexOffset( buffer.length() );
+	for ( unsigned long long offset : offsets ) {
+		put_int( buffer, offset, 8 );
+	}
+	put_int( buffer, indexOffset, 8 );
+	put_int( buffer, offsets.size() / ( compressed ? 2 : 1 ), 8 );
+	buffer.append( REPLXX_HISTORY_INDEX_MAGIC, REPLXX_HISTORY_MAGIC_SIZE );
+	std::string tmpName( filename + ".tmp" );
+#ifndef _WIN32
+	mode_t old_umask = umask( S_IXUSR | S_IRWXG| S_IRWXO );
+#endif
+	ofstream histFile( tmpName, ios::binary | ios::trunc );
+#ifndef _WIN32
+	umask( old_umask );
+#endif
+	if ( ! histFile ) {
+		return ( -1 );
+	}
+	histFile.write( buffer.data(), static_cast<streamsize>( buffer.length() ) );
+	histFile.close();
 	if ( ! histFile ) {
+		std::remove( tmpName.c_str() );
 		return ( -1 );
 	}
-	string line;
-	while ( getline( histFile, line ).good() ) {
-		string::size_type eol( line.find_first_of( "\r\n" ) );
-		if ( eol != string::npos ) {
-			line.erase( eol );
+#ifdef _WIN32
+	std::remove( filename.c_str() );
+#else
+	chmod( tmpName.c_str(), S_IRUSR | S_IWUSR );
+#endif
+	if ( std::rename( tmpName.c_str(), filename.c_str() ) != 0 ) {
+		std::remove( tmpName.c_str() );
+		return ( -1 );
+	}
+	_persistedFile.clear();
+	_unsaved = 0;
+	return ( 0 );
+}
+
+/*
+ * Add lines [0, lines_) of a history file, \e line_ gives text, length
+ * and timestamp of a line given its number. Lines are examined from
+ * the end of the file only until enough distinct consecutive lines are
+ * found to fill the whole history, older ones are never touched.
+ */
+template<typename line_t>
+void History::replay( int lines_, line_t const& line_ ) {
+	int first( 0 );
+	int kept( 0 );
+	char const* newer( nullptr );
+	int newerLength( 0 );
+	long long timestamp( 0 );
+	/* in unique mode only the first occurrence (from the end) of a line counts */
+	unique_index_t seen;
+	auto novel = [&]( int no_, char const* text_, int len_ ) {
+		unsigned long long hash( line_hash( text_, len_ ) );
+		auto range( seen.equal_range( hash ) );
+		for ( unique_index_t::const_iterator it( range.first ); it != range.second; ++ it ) {
+			int otherLength( 0 );
+			char const* other( line_( static_cast<int>( it->second ), otherLength, timestamp ) );
+			if ( ( otherLength == len_ ) && ( memcmp( other, text_, static_cast<size_t>( len_ ) ) == 0 ) ) {
+				return ( false );
+			}
 		}
-		if ( ! line.empty() ) {
-			add( line );
+		seen.insert( make_pair( hash, static_cast<serial_t>( no_ ) ) );
+		return ( true );
+	};
+	for ( int i( lines_ - 1 ); i >= 0; -- i ) {
+		int len( 0 );
+		char const* text( line_( i, len, timestamp ) );
+		if ( len == 0 ) {
+			continue;
+		}
+		if ( _unique ) {
+			if ( novel( i, text, len ) && ( ++ kept >= _data.capacity() ) ) {
+				first = i;
+				break;
+			}
+			continue;
+		}
+		if (
+			newer
+			&& ( ( len != newerLength ) || ( memcmp( text, newer, static_cast<size_t>( len ) ) != 0 ) )
+			&& ( ++ kept >= _data.capacity() )
+		) {
+			first = i;
+			break;
+		}
+		newer = text;
+		newerLength = len;
+	}
+	for ( int i( first ); i < lines_; ++ i ) {
+		int len( 0 );
+		char const* text( line_( i, len, timestamp ) );
+		if ( len > 0 ) {
+			add( text, len, timestamp );
 		}
 	}
+}
+
+/*
+ * Records are located through the offset index at the end of the file,
+ * so only the ones that make it into history are ever read.  In the
+ * compressed version only the blocks holding them are decompressed.
+ */
+int History::load_binary( char const* data_, long long size_ ) {
+	if ( size_ < ( REPLXX_HISTORY_HEADER_SIZE + REPLXX_HISTORY_FOOTER_SIZE ) ) {
+		return ( -1 );
+	}
+	unsigned long long version( get_int( data_ + REPLXX_HISTORY_MAGIC_SIZE, 4 ) );
+	bool compressed( version == static_cast<unsigned long long>( REPLXX_HISTORY_COMPRESSED_VERSION ) );
+	long long indexEntrySize( compressed ? 16 : 8 );
+	char const* footer( data_ + size_ - REPLXX_HISTORY_FOOTER_SIZE );
+	long long indexOffset( static_cast<long long>( get_int( footer, 8 ) ) );
+	long long count( static_cast<long long>( get_int( footer + 8, 8 ) ) );
+	long long indexEnd( size_ - REPLXX_HISTORY_FOOTER_SIZE );
+	if (
+		( ! compressed && ( version != static_cast<unsigned long long>( REPLXX_HISTORY_BINARY_VERSION ) ) )
+		|| ( memcmp( footer + 16, REPLXX_HISTORY_INDEX_MAGIC, REPLXX_HISTORY_MAGIC_SIZE ) != 0 )
+		|| ( indexOffset < REPLXX_HISTORY_HEADER_SIZE )
+		|| ( indexOffset > indexEnd )
+		|| ( count != ( ( indexEnd - indexOffset ) / indexEntrySize ) )
+		|| ( ( ( indexEnd - indexOffset ) % indexEntrySize ) != 0 )
+	) {
+		return ( -1 );
+	}
+	char const* index( data_ + indexOffset );
+	bool valid( true );
+	/* record at offset_ of [base_, base_ + limit_) */
+	auto record = [&valid]( char const* base_, long long first_, long long limit_, long long offset_, int& len_, long long& timestamp_ ) {
+		if ( ( offset_ < first_ ) || ( offset_ > ( limit_ - REPLXX_HISTORY_RECORD_HEADER_SIZE ) ) ) {
+			valid = false;
+			len_ = 0;
+			return ( base_ );
+		}
+		char const* rec( base_ + offset_ );
+		long long len( static_cast<long long>( get_int( rec, 4 ) ) );
+		if ( len > ( limit_ - offset_ - REPLXX_HISTORY_RECORD_HEADER_SIZE ) ) {
+			valid = false;
+			len_ = 0;
+			return ( base_ );
+		}
+		len_ = static_cast<int>( len );
+		timestamp_ = static_cast<long long>( get_int( rec + 8, 8 ) );
+		return ( rec + REPLXX_HISTORY_RECORD_HEADER_SIZE );
+	};
+	if ( ! compressed ) {
+		replay(
+			static_cast<int>( count ),
+			[&]( int no_, int& len_, long long& timestamp_ ) {
+				long long offset( static_cast<long long>( get_int( index + 8 * no_, 8 ) ) );
+				return ( record( data_, REPLXX_HISTORY_HEADER_SIZE, indexOffset, offset, len_, timestamp_ ) );
+			}
+		);
+		return ( valid ? 0 : -1 );
+	}
+	/* decompressed blocks stay around until loading is done, replay() revisits lines */
+	std::unordered_map<long long, std::string> blocks;
+	replay(
+		static_cast<int>( count ),
+		[&]( int no_, int& len_, long long& timestamp_ ) {
+			long long blockOffset( static_cast<long long>( get_int( index + 16 * no_, 8 ) ) );
+			long long offset( static_cast<long long>( get_int( index + 16 * no_ + 8, 8 ) ) );
+			std::unordered_map<long long, std::string>::iterator block( blocks.find( blockOffset ) );
+			if ( block == blocks.end() ) {
+				block = blocks.insert( make_pair( blockOffset, std::string() ) ).first;
+				long long packedSize( -1 );
+				long long rawSize( 0 );
+				if ( ( blockOffset >= REPLXX_HISTORY_HEADER_SIZE ) && ( blockOffset <= ( indexOffset - REPLXX_HISTORY_BLOCK_HEADER_SIZE ) ) ) {
+					packedSize = static_cast<long long>( get_int( data_ + blockOffset, 4 ) );
+					rawSize = static_cast<long long>( get_int( data_ + blockOffset + 4, 4 ) );
+				}
+				if (
+					( packedSize < 0 )
+					|| ( packedSize > ( indexOffset - blockOffset - REPLXX_HISTORY_BLOCK_HEADER_SIZE ) )
+					|| ( rawSize > ( packedSize * 255 + 16 ) )
+				) {
+					valid = false;
+				} else {
+					block->second.resize( static_cast<size_t>( rawSize ) );
+					valid = valid && lz_decompress(
+						data_ + blockOffset + REPLXX_HISTORY_BLOCK_HEADER_SIZE, static_cast<int>( packedSize ),
+						&block->second[0], static_cast<int>( rawSize )
+					);
+				}
+				if ( ! valid ) {
+					block->second.clear();
+				}
+			}
+			std::string const& raw( block->second );
+			return ( record( raw.data(), 0, static_cast<long long>( raw.length() ), offset, len_, timestamp_ ) );
+		}
+	);
+	return ( valid ? 0 : -1 );
+}
+
+/*
+ * The file is mapped and scanned for line ends first, only the lines
+ * that would survive the history size limit are copied into the arena.
+ */
+int History::load( std::string const& filename ) {
+	absorb_loaded( true );
+	if ( _shared && ( filename == _persistedFile ) ) {
+		return ( merge() < 0 ? -1 : 0 );
+	}
+	FileLock lock;
+	if ( _shared ) {
+		lock.acquire( filename, false );
+	}
+	std::unique_ptr<LazyLoad> lazyLoad( new LazyLoad( filename ) );
+	FileView const& file( lazyLoad->_file );
+	if ( ! file.valid() ) {
+		return ( -1 );
+	}
+	char const* data( file.data() );
+	long long fileSize( file.size() );
+	if (
+		( fileSize >= REPLXX_HISTORY_MAGIC_SIZE )
+		&& ( memcmp( data, REPLXX_HISTORY_BINARY_MAGIC, REPLXX_HISTORY_MAGIC_SIZE ) == 0 )
+	) {
+		_persistedFile.clear();
+		return ( load_binary( data, fileSize ) );
+	}
+	bool wasEmpty( _data.empty() );
+	/*
+	 * In lazy mode only the last _lazyLoadLines lines, found scanning
+	 * backwards, are loaded here, older ones are left to a background thread.
+	 */
+	long long tailStart( 0 );
+	if ( ( _lazyLoadLines > 0 ) && wasEmpty && ! _shared && ( _lazyLoadLines < _data.capacity() ) ) {
+		int found( 0 );
+		for ( long long pos( fileSize - 1 ); pos > 0; -- pos ) {
+			if ( ( data[pos - 1] == '\n' ) && ( ++ found == _lazyLoadLines ) ) {
+				tailStart = pos;
+				break;
+			}
+		}
+	}
+	std::vector<long long> eols;
+	eols.reserve( static_cast<size_t>( ( fileSize - tailStart ) / 32 ) + 1 );
+	find_line_ends( data + tailStart, fileSize - tailStart, eols );
+	bool terminated( eols.empty() ? ( fileSize == tailStart ) : ( ( tailStart + eols.back() ) == ( fileSize - 1 ) ) );
+	int lines( static_cast<int>( eols.size() ) + ( terminated ? 0 : 1 ) );
+	if ( tailStart > 0 ) {
+		/* serials below the tail are reserved for entries loaded later */
+		_nextSerial += static_cast<serial_t>( _data.capacity() );
+	}
+	replay(
+		lines,
+		[&]( int no_, int& len_, long long& timestamp_ ) {
+			long long start( tailStart + ( no_ > 0 ? eols[static_cast<size_t>( no_ - 1 )] + 1 : 0 ) );
+			long long end( tailStart + ( no_ < static_cast<int>( eols.size() ) ? eols[static_cast<size_t>( no_ )] : fileSize - tailStart ) );
+			void const* cr( memchr( data + start, '\r', static_cast<size_t>( end - start ) ) );
+			len_ = static_cast<int>( ( cr ? static_cast<char const*>( cr ) - data : end ) - start );
+			timestamp_ = 0;
+			return ( data + start );
+		}
+	);
+	if ( wasEmpty && terminated ) {
+		_persistedFile = filename;
+		remember_file( filename );
+		_persistedSize = fileSize;
+		_persistedTail.clear();
+		remember_tail( data, fileSize );
+		_persistedLines = lines;
+		_unsaved = 0;
+	} else {
+		_persistedFile.clear();
+	}
+	if ( tailStart > 0 ) {
+		/* in unique mode any older line may turn out to be novel, so all are needed */
+		lazyLoad->start( tailStart, _unique ? 0 : _data.capacity() );
+		_lazyLoad = std::move( lazyLoad );
+	}
 	return 0;
 }
 
+/*
+ * Older entries are put in front of the ones already in history,
+ * as many as fit, taking their reserved serials in descending order.
+ */
+int History::absorb_loaded( bool wait_ ) {
+	if ( ! _lazyLoad || ( ! wait_ && ! _lazyLoad->_done.load( std::memory_order_acquire ) ) ) {
+		return ( 0 );
+	}
+	std::unique_ptr<LazyLoad> lazyLoad( std::move( _lazyLoad ) );
+	lazyLoad->_thread.join();
+	char const* data( lazyLoad->_file.data() );
+	int space( _data.capacity() - size() );
+	std::vector<Entry> older;
+	serial_t serial( _data.empty() ? _nextSerial : _data.front()._serial );
+	char const* newer( _data.empty() ? nullptr : line( 0 ) );
+	int newerLength( _data.empty() ? 0 : line_length( 0 ) );
+	unique_index_t seen;
+	for ( std::pair<long long, int> const& l : lazyLoad->_lines ) {
+		if ( static_cast<int>( older.size() ) >= space ) {
+			break;
+		}
+		char const* text( data + l.first );
+		int len( l.second );
+		if ( _unique ) {
+			if ( find_duplicate( text, len ) >= 0 ) {
+				continue;
+			}
+			unsigned long long hash( line_hash( text, len ) );
+			auto range( seen.equal_range( hash ) );
+			bool duplicate( false );
+			for ( unique_index_t::const_iterator it( range.first ); ! duplicate && ( it != range.second ); ++ it ) {
+				duplicate = equals( older[it->second], text, len );
+			}
+			if ( duplicate ) {
+				continue;
+			}
+			seen.insert( make_pair( hash, static_cast<serial_t>( older.size() ) ) );
+		} else if ( newer && ( len == newerLength ) && ( memcmp( text, newer, static_cast<size_t>( len ) ) == 0 ) ) {
+			continue;
+		}
+		older.push_back( Entry{ _arena.store( text, len ), -- serial, 0 } );
+		if ( len > _maxLineLength ) {
+			_maxLineLength = len;
+		}
+		newer = text;
+		newerLength = len;
+	}
+	_persistedLines += lazyLoad->_lineCount;
+	int added( static_cast<int>( older.size() ) );
+	if ( added == 0 ) {
+		return ( 0 );
+	}
+	lines_t merged( _data.capacity() );
+	for ( std::vector<Entry>::reverse_iterator it( older.rbegin() ), end( older.rend() ); it != end; ++ it ) {
+		merged.push_back( *it );
+	}
+	for ( Entry const& e : _data ) {
+		merged.push_back( e );
+	}
+	_data = std::move( merged );
+	drop_search_indexes();
+	for ( Entry const& e : older ) {
+		index( e );
+	}
+	_index += added;
+	if ( _previousIndex >= 0 ) {
+		_previousIndex += added;
+	}
+	return ( added );
+}
+
+/*
+ * Shared history is saved under an exclusive lock, lines written by other
+ * processes since our last visit are merged first so a rewrite keeps them.
+ */
+int History::sync( std::string const& filename ) {
+	FileLock lock;
+	lock.acquire( filename, true );
+	if ( merge_file( filename ) < 0 ) {
+		return ( -1 );
+	}
+	if ( ( _persistedLines + _unsaved ) > ( REPLXX_HISTORY_COMPACTION_RATIO * _maxSize ) ) {
+		return ( rewrite( filename ) );
+	}
+	return ( append( filename ) );
+}
+
+int History::merge( void ) {
+	if ( ! _shared || _persistedFile.empty() ) {
+		return ( 0 );
+	}
+	long long size( 0 );
+	long long stamp( 0 );
+	if ( ! file_stamp( _persistedFile, size, stamp ) || ( ( size == _persistedSize ) && ( stamp == _persistedStamp ) ) ) {
+		return ( 0 );
+	}
+	std::string filename( _persistedFile );
+	FileLock lock;
+	lock.acquire( filename, false );
+	return ( merge_file( filename ) );
+}
+
+/*
+ * Only the part of the file past the point we have seen is examined,
+ * an unterminated last line is left for the next round as its writer
+ * may still be at it. Has to be called with the file lock held.
+ */
+int History::merge_file( std::string const& filename ) {
+	bool known( filename == _persistedFile );
+	long long stampSize( -1 );
+	long long stamp( -1 );
+	file_stamp( filename, stampSize, stamp );
+	FileView file( filename );
+	if ( ! file.valid() ) {
+		_persistedFile = filename;
+		_persistedSize = 0;
+		_persistedStamp = -1;
+		_persistedTail.clear();
+		_persistedLines = 0;
+		return ( 0 );
+	}
+	char const* data( file.data() );
+	long long fileSize( file.size() );
+	long long from( known ? _persistedSize : 0 );
+	long long tail( known ? static_cast<long long>( _persistedTail.length() ) : 0 );
+	/*
+	 * A file that shrunk or no longer ends with what we have seen
+	 * last time was compacted by someone else, it cannot be tail read
+	 * so we only catch up with its end.
+	 */
+	bool rewritten(
+		( fileSize < from )
+		|| ( ( tail > 0 ) && ( memcmp( data + from - tail, _persistedTail.data(), static_cast<size_t>( tail ) ) != 0 ) )
+	);
+	long long start( rewritten ? 0 : from );
+	std::vector<long long> eols;
+	find_line_ends( data + start, fileSize - start, eols );
+	long long end( eols.empty() ? start : start + eols.back() + 1 );
+	int merged( 0 );
+	if ( ! rewritten && ! eols.empty() ) {
+		/* lines entered here and not saved yet stay the most recent ones */
+		std::vector<std::string> own;
+		for ( int i( size() - _unsaved ); i < size(); ++ i ) {
+			own.emplace_back( line( i ), line_length( i ) );
+		}
+		while ( _unsaved > 0 ) {
+			drop_last();
+		}
+		long long lineStart( start );
+		for ( long long eol : eols ) {
+			long long lineEnd( start + eol );
+			void const* cr( memchr( data + lineStart, '\r', static_cast<size_t>( lineEnd - lineStart ) ) );
+			int len( static_cast<int>( ( cr ? static_cast<char const*>( cr ) - data : lineEnd ) - lineStart ) );
+			if ( len > 0 ) {
+				add( data + lineStart, len );
+				++ merged;
+			}
+			lineStart = lineEnd + 1;
+		}
+		_unsaved = 0;
+		for ( std::string const& l : own ) {
+			add( l );
+		}
+		_previousIndex = -2;
+	}
+	if ( rewritten || ! known ) {
+		_persistedLines = static_cast<int>( eols.size() );
+		_persistedTail.clear();
+	} else {
+		_persistedLines += static_cast<int>( eols.size() );
+	}
+	remember_tail( data + start, end - start );
+	_persistedFile = filename;
+	_persistedSize = end;
+	_persistedStamp = ( ( end == fileSize ) && ( stampSize == fileSize ) ) ? stamp : -1;
+	return ( merged );
+}
+
+void History::remember_file( std::string const& filename ) {
+	if ( ! file_stamp( filename, _persistedSize, _persistedStamp ) ) {
+		_persistedSize = -1;
+		_persistedStamp = -1;
+	}
+}
+
+void History::remember_tail( char const* data_, long long size_ ) {
+	if ( size_ <= 0 ) {
+		return;
+	}
+	long long keep( min( size_, static_cast<long long>( REPLXX_HISTORY_TAIL_CHECK_SIZE ) ) );
+	_persistedTail.append( data_ + size_ - keep, static_cast<size_t>( keep ) );
+	if ( _persistedTail.length() > static_cast<size_t>( REPLXX_HISTORY_TAIL_CHECK_SIZE ) ) {
+		_persistedTail.erase( 0, _persistedTail.length() - REPLXX_HISTORY_TAIL_CHECK_SIZE );
+	}
+}
+
+void History::set_unique( bool unique_ ) {
+	absorb_loaded( true );
+	_uniqueIndex.clear();
+	_unique = unique_;
+	if ( ! _unique ) {
+		return;
+	}
+	/* walk from the newest entry so only the most recent occurrence of a line is kept */
+	std::vector<bool> duplicate( static_cast<size_t>( size() ), false );
+	int duplicates( 0 );
+	for ( int i( size() - 1 ); i >= 0; -- i ) {
+		/* a copy, looking for duplicates may decompress other entries */
+		std::string const& text( (*this)[i] );
+		if ( find_duplicate( text.data(), static_cast<int>( text.length() ) ) >= 0 ) {
+			duplicate[static_cast<size_t>( i )] = true;
+			++ duplicates;
+		} else if ( ! text.empty() ) {
+			_uniqueIndex.insert( make_pair( line_hash( text.data(), static_cast<int>( text.length() ) ), _data[i]._serial ) );
+		}
+	}
+	if ( duplicates == 0 ) {
+		return;
+	}
+	lines_t kept( _data.capacity() );
+	int unsaved( 0 );
+	for ( int i( 0 ); i < size(); ++ i ) {
+		if ( duplicate[static_cast<size_t>( i )] ) {
+			unindex_decoded( _data[i] );
+			_arena.release( _data[i]._text );
+		} else {
+			kept.push_back( _data[i] );
+			if ( i >= ( size() - _unsaved ) ) {
+				++ unsaved;
+			}
+		}
+	}
+	_data = std::move( kept );
+	_unsaved = unsaved;
+	drop_search_indexes();
+	_previousIndex = -2;
+	reset_pos();
+}
+
 void History::set_max_size( int size_ ) {
+	absorb_loaded( true );
 	if ( size_ >= 0 ) {
 		_maxSize = size_;
 		int curSize( size() );
 		if ( _maxSize < curSize ) {
-			_data.erase( _data.begin(), _data.begin() + ( curSize - _maxSize ) );
+			for ( int i( 0 ); i < ( curSize - _maxSize ); ++ i ) {
+				unindex_first( _data[i] );
+				_arena.release( _data[i]._text );
+			}
+			_data.erase_front( curSize - _maxSize );
+			compact_search_index();
+			if ( _unsaved > size() ) {
+				_unsaved = size();
+			}
 		}
+		_data.set_capacity( _maxSize + 1 );
 	}
 }
 
 void History::reset_pos( int pos_ ) {
 	if ( pos_ == -1 ) {
+		absorb_loaded();
 		_index = size() - 1;
 		_recallMostRecent = false;
 	} else {
@@ -98,6 +1133,7 @@ void History::reset_pos( int pos_ ) {
 }
 
 bool History::move( bool up_ ) {
+	absorb_loaded();
 	if (_previousIndex != -2 && ! up_ ) {
 		_index = 1 + _previousIndex;	// emulate Windows down-arrow
 	} else {
@@ -116,30 +1152,551 @@ bool History::move( bool up_ ) {
 }
 
 void History::jump( bool start_ ) {
+	absorb_loaded();
 	_index = start_ ? 0 : size() - 1;
 	_previousIndex = -2;
 	_recallMostRecent = true;
 }
 
+/*
+ * Circular search for the entry nearest to the current one that starts
+ * with the first \e prefixSize_ bytes of \e prefix_ but is not \e prefix_ itself.
+ */
 bool History::common_prefix_search( std::string const& prefix_, int prefixSize_, bool back_ ) {
-	int direct( size() + ( back_ ? -1 : 1 ) );
-	int i( ( _index + direct ) % _data.size() );
-	while ( i != _index ) {
-		if ( ( strncmp( prefix_.c_str(), _data[i].c_str(), prefixSize_ ) == 0 )
-			&& ( strcmp( prefix_.c_str(), _data[i].c_str() ) != 0 ) ) {
-			_index = i;
-			_previousIndex = -2;
-			_recallMostRecent = true;
-			return ( true );
+	absorb_loaded();
+	if ( _data.empty() ) {
+		return ( false );
+	}
+	int prefixSize( min( prefixSize_, static_cast<int>( prefix_.length() ) ) );
+	auto matches = [this, &prefix_, prefixSize]( int idx_ ) {
+		return (
+			( line_length( idx_ ) >= prefixSize )
+			&& ( memcmp( line( idx_ ), prefix_.data(), static_cast<size_t>( prefixSize ) ) == 0 )
+			&& ! equals( _data[idx_], prefix_.data(), static_cast<int>( prefix_.length() ) )
+		);
+	};
+	int found( -1 );
+	if ( parallel_search() ) {
+		/* k-th candidate is k + 1 entries away from the current one, circularly */
+		int n( size() );
+		int from( _index );
+		auto candidate = [n, from, back_]( int k_ ) {
+			return ( back_ ? ( from - 1 - k_ + n ) % n : ( from + 1 + k_ ) % n );
+		};
+		int k( _searchPool->nearest( n - 1, [&matches, &candidate]( int k_ ) { return ( matches( candidate( k_ ) ) ); } ) );
+		found = k >= 0 ? candidate( k ) : -1;
+	} else {
+		if ( ! _prefixIndexed ) {
+			_prefixIndex.clear();
+			for ( Entry const& e : _data ) {
+				_prefixIndex.add( e._serial, _arena.get( e._text ), e._text._length );
+			}
+			_prefixIndexed = true;
 		}
-		i += direct;
-		i %= _data.size();
+		serial_t serial( 0 );
+		_prefixIndex.find(
+			prefix_.data(), prefixSize, _data[_index]._serial, back_,
+			[this, &matches, &found]( serial_t serial_ ) {
+				int idx( index_of( serial_ ) );
+				if ( ( idx >= 0 ) && matches( idx ) ) {
+					found = idx;
+					return ( true );
+				}
+				return ( false );
+			},
+			serial
+		);
 	}
-	return ( false );
+	if ( found < 0 ) {
+		return ( false );
+	}
+	_index = found;
+	_previousIndex = -2;
+	_recallMostRecent = true;
+	return ( true );
+}
+
+void History::update_last( std::string const& line_ ) {
+	if ( equals( _data.back(), line_.data(), static_cast<int>( line_.length() ) ) ) {
+		return;
+	}
+	if ( ( _unsaved == 0 ) && ! _shared ) {
+		_persistedFile.clear();
+	}
+	Entry& e( _data.back() );
+	unindex_last( e );
+	_arena.release( e._text );
+	e._text = _arena.store( line_.data(), static_cast<int>( line_.length() ) );
+	index( e );
 }
 
-std::string const& History::operator[] ( int idx_ ) const {
-	return ( _data[ idx_ ] );
+void History::drop_last( void ) {
+	Entry const& e( _data.back() );
+	unindex_last( e );
+	_arena.release( e._text );
+	_data.pop_back();
+	if ( _unsaved > 0 ) {
+		-- _unsaved;
+	}
+}
+
+/*
+ * Remove an entry from the middle of history.  The search indexes
+ * tolerate serials of such entries, they are rebuilt from scratch
+ * only once these outnumber the live ones.
+ */
+void History::erase( int idx_ ) {
+	Entry const& e( _data[idx_] );
+	unindex_unique( e );
+	unindex_decoded( e );
+	_arena.release( e._text );
+	if ( idx_ >= ( size() - _unsaved ) ) {
+		-- _unsaved;
+	}
+	_data.erase( idx_ );
+	if ( _index > idx_ ) {
+		-- _index;
+	}
+	if ( _previousIndex == idx_ ) {
+		_previousIndex = -2;
+	} else if ( _previousIndex > idx_ ) {
+		-- _previousIndex;
+	}
+	if ( _fuzzyIndexed ) {
+		_fuzzyIndex.remove( e._serial );
+	}
+	if ( ( _searchIndexed || _prefixIndexed || _fuzzyIndexed ) && ( ++ _erasedLines > size() ) ) {
+		drop_search_indexes();
+	}
+}
+
+int History::find_duplicate( char const* line_, int length_ ) const {
+	if ( length_ == 0 ) {
+		return ( -1 );
+	}
+	auto range( _uniqueIndex.equal_range( line_hash( line_, length_ ) ) );
+	for ( unique_index_t::const_iterator it( range.first ); it != range.second; ++ it ) {
+		int idx( index_of( it->second ) );
+		if ( ( idx >= 0 ) && equals( _data[idx], line_, length_ ) ) {
+			return ( idx );
+		}
+	}
+	return ( -1 );
+}
+
+void History::drop_search_indexes( void ) {
+	_searchIndex.clear();
+	_searchIndexed = false;
+	_staleLines = 0;
+	_prefixIndex.clear();
+	_prefixIndexed = false;
+	_fuzzyIndex.clear();
+	_fuzzyIndexed = false;
+	_erasedLines = 0;
+}
+
+void History::index( Entry const& entry_ ) {
+	char const* text( _arena.get( entry_._text ) );
+	if ( _unique && ( entry_._text._length > 0 ) ) {
+		_uniqueIndex.insert( make_pair( line_hash( text, entry_._text._length ), entry_._serial ) );
+	}
+	if ( _searchIndexed ) {
+		_searchIndex.add( entry_._serial, text, entry_._text._length );
+	}
+	if ( _prefixIndexed ) {
+		_prefixIndex.add( entry_._serial, text, entry_._text._length );
+	}
+	if ( _fuzzyIndexed ) {
+		_fuzzyIndex.add( entry_._serial, text, entry_._text._length );
+	}
+	if ( _frecent && ( entry_._text._length > 0 ) ) {
+		_frecencyIndex.add( text, entry_._text._length, entry_._timestamp );
+	}
+}
+
+void History::unindex_first( Entry const& entry_ ) {
+	unindex_unique( entry_ );
+	unindex_decoded( entry_ );
+	unindex_frecency( entry_, _unique );
+	if ( _searchIndexed ) {
+		++ _staleLines;
+	}
+	if ( _prefixIndexed ) {
+		_prefixIndex.remove_first( entry_._serial, _arena.get( entry_._text ), entry_._text._length );
+	}
+	if ( _fuzzyIndexed ) {
+		_fuzzyIndex.remove_first( entry_._serial );
+	}
+}
+
+void History::unindex_last( Entry const& entry_ ) {
+	unindex_unique( entry_ );
+	unindex_decoded( entry_ );
+	unindex_frecency( entry_, false );
+	char const* text( _arena.get( entry_._text ) );
+	if ( _searchIndexed ) {
+		_searchIndex.remove_last( entry_._serial, text, entry_._text._length );
+	}
+	if ( _prefixIndexed ) {
+		_prefixIndex.remove_last( entry_._serial, text, entry_._text._length );
+	}
+	if ( _fuzzyIndexed ) {
+		_fuzzyIndex.remove_last( entry_._serial );
+	}
+}
+
+void History::unindex_unique( Entry const& entry_ ) {
+	if ( ! _unique || ( entry_._text._length == 0 ) ) {
+		return;
+	}
+	auto range( _uniqueIndex.equal_range( line_hash( _arena.get( entry_._text ), entry_._text._length ) ) );
+	for ( unique_index_t::iterator it( range.first ); it != range.second; ++ it ) {
+		if ( it->second == entry_._serial ) {
+			_uniqueIndex.erase( it );
+			break;
+		}
+	}
+}
+
+/*
+ * Entries erased as duplicates in unique mode keep their statistics,
+ * the line lives on in a newer entry.  Evicting the only entry
+ * of a line in unique mode forgets all of its uses.
+ */
+void History::unindex_frecency( Entry const& entry_, bool forget_ ) {
+	if ( ! _frecent || ( entry_._text._length == 0 ) ) {
+		return;
+	}
+	char const* text( _arena.get( entry_._text ) );
+	if ( forget_ ) {
+		_frecencyIndex.forget( text, entry_._text._length );
+	} else {
+		_frecencyIndex.remove( text, entry_._text._length );
+	}
+}
+
+namespace {
+
+/*
+ * Widths are charged up front, whether they get measured or not,
+ * so the cache never outgrows its budget behind our back.
+ */
+long long decoded_cost( History::Decoded const& decoded_ ) {
+	long long const perChar( sizeof ( char32_t ) + sizeof ( signed char ) + sizeof ( long long ) );
+	return ( static_cast<long long>( decoded_._text.length() ) * perChar + 64 );
+}
+
+}
+
+/*
+ * Entry is decoded into a fresh node at the front of the LRU list first,
+ * only then it is known whether it fits within the budget at all.
+ */
+History::Decoded const& History::decoded( int idx_ ) const {
+	serial_t serial( _data[idx_]._serial );
+	decoded_index_t::iterator it( _decodedIndex.find( serial ) );
+	if ( it != _decodedIndex.end() ) {
+		_decoded.splice( _decoded.begin(), _decoded, it->second );
+		return ( it->second->second );
+	}
+	Decoded* decoded( &_decodedScratch );
+	if ( _decodedBudget > 0 ) {
+		_decoded.emplace_front();
+		decoded = &_decoded.front().second;
+	}
+	decoded->_text.assign( line( idx_ ) );
+	decoded->_measured = false;
+	if ( _decodedBudget <= 0 ) {
+		return ( *decoded );
+	}
+	long long cost( decoded_cost( *decoded ) );
+	if ( cost > _decodedBudget ) {
+		_decodedScratch._text.swap( decoded->_text );
+		_decodedScratch._measured = false;
+		_decoded.pop_front();
+		return ( _decodedScratch );
+	}
+	while ( ( _decodedSize + cost ) > _decodedBudget ) {
+		_decodedSize -= decoded_cost( _decoded.back().second );
+		_decodedIndex.erase( _decoded.back().first );
+		_decoded.pop_back();
+	}
+	_decoded.front().first = serial;
+	_decodedIndex.insert( make_pair( serial, _decoded.begin() ) );
+	_decodedSize += cost;
+	return ( *decoded );
+}
+
+void History::set_decoded_cache_budget( long long bytes_ ) {
+	_decoded.clear();
+	_decodedIndex.clear();
+	_decodedSize = 0;
+	_decodedBudget = bytes_ > 0 ? bytes_ : 0;
+}
+
+std::string const& History::materialized( int idx_ ) const {
+	serial_t serial( _data[idx_]._serial );
+	std::unordered_map<serial_t, std::string>::iterator it( _materialized.find( serial ) );
+	if ( it == _materialized.end() ) {
+		it = _materialized.insert( make_pair( serial, operator[]( idx_ ) ) ).first;
+	}
+	return ( it->second );
+}
+
+void History::unindex_decoded( Entry const& entry_ ) {
+	_materialized.erase( entry_._serial );
+	decoded_index_t::iterator it( _decodedIndex.find( entry_._serial ) );
+	if ( it != _decodedIndex.end() ) {
+		_decodedSize -= decoded_cost( it->second->second );
+		_decoded.erase( it->second );
+		_decodedIndex.erase( it );
+	}
+}
+
+void History::set_search_threads( int threads_ ) {
+	if ( threads_ < 0 ) {
+		threads_ = static_cast<int>( thread::hardware_concurrency() );
+	}
+	_searchPool.reset( threads_ > 0 ? new SearchPool( threads_ ) : nullptr );
+}
+
+/*
+ * Scanning a big history in parallel is preferred to keeping
+ * the indexes, they are dropped as soon as a scan is due.
+ */
+bool History::parallel_search( void ) {
+	if ( ! _searchPool || _arena.is_compressed() || ( size() < REPLXX_PARALLEL_SEARCH_THRESHOLD ) ) {
+		return ( false );
+	}
+	if ( _searchIndexed || _prefixIndexed ) {
+		drop_search_indexes();
+	}
+	return ( true );
+}
+
+void History::set_compression( bool compress_ ) {
+	_arena.set_compression( compress_ ? REPLXX_HISTORY_HOT_CHUNKS : 0, REPLXX_HISTORY_INFLATED_CHUNKS );
+}
+
+void History::set_frecency( bool frecent_ ) {
+	_frecencyIndex.clear();
+	_frecent = frecent_;
+	if ( ! _frecent ) {
+		return;
+	}
+	for ( Entry const& e : _data ) {
+		if ( e._text._length > 0 ) {
+			_frecencyIndex.add( _arena.get( e._text ), e._text._length, e._timestamp );
+		}
+	}
+}
+
+void History::frecent( char const* prefix_, int length_, int count_, FrecencyIndex::lines_t& lines_ ) const {
+	_frecencyIndex.top( prefix_, length_, count_, static_cast<long long>( time( nullptr ) ), lines_ );
+}
+
+/*
+ * Evicted entries are purged from the search index in bulk
+ * once they outnumber the live ones.
+ */
+void History::compact_search_index( void ) {
+	if ( _searchIndexed && ! _data.empty() && ( _staleLines > size() ) ) {
+		_searchIndex.compact( _data.front()._serial );
+		_staleLines = 0;
+	}
+}
+
+int History::index_of( serial_t serial_ ) const {
+	int lo( serial_lower_bound( serial_, 0, size() ) );
+	return ( ( lo < size() ) && ( _data[lo]._serial == serial_ ) ? lo : -1 );
+}
+
+/*
+ * Index of the first entry in [lo_, hi_) with serial not less than \e serial_.
+ */
+int History::serial_lower_bound( serial_t serial_, int lo_, int hi_ ) const {
+	while ( lo_ < hi_ ) {
+		int mid( lo_ + ( hi_ - lo_ ) / 2 );
+		if ( _data[mid]._serial < serial_ ) {
+			lo_ = mid + 1;
+		} else {
+			hi_ = mid;
+		}
+	}
+	return ( lo_ );
+}
+
+int History::find( char const* text_, int length_, int from_, int direction_ ) {
+	if ( ( from_ < 0 ) || ( from_ >= size() ) ) {
+		return ( -1 );
+	}
+	if ( parallel_search() ) {
+		int count( direction_ > 0 ? size() - from_ : from_ + 1 );
+		int k(
+			_searchPool->nearest(
+				count,
+				[this, text_, length_, from_, direction_]( int k_ ) {
+					return ( contains( _data[from_ + k_ * direction_], text_, length_ ) );
+				}
+			)
+		);
+		return ( k >= 0 ? from_ + k * direction_ : -1 );
+	}
+	if ( length_ < TrigramIndex::GRAM_SIZE ) {
+		for ( int i( from_ ); ( i >= 0 ) && ( i < size() ); i += direction_ ) {
+			if ( contains( _data[i], text_, length_ ) ) {
+				return ( i );
+			}
+		}
+		return ( -1 );
+	}
+	if ( ! _searchIndexed ) {
+		_searchIndex.clear();
+		for ( Entry const& e : _data ) {
+			_searchIndex.add( e._serial, _arena.get( e._text ), e._text._length );
+		}
+		_searchIndexed = true;
+		_staleLines = 0;
+	}
+	int found( -1 );
+	serial_t serial( 0 );
+	_searchIndex.find(
+		text_, length_, _data[from_]._serial, direction_,
+		[this, text_, length_, &found]( serial_t serial_ ) {
+			int idx( index_of( serial_ ) );
+			if ( ( idx >= 0 ) && contains( _data[idx], text_, length_ ) ) {
+				found = idx;
+				return ( true );
+			}
+			return ( false );
+		},
+		serial
+	);
+	return ( found );
+}
+
+void History::fuzzy_search( std::string const& query_, int count_, FuzzyMatcher::matches_t& matches_, int threads_ ) {
+	matches_.clear();
+	if ( count_ <= 0 ) {
+		return;
+	}
+	if ( threads_ <= 0 ) {
+		threads_ = size() >= REPLXX_FUZZY_SEARCH_PARALLEL_THRESHOLD ? static_cast<int>( thread::hardware_concurrency() ) : 1;
+	}
+	threads_ = max( 1, min( threads_, size() / 1024 + 1 ) );
+	/* compressed chunks are decompressed on access, that is not thread safe */
+	if ( _arena.is_compressed() ) {
+		threads_ = 1;
+	}
+	if ( ! _fuzzyIndexed ) {
+		_fuzzyIndex.clear();
+		for ( Entry const& e : _data ) {
+			_fuzzyIndex.add( e._serial, _arena.get( e._text ), e._text._length );
+		}
+		_fuzzyIndexed = true;
+	}
+	FuzzyMatcher matcher( query_ );
+	int maxScore( matcher.max_score() );
+	unsigned int query( FuzzyIndex::query( query_.data(), static_cast<int>( query_.length() ) ) );
+	/*
+	 * Every worker keeps a heap of its best matches, ordered by better() it has
+	 * the worst one on top.  Blocks of serials are scanned newest first (each
+	 * one front to back, memory is read faster that way), older blocks lose
+	 * ties, so once all kept matches have the highest possible score nothing
+	 * left in the range can replace them.  Only candidates picked by the
+	 * fuzzy index are looked at.
+	 */
+	auto score_range = [this, &matcher, query, count_, maxScore]( int from_, int to_, FuzzyMatcher::matches_t& best_ ) {
+		best_.reserve( static_cast<size_t>( count_ ) );
+		if ( from_ >= to_ ) {
+			return;
+		}
+		FuzzyIndex::serials_t candidates;
+		long long first( _data[from_]._serial );
+		int score( 0 );
+		for ( long long blockEnd( static_cast<long long>( _data[to_ - 1]._serial ) + 1 ); blockEnd > first; blockEnd -= REPLXX_FUZZY_SEARCH_BLOCK ) {
+			if ( ( static_cast<int>( best_.size() ) == count_ ) && ( best_.front()._score >= maxScore ) ) {
+				break;
+			}
+			long long blockStart( max( first, blockEnd - REPLXX_FUZZY_SEARCH_BLOCK ) );
+			candidates.clear();
+			_fuzzyIndex.candidates( query, static_cast<serial_t>( blockStart ), static_cast<serial_t>( blockEnd ), candidates );
+			/*
+			 * Entries between two serials are at most as many as serials between them,
+			 * fewer only where entries were erased, so the next candidate is looked for
+			 * at the furthest index it can have first.
+			 */
+			int index( serial_lower_bound( static_cast<serial_t>( blockStart ), from_, to_ ) - 1 );
+			long long serial( blockStart - 1 );
+			for ( serial_t s : candidates ) {
+				int i( static_cast<int>( min( static_cast<long long>( to_ - 1 ), index + ( s - serial ) ) ) );
+				if ( _data[i]._serial != s ) {
+					i = serial_lower_bound( s, index + 1, i );
+				}
+				index = i;
+				serial = s;
+				Entry const& e( _data[i] );
+				if ( ! matcher.match( _arena.get( e._text ), e._text._length, score ) ) {
+					continue;
+				}
+				FuzzyMatcher::Match m{ i, score };
+				if ( static_cast<int>( best_.size() ) < count_ ) {
+					best_.push_back( m );
+					push_heap( best_.begin(), best_.end(), FuzzyMatcher::better );
+				} else if ( FuzzyMatcher::better( m, best_.front() ) ) {
+					pop_heap( best_.begin(), best_.end(), FuzzyMatcher::better );
+					best_.back() = m;
+					push_heap( best_.begin(), best_.end(), FuzzyMatcher::better );
+				}
+			}
+		}
+	};
+	if ( threads_ == 1 ) {
+		score_range( 0, size(), matches_ );
+	} else {
+		std::vector<FuzzyMatcher::matches_t> partial( static_cast<size_t>( threads_ ) );
+		std::vector<thread> workers;
+		int chunk( ( size() + threads_ - 1 ) / threads_ );
+		for ( int t( 0 ); t < threads_; ++ t ) {
+			workers.emplace_back( score_range, t * chunk, min( size(), ( t + 1 ) * chunk ), std::ref( partial[static_cast<size_t>( t )] ) );
+		}
+		for ( thread& w : workers ) {
+			w.join();
+		}
+		for ( FuzzyMatcher::matches_t const& p : partial ) {
+			matches_.insert( matches_.end(), p.begin(), p.end() );
+		}
+	}
+	sort( matches_.begin(), matches_.end(), FuzzyMatcher::better );
+	if ( static_cast<int>( matches_.size() ) > count_ ) {
+		matches_.resize( static_cast<size_t>( count_ ) );
+	}
+}
+
+bool History::equals( Entry const& entry_, char const* str_, int length_ ) const {
+	return (
+		( entry_._text._length == length_ )
+		&& ( memcmp( _arena.get( entry_._text ), str_, static_cast<size_t>( length_ ) ) == 0 )
+	);
+}
+
+bool History::contains( Entry const& entry_, char const* str_, int length_ ) const {
+	if ( length_ == 0 ) {
+		return ( true );
+	}
+	char const* p( _arena.get( entry_._text ) );
+	char const* end( p + entry_._text._length - length_ + 1 );
+	while ( p < end ) {
+		p = static_cast<char const*>( memchr( p, str_[0], static_cast<size_t>( end - p ) ) );
+		if ( ! p ) {
+			break;
+		}
+		if ( memcmp( p, str_, static_cast<size_t>( length_ ) ) == 0 ) {
+			return ( true );
+		}
+		++ p;
+	}
+	return ( false );
 }
 
 }
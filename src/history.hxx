@@ -1,42 +1,293 @@
 #ifndef REPLXX_HISTORY_HXX_INCLUDED
 #define REPLXX_HISTORY_HXX_INCLUDED 1
 
-#include <vector>
+#include <list>
 #include <string>
+#include <cstring>
+#include <memory>
+#include <functional>
+#include <unordered_map>
 
 #include "conversion.hxx"
+#include "unicodestring.hxx"
+#include "ringbuffer.hxx"
+#include "linearena.hxx"
+#include "trigramindex.hxx"
+#include "prefixindex.hxx"
+#include "frecencyindex.hxx"
+#include "fuzzymatch.hxx"
+#include "fuzzyindex.hxx"
+#include "searchpool.hxx"
+#include "columnindex.hxx"
 
 namespace replxx {
 
 class History {
 public:
-	typedef std::vector<std::string> lines_t;
+	typedef TrigramIndex::serial_t serial_t;
+	struct Entry {
+		LineArena::Line _text;
+		serial_t _serial; // increases from the oldest entry to the newest one
+		long long _timestamp; // seconds since epoch the entry was added at, 0 if unknown
+	};
+	typedef RingBuffer<Entry> lines_t;
+	typedef std::unordered_multimap<unsigned long long, serial_t> unique_index_t;
+	struct Decoded {
+		UnicodeString _text;
+		mutable ColumnIndex _widths; // character widths of _text, filled on first use
+		mutable bool _measured;
+		Decoded( void )
+			: _text()
+			, _widths()
+			, _measured( false ) {
+		}
+		/*! \brief Get screen widths of characters of this entry.
+		 *
+		 * Widths are looked up only when first asked for, searches
+		 * that only match the text never pay for them.
+		 */
+		ColumnIndex const& widths( void ) const {
+			if ( ! _measured ) {
+				_widths.assign( _text.get(), _text.length() );
+				_measured = true;
+			}
+			return ( _widths );
+		}
+	};
 private:
+	struct LazyLoad;
+	typedef std::list<std::pair<serial_t, Decoded>> decoded_t;
+	typedef std::unordered_map<serial_t, decoded_t::iterator> decoded_index_t;
+	LineArena _arena;
 	lines_t _data;
+	serial_t _nextSerial;
+	TrigramIndex _searchIndex;
+	bool _searchIndexed;      // _searchIndex is built lazily on first find()
+	int _staleLines;          // evicted entries still present in _searchIndex
+	PrefixIndex _prefixIndex;
+	bool _prefixIndexed;      // _prefixIndex is built lazily on first prefix search
+	FuzzyIndex _fuzzyIndex;
+	bool _fuzzyIndexed;       // _fuzzyIndex is built lazily on first fuzzy search
+	int _erasedLines;         // entries erased from the middle since the indexes were built
+	unique_index_t _uniqueIndex; // line hash -> serial, maintained in unique mode only
+	bool _unique;             // keep only the most recent occurrence of every line
+	FrecencyIndex _frecencyIndex; // usage statistics, maintained in frecency mode only
+	bool _frecent;
 	int _maxSize;
 	int _maxLineLength;
 	int _index;
 	int _previousIndex;
 	bool _recallMostRecent;
+	bool _appendOnly;         // save() only appends lines added since last save
+	bool _shared;             // history file is shared with other processes
+	bool _binary;             // save() writes binary format
+	std::unique_ptr<LazyLoad> _lazyLoad; // older part of history file being scanned in background
+	int _lazyLoadLines;       // load() reads only that many trailing lines synchronously, 0 for all
+	int _unsaved;             // number of trailing entries not yet persisted
+	mutable decoded_t _decoded; // decoded entries, most recently used first
+	mutable decoded_index_t _decodedIndex; // serial -> position in _decoded
+	mutable long long _decodedSize; // bytes held by _decoded
+	long long _decodedBudget; // limit for _decodedSize, 0 disables the cache
+	mutable Decoded _decodedScratch; // decoded entry when not cached
+	mutable std::unordered_map<serial_t, std::string> _materialized; // entries handed out by materialized()
+	std::unique_ptr<SearchPool> _searchPool; // parallel search, if enabled
+	std::string _persistedFile;
+	long long _persistedSize; // file size as left by our last save()/load()/merge()
+	long long _persistedStamp; // file modification time as seen at that point
+	std::string _persistedTail; // last bytes of the file as seen at that point
+	int _persistedLines;      // lines in _persistedFile, drives compaction
 public:
 	History( void );
-	~History() = default;
+	~History( void );
 
   void add( std::string const& line );
+	void add( char const* line, int length );
+	void add( char const* line, int length, long long timestamp );
+	/*! \brief Add entry for the line being edited.
+	 *
+	 * The entry is dropped with drop_last() or replaced with update_last()
+	 * while editing, so it never takes part in unique mode duplicate
+	 * elimination, only lines committed with add() do.
+	 */
+	void add_edit_slot( std::string const& line );
 	int save( std::string const& filename );
+	/*! \brief Get history file contents as they are now, to be produced later.
+	 *
+	 * Only entry records are copied, line contents are shared with
+	 * the history and gathered (and decompressed) by the returned
+	 * function, which may run on another thread.
+	 */
+	std::function<void ( std::string& )> text_snapshot( void );
 	int load( std::string const& filename );
 	void set_max_size( int len );
+	void set_append_only( bool appendOnly_ ) {
+		_appendOnly = appendOnly_;
+	}
+	void set_shared( bool shared_ ) {
+		_shared = shared_;
+	}
+	/*! \brief Save history in binary format.
+	 *
+	 * Binary history files keep timestamps of entries and can be
+	 * loaded without reading the entries that would not fit in history.
+	 * load() recognizes both formats, so loading a file in one format
+	 * and saving it converts it to the other.  A binary file is always
+	 * rewritten as a whole, regardless of append-only and shared modes.
+	 */
+	void set_binary( bool binary_ ) {
+		_binary = binary_;
+	}
+	bool is_binary( void ) const {
+		return ( _binary );
+	}
+	/*! \brief Keep older entries compressed in memory.
+	 *
+	 * Only the most recently stored entries are kept as they are, older
+	 * ones are decompressed in blocks as navigation or search reaches them.
+	 * Searches of compressed history are never run in parallel.
+	 * Binary history files are then written compressed as well.
+	 */
+	void set_compression( bool compress_ );
+	bool is_compressed( void ) const {
+		return ( _arena.is_compressed() );
+	}
+	/*! \brief Load history files starting from their end.
+	 *
+	 * load() reads only the last \e lines_ lines synchronously, older
+	 * entries are scanned on a background thread and put in front of
+	 * the loaded ones by absorb_loaded().  Navigation picks them up on
+	 * its own, saving and reconfiguring history waits for them.
+	 *
+	 * \param lines_ - number of lines to load synchronously, 0 loads whole file.
+	 */
+	void set_lazy_load( int lines_ ) {
+		_lazyLoadLines = lines_;
+	}
+	/*! \brief Take over entries loaded in background, if ready.
+	 *
+	 * Indexes of entries already in history shift by the number of added
+	 * entries, the current position keeps pointing at the same entry.
+	 *
+	 * \param wait_ - block until background loading finishes.
+	 * \return Number of entries added.
+	 */
+	int absorb_loaded( bool wait_ = false );
+	/*! \brief Keep only the most recent occurrence of every line.
+	 *
+	 * Enabling the policy drops older duplicates already in history.
+	 */
+	void set_unique( bool unique_ );
+	/*! \brief Keep usage statistics of distinct lines.
+	 *
+	 * Statistics are needed for frecent() and are updated as lines
+	 * are added and evicted.  Enabling them indexes the current history.
+	 */
+	void set_frecency( bool frecent_ );
+	bool is_frecent( void ) const {
+		return ( _frecent );
+	}
+	/*! \brief Find lines starting with given prefix ranked by frecency.
+	 *
+	 * Frecency combines how often and how recently a line was used,
+	 * see FrecencyIndex::score().  Requires set_frecency( true ).
+	 *
+	 * \param count_ - maximum number of lines to return.
+	 * \param lines_[out] - found lines, best first.
+	 */
+	void frecent( char const* prefix_, int length_, int count_, FrecencyIndex::lines_t& lines_ ) const;
+	/*! \brief Visit entries, oldest first, in place.
+	 *
+	 * Visitor gets entry index, its text (valid only for the duration
+	 * of the call) and length, and returns false to stop the scan.
+	 *
+	 * \param prefix_ - visit only entries starting with it, may be empty.
+	 * \param substring_ - visit only entries containing it, may be empty.
+	 * \return Number of visited entries.
+	 */
+	template<typename visitor_t>
+	int scan( char const* prefix_, int prefixLength_, char const* substring_, int substringLength_, visitor_t const& visitor_ ) const {
+		int visited( 0 );
+		int idx( 0 );
+		for ( Entry const& e : _data ) {
+			int len( e._text._length );
+			char const* text( _arena.get( e._text ) );
+			bool matches(
+				( len >= prefixLength_ )
+				&& ( ( prefixLength_ == 0 ) || ( memcmp( text, prefix_, static_cast<size_t>( prefixLength_ ) ) == 0 ) )
+				&& ( len >= substringLength_ )
+				&& contains( e, substring_, substringLength_ )
+			);
+			if ( matches ) {
+				++ visited;
+				if ( ! visitor_( idx, text, len ) ) {
+					break;
+				}
+			}
+			++ idx;
+		}
+		return ( visited );
+	}
+	/*! \brief Search very large histories with several threads.
+	 *
+	 * find() and common_prefix_search() then scan histories with at least
+	 * 100000 entries in shards on a thread pool, with the same results
+	 * as the sequential search, instead of building search indexes.
+	 *
+	 * \param threads_ - number of threads, 0 disables parallel search, -1 uses all cores.
+	 */
+	void set_search_threads( int threads_ );
+	/*! \brief Pick up lines other processes appended to the shared history file.
+	 *
+	 * Only the part of the file past the point we have seen is read,
+	 * lines entered locally and not saved yet stay the most recent ones.
+	 *
+	 * \return Number of merged lines or -1 on error.
+	 */
+	int merge( void );
 	void reset_pos( int = -1 );
-	std::string const& operator[] ( int ) const;
+	std::string operator[] ( int idx_ ) const {
+		return ( std::string( line( idx_ ), static_cast<size_t>( line_length( idx_ ) ) ) );
+	}
+	/*! \brief Get given entry as a string that stays in place.
+	 *
+	 * The copy is kept until the entry is changed or leaves history,
+	 * references to it stay valid until then.
+	 */
+	std::string const& materialized( int idx_ ) const;
+	char const* line( int idx_ ) const {
+		return ( _arena.get( _data[idx_]._text ) );
+	}
+	int line_length( int idx_ ) const {
+		return ( _data[idx_]._text._length );
+	}
+	long long timestamp( int idx_ ) const {
+		return ( _data[idx_]._timestamp );
+	}
+	/*! \brief Get UTF-32 form and character widths of given entry.
+	 *
+	 * Decoded entries are cached up to the budget set with
+	 * set_decoded_cache_budget(), least recently used ones are dropped
+	 * first.  The reference is valid until the next call.
+	 */
+	Decoded const& decoded( int idx_ ) const;
+	Decoded const& current_decoded( void ) const {
+		return ( decoded( _index ) );
+	}
+	/*! \brief Set memory available for decoded entries cache.
+	 *
+	 * \param bytes_ - cache size limit in bytes, 0 disables the cache.
+	 */
+	void set_decoded_cache_budget( long long bytes_ );
+	long long decoded_cache_size( void ) const {
+		return ( _decodedSize );
+	}
 	void set_recall_most_recent( void ) {
 		_recallMostRecent = true;
 	}
 	void reset_recall_most_recent( void ) {
 		_recallMostRecent = false;
 	}
-	void drop_last( void ) {
-		_data.pop_back();
-	}
+	void drop_last( void );
 	void commit_index( void ) {
 		_previousIndex = _recallMostRecent ? _index : -2;
 	}
@@ -49,22 +300,69 @@ public:
 	bool is_empty( void ) const {
 		return ( _data.empty() );
 	}
-	void update_last( std::string const& line_ ) {
-		_data.back() = line_;
-	}
+	void update_last( std::string const& );
 	bool move( bool );
-	std::string const& current( void ) const {
-		return ( _data[_index] );
+	char const* current( void ) const {
+		return ( line( _index ) );
 	}
 	void jump( bool );
 	bool common_prefix_search( std::string const&, int, bool );
+	/*! \brief Find nearest entry containing given UTF-8 encoded text.
+	 *
+	 * Entries are examined starting at \e from_ in given direction.
+	 *
+	 * \return Index of found entry or -1 if there is none.
+	 */
+	int find( char const* text_, int length_, int from_, int direction_ );
+	/*! \brief Rank all non-empty entries against fuzzy query.
+	 *
+	 * Only entries passing the character presence check of the fuzzy
+	 * index are scored, the index is built on first call.
+	 *
+	 * \param query_ - UTF-8 encoded query.
+	 * \param count_ - maximum number of best matches to return.
+	 * \param matches_[out] - best matches, best first.
+	 * \param threads_ - number of scoring threads, 0 picks one based on history size.
+	 */
+	void fuzzy_search( std::string const& query_, int count_, FuzzyMatcher::matches_t& matches_, int threads_ = 0 );
 	int size( void ) const {
 		return ( static_cast<int>( _data.size() ) );
 	}
 	int max_line_length( void ) {
 		return ( _maxLineLength );
 	}
+	/*! \brief Number of bytes used to hold history entries.
+	 */
+	long long memory_usage( void ) const {
+		return ( _arena.allocated() + static_cast<long long>( _data.size() ) * static_cast<long long>( sizeof ( Entry ) ) );
+	}
 private:
+	bool equals( Entry const&, char const*, int ) const;
+	bool contains( Entry const&, char const*, int ) const;
+	int index_of( serial_t ) const;
+	int serial_lower_bound( serial_t, int, int ) const;
+	int find_duplicate( char const*, int ) const;
+	void push( char const*, int, long long, bool );
+	void erase( int );
+	void index( Entry const& );
+	void unindex_first( Entry const& );
+	void unindex_last( Entry const& );
+	void unindex_unique( Entry const& );
+	void unindex_frecency( Entry const&, bool );
+	void unindex_decoded( Entry const& );
+	bool parallel_search( void );
+	void drop_search_indexes( void );
+	void compact_search_index( void );
+	int rewrite( std::string const& filename );
+	int rewrite_binary( std::string const& filename );
+	int load_binary( char const*, long long );
+	template<typename line_t>
+	void replay( int, line_t const& );
+	int append( std::string const& filename );
+	int sync( std::string const& filename );
+	int merge_file( std::string const& filename );
+	void remember_file( std::string const& filename );
+	void remember_tail( char const*, long long );
 	History( History const& ) = delete;
 	History& operator = ( History const& ) = delete;
 };
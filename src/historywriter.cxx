@@ -0,0 +1,199 @@
+#include <cstdio>
+#include <vector>
+#include <chrono>
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#else
+
+#include <io.h>
+
+#endif /* _WIN32 */
+
+#include "historywriter.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+int sync_file( FILE* file_ ) {
+#ifndef _WIN32
+	return ( fsync( fileno( file_ ) ) );
+#else
+	return ( _commit( _fileno( file_ ) ) );
+#endif
+}
+
+}
+
+HistoryWriter::HistoryWriter( std::string const& filename_, int syncInterval_ )
+	: _filename( filename_ )
+	, _syncInterval( syncInterval_ )
+	, _head()
+	, _tail( new Request{ Request::TYPE::SYNC, std::string(), contents_t(), nullptr, {} } )
+	, _mutex()
+	, _wakeUp()
+	, _idle( false )
+	, _failed( false )
+	, _thread() {
+	_tail->_next.store( nullptr );
+	_head.store( _tail );
+	_thread = thread( &HistoryWriter::run, this );
+}
+
+HistoryWriter::~HistoryWriter( void ) {
+	push( Request::TYPE::STOP, std::string() );
+	_thread.join();
+	delete _tail;
+}
+
+void HistoryWriter::append( char const* line_, int length_ ) {
+	std::string data;
+	data.reserve( static_cast<size_t>( length_ ) + 1 );
+	data.append( line_, static_cast<size_t>( length_ ) ).append( 1, '\n' );
+	push( Request::TYPE::APPEND, std::move( data ) );
+}
+
+void HistoryWriter::rewrite( contents_t&& contents_ ) {
+	push( Request::TYPE::REWRITE, std::string(), std::move( contents_ ) );
+}
+
+int HistoryWriter::sync( void ) {
+	std::promise<int> done;
+	std::future<int> status( done.get_future() );
+	push( Request::TYPE::SYNC, std::string(), contents_t(), &done );
+	return ( status.get() );
+}
+
+/*
+ * Multiple producer single consumer queue, producers only ever touch
+ * _head, the writer thread only ever touches _tail.  The mutex is taken
+ * only to wake the writer up if it went to sleep on an empty queue.
+ */
+void HistoryWriter::push( Request::TYPE type_, std::string&& data_, contents_t&& contents_, std::promise<int>* done_ ) {
+	Request* request( new Request{ type_, std::move( data_ ), std::move( contents_ ), done_, {} } );
+	request->_next.store( nullptr, memory_order_relaxed );
+	Request* prev( _head.exchange( request ) );
+	prev->_next.store( request );
+	if ( _idle.load() ) {
+		lock_guard<mutex> lock( _mutex );
+	}
+	_wakeUp.notify_one();
+}
+
+bool HistoryWriter::pop( Request::TYPE& type_, std::string& data_, contents_t& contents_, std::promise<int>*& done_ ) {
+	Request* next( _tail->_next.load() );
+	if ( ! next ) {
+		return ( false );
+	}
+	type_ = next->_type;
+	data_ = std::move( next->_data );
+	contents_ = std::move( next->_contents );
+	done_ = next->_done;
+	delete _tail;
+	_tail = next;
+	return ( true );
+}
+
+void HistoryWriter::run( void ) {
+	typedef chrono::steady_clock clock_t;
+	FILE* file( nullptr );
+	bool dirty( false ); // written but not synced yet
+	clock_t::time_point lastSync( clock_t::now() );
+	std::string batch;
+	std::string data;
+	contents_t contents;
+	std::vector<std::promise<int>*> done;
+	bool stop( false );
+	while ( true ) {
+		batch.clear();
+		done.clear();
+		bool truncate( false );
+		Request::TYPE type( Request::TYPE::SYNC );
+		std::promise<int>* waiter( nullptr );
+		while ( pop( type, data, contents, waiter ) ) {
+			switch ( type ) {
+				case Request::TYPE::APPEND:
+					batch.append( data );
+					break;
+				case Request::TYPE::REWRITE: // new contents supersede anything appended before
+					batch.clear();
+					contents( batch );
+					contents = nullptr;
+					truncate = true;
+					break;
+				case Request::TYPE::SYNC:
+					done.push_back( waiter );
+					break;
+				case Request::TYPE::STOP:
+					stop = true;
+					break;
+			}
+		}
+		if ( truncate || ! batch.empty() ) {
+			if ( truncate || ! file ) {
+				if ( file ) {
+					fclose( file );
+				}
+#ifndef _WIN32
+				mode_t oldUmask( umask( S_IXUSR | S_IRWXG | S_IRWXO ) );
+#endif
+				file = fopen( _filename.c_str(), truncate ? "wb" : "ab" );
+#ifndef _WIN32
+				umask( oldUmask );
+#endif
+			}
+			if (
+				! file
+				|| ( fwrite( batch.data(), 1, batch.length(), file ) != batch.length() )
+				|| ( fflush( file ) != 0 )
+			) {
+				_failed = true;
+			}
+			dirty = true;
+		}
+		clock_t::time_point now( clock_t::now() );
+		int sinceSync( static_cast<int>( chrono::duration_cast<chrono::milliseconds>( now - lastSync ).count() ) );
+		if (
+			dirty
+			&& ( stop || ! done.empty() || ( ( _syncInterval >= 0 ) && ( sinceSync >= _syncInterval ) ) )
+		) {
+			if ( file && ( sync_file( file ) != 0 ) ) {
+				_failed = true;
+			}
+			dirty = false;
+			lastSync = now;
+		}
+		if ( ! done.empty() ) {
+			int status( _failed ? -1 : 0 );
+			_failed = false;
+			for ( std::promise<int>* p : done ) {
+				p->set_value( status );
+			}
+		}
+		if ( stop ) {
+			break;
+		}
+		unique_lock<mutex> lock( _mutex );
+		_idle.store( true );
+		if ( ! _tail->_next.load() ) {
+			if ( dirty && ( _syncInterval > 0 ) ) {
+				_wakeUp.wait_for( lock, chrono::milliseconds( _syncInterval - sinceSync ) );
+			} else {
+				_wakeUp.wait( lock );
+			}
+		}
+		_idle.store( false );
+	}
+	if ( file ) {
+		fclose( file );
+	}
+}
+
+}
+
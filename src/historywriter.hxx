@@ -0,0 +1,87 @@
+#ifndef REPLXX_HISTORYWRITER_HXX_INCLUDED
+#define REPLXX_HISTORYWRITER_HXX_INCLUDED 1
+
+#include <string>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+namespace replxx {
+
+/*
+ * Persists history from a background thread.
+ *
+ * Requests are handed over through a lock-free queue, the writer drains
+ * whatever has accumulated and writes it out with a single write.
+ * Written data is fsync()ed at most every _syncInterval milliseconds,
+ * on sync() and before the writer goes away.
+ */
+class HistoryWriter {
+public:
+	typedef std::function<void ( std::string& )> contents_t;
+private:
+	struct Request {
+		enum class TYPE {
+			APPEND,
+			REWRITE,
+			SYNC,
+			STOP
+		};
+		TYPE _type;
+		std::string _data;
+		contents_t _contents;
+		std::promise<int>* _done;
+		std::atomic<Request*> _next;
+	};
+	std::string _filename;
+	int _syncInterval;
+	std::atomic<Request*> _head; // most recently pushed request
+	Request* _tail;              // consumed stub, owned by the writer thread
+	std::mutex _mutex;
+	std::condition_variable _wakeUp;
+	std::atomic<bool> _idle;
+	bool _failed;
+	std::thread _thread;
+public:
+	/*! \brief Start writer thread.
+	 *
+	 * \param filename - history file to write to.
+	 * \param syncInterval - fsync() the file at most that often (in milliseconds),
+	 * 0 syncs after every write, negative value only on sync() and in destructor.
+	 */
+	HistoryWriter( std::string const& filename, int syncInterval );
+	/*! \brief Write and sync everything queued and stop the writer thread.
+	 */
+	~HistoryWriter( void );
+	/*! \brief Queue a line to be appended to the file.
+	 */
+	void append( char const* line, int length );
+	/*! \brief Queue replacement of the whole file contents.
+	 *
+	 * \param contents - appends new file contents to given string,
+	 * called on the writer thread.
+	 */
+	void rewrite( contents_t&& contents );
+	/*! \brief Wait until everything queued so far is written and synced.
+	 *
+	 * \return 0 on success, -1 if writing failed since previous sync().
+	 */
+	int sync( void );
+	std::string const& filename( void ) const {
+		return ( _filename );
+	}
+private:
+	void push( Request::TYPE, std::string&&, contents_t&& = contents_t(), std::promise<int>* = nullptr );
+	bool pop( Request::TYPE&, std::string&, contents_t&, std::promise<int>*& );
+	void run( void );
+	HistoryWriter( HistoryWriter const& ) = delete;
+	HistoryWriter& operator = ( HistoryWriter const& ) = delete;
+};
+
+}
+
+#endif
+
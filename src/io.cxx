@@ -1,5 +1,5 @@
-#include <memory>
 #include <cerrno>
+#include <cstring>
 #include <cstdlib>
 
 #ifdef _WIN32
@@ -18,6 +18,7 @@
 #else /* _WIN32 */
 
 #include <unistd.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 
 #endif /* _WIN32 */
@@ -75,6 +76,16 @@ Terminal::Terminal( void )
 #endif
 	, _rawMode( false )
 	, _keyPresses()
+	, _generation( 0 )
+	, _output()
+#ifndef _WIN32
+	, _input()
+	, _inputPos( 0 )
+	, _pending()
+	, _pendingCount( 0 )
+	, _frame()
+	, _frameDepth( 0 )
+#endif
 {}
 
 Terminal::~Terminal( void ) {
@@ -84,29 +95,63 @@ Terminal::~Terminal( void ) {
 }
 
 void Terminal::write32( char32_t const* text32, int len32 ) {
-	int len8 = 4 * len32 + 1;
-	unique_ptr<char[]> text8(new char[len8]);
-	int count8 = 0;
+#ifndef _WIN32
+	if ( _frameDepth > 0 ) {
+		++ _generation;
+		appendString32to8( _frame, text32, len32 );
+		return;
+	}
+#endif
+	_output.clear();
+	appendString32to8( _output, text32, len32 );
+	write8( _output.data(), static_cast<int>( _output.length() ) );
+}
 
-	copyString32to8(text8.get(), len8, text32, len32, &count8);
-	int nWritten( 0 );
-#ifdef _WIN32
-	nWritten = win_write( text8.get(), count8 );
+void Terminal::write8( void const* data_, int size_ ) {
+	++ _generation;
+#ifndef _WIN32
+	if ( _frameDepth > 0 ) {
+		_frame.append( static_cast<char const*>( data_ ), static_cast<size_t>( size_ ) );
+		return;
+	}
+	int nWritten( write( 1, data_, size_ ) );
 #else
-	nWritten = write( 1, text8.get(), count8 );
+	int nWritten( win_write( static_cast<char const*>( data_ ), size_ ) );
 #endif
-	if ( nWritten != count8 ) {
+	if ( nWritten != size_ ) {
 		throw std::runtime_error( "write failed" );
 	}
 	return;
 }
 
-void Terminal::write8( void const* data_, int size_ ) {
-	if ( write( 1, data_, size_ ) != size_ ) {
+void Terminal::begin_frame( void ) {
+#ifndef _WIN32
+	++ _frameDepth;
+#endif
+}
+
+void Terminal::end_frame( void ) {
+#ifndef _WIN32
+	if ( ( _frameDepth > 0 ) && ( -- _frameDepth == 0 ) ) {
+		flush_frame();
+	}
+#endif
+}
+
+#ifndef _WIN32
+void Terminal::flush_frame( void ) {
+	if ( _frame.empty() ) {
+		return;
+	}
+	int size( static_cast<int>( _frame.size() ) );
+	int nWritten( static_cast<int>( write( 1, _frame.data(), _frame.size() ) ) );
+	/* keep the capacity for the next frame */
+	_frame.clear();
+	if ( nWritten != size ) {
 		throw std::runtime_error( "write failed" );
 	}
-	return;
 }
+#endif
 
 int Terminal::get_screen_columns( void ) {
 	int cols( 0 );
@@ -187,6 +232,11 @@ int Terminal::enable_raw_mode( void ) {
 		if ( tcsetattr(0, TCSADRAIN, &raw) < 0 ) {
 			return ( notty() );
 		}
+		/* have pastes bracketed with ESC [ 200 ~ and ESC [ 201 ~ */
+		if ( tty::out ) {
+			char const bracketedPasteOn[] = "\033[?2004h";
+			static_cast<void>( write( 1, bracketedPasteOn, sizeof ( bracketedPasteOn ) - 1 ) >= 0 );
+		}
 #endif
 		_rawMode = true;
 	}
@@ -202,6 +252,10 @@ void Terminal::disable_raw_mode(void) {
 		_consoleIn = 0;
 		_consoleOut = 0;
 #else
+		if ( tty::out ) {
+			char const bracketedPasteOff[] = "\033[?2004l";
+			static_cast<void>( write( 1, bracketedPasteOff, sizeof ( bracketedPasteOff ) - 1 ) >= 0 );
+		}
 		if ( tcsetattr( 0, TCSADRAIN, &_origTermios ) == -1 ) {
 			return;
 		}
@@ -212,43 +266,163 @@ void Terminal::disable_raw_mode(void) {
 
 #ifndef _WIN32
 
-/**
- * Read a UTF-8 sequence from the non-Windows keyboard and return the Unicode
- * (char32_t) character it
- * encodes
+namespace {
+
+/*
+ * Bytes asked for with every read() from the keyboard, a paste arrives
+ * in as few chunks as the terminal delivers it in.
+ */
+int const REPLXX_INPUT_CHUNK_SIZE( 4096 );
+
+/*
+ * Length of UTF-8 sequence starting with given byte, 0 for bytes
+ * that can not start one.
+ */
+inline int utf8_length( char8_t lead_ ) {
+	if ( lead_ < 0x80 ) {
+		return ( 1 );
+	} else if ( lead_ < 0xC2 ) {
+		return ( 0 );
+	} else if ( lead_ < 0xE0 ) {
+		return ( 2 );
+	} else if ( lead_ < 0xF0 ) {
+		return ( 3 );
+	} else if ( lead_ < 0xF5 ) {
+		return ( 4 );
+	}
+	return ( 0 );
+}
+
+/*
+ * Validity of the second byte depends on the lead byte,
+ * this rules out overlong forms, surrogates and code points past U+10FFFF.
+ */
+inline bool utf8_second_valid( char8_t lead_, char8_t second_ ) {
+	switch ( lead_ ) {
+		case ( 0xE0 ): return ( ( second_ >= 0xA0 ) && ( second_ <= 0xBF ) );
+		case ( 0xED ): return ( ( second_ >= 0x80 ) && ( second_ <= 0x9F ) );
+		case ( 0xF0 ): return ( ( second_ >= 0x90 ) && ( second_ <= 0xBF ) );
+		case ( 0xF4 ): return ( ( second_ >= 0x80 ) && ( second_ <= 0x8F ) );
+	}
+	return ( ( second_ & 0xC0 ) == 0x80 );
+}
+
+/*
+ * Decode all complete UTF-8 sequences of given buffer, bytes that are not
+ * part of a valid sequence are dropped.
  *
- * @return	char32_t Unicode character
+ * \return Number of bytes consumed, an incomplete sequence at the end is left alone.
  */
-char32_t read_unicode_character(void) {
-	static char8_t utf8String[5];
-	static size_t utf8Count = 0;
-	while (true) {
-		char8_t c;
-
-		/* Continue reading if interrupted by signal. */
-		ssize_t nread;
-		do {
-			nread = read(0, &c, 1);
-		} while ((nread == -1) && (errno == EINTR));
-
-		if (nread <= 0) return 0;
-		if (c <= 0x7F || locale::is8BitEncoding) {	// short circuit ASCII
-			utf8Count = 0;
-			return c;
-		} else if (utf8Count < sizeof(utf8String) - 1) {
-			utf8String[utf8Count++] = c;
-			utf8String[utf8Count] = 0;
-			char32_t unicodeChar[2];
-			int ucharCount( 0 );
-			ConversionResult res = copyString8to32(unicodeChar, 2, ucharCount, utf8String);
-			if (res == conversionOK && ucharCount) {
-				utf8Count = 0;
-				return unicodeChar[0];
+int decode_utf8( char8_t const* data_, int size_, Terminal::input_t& out_ ) {
+	int pos( 0 );
+	while ( pos < size_ ) {
+		char8_t lead( data_[pos] );
+		if ( lead < 0x80 ) {
+			out_.push_back( lead );
+			++ pos;
+			continue;
+		}
+		int len( utf8_length( lead ) );
+		if ( len == 0 ) {
+			++ pos;
+			continue;
+		}
+		int valid( 1 );
+		while ( ( valid < len ) && ( ( pos + valid ) < size_ ) ) {
+			char8_t b( data_[pos + valid] );
+			if ( ( valid == 1 ) ? ! utf8_second_valid( lead, b ) : ( ( b & 0xC0 ) != 0x80 ) ) {
+				break;
+			}
+			++ valid;
+		}
+		if ( valid == len ) {
+			char32_t c( lead & ( 0x7F >> len ) );
+			for ( int i( 1 ); i < len; ++ i ) {
+				c = ( c << 6 ) | ( data_[pos + i] & 0x3F );
 			}
+			out_.push_back( c );
+			pos += len;
+		} else if ( ( pos + valid ) == size_ ) {
+			break;
 		} else {
-			utf8Count = 0;	// this shouldn't happen: got four bytes but no UTF-8 character
+			pos += valid;
 		}
 	}
+	return ( pos );
+}
+
+}
+
+/*
+ * Read whatever is available (blocking for at least one byte)
+ * and decode it, together with the incomplete sequence left over
+ * from the previous read.
+ */
+bool Terminal::read_input( void ) {
+	char8_t buffer[sizeof ( _pending ) + REPLXX_INPUT_CHUNK_SIZE];
+	memcpy( buffer, _pending, static_cast<size_t>( _pendingCount ) );
+	ssize_t nread( 0 );
+	/* Continue reading if interrupted by signal. */
+	do {
+		nread = read( 0, buffer + _pendingCount, REPLXX_INPUT_CHUNK_SIZE );
+	} while ( ( nread == -1 ) && ( errno == EINTR ) );
+	if ( nread <= 0 ) {
+		return ( false );
+	}
+	int size( _pendingCount + static_cast<int>( nread ) );
+	_input.clear();
+	_inputPos = 0;
+	if ( locale::is8BitEncoding ) {
+		_input.assign( buffer, buffer + size );
+		_pendingCount = 0;
+		return ( true );
+	}
+	int consumed( decode_utf8( buffer, size, _input ) );
+	_pendingCount = size - consumed;
+	memcpy( _pending, buffer + consumed, static_cast<size_t>( _pendingCount ) );
+	return ( true );
+}
+
+bool Terminal::read_paste( input_t& text_ ) {
+	static char32_t const endMarker[] = { 27, '[', '2', '0', '1', '~' };
+	int const endMarkerSize( static_cast<int>( sizeof ( endMarker ) / sizeof ( endMarker[0] ) ) );
+	int matched( 0 );
+	while ( true ) {
+		/* take runs without ESC straight from the buffer */
+		if ( matched == 0 ) {
+			int end( _inputPos );
+			int size( static_cast<int>( _input.size() ) );
+			while ( ( end < size ) && ( _input[static_cast<size_t>( end )] != endMarker[0] ) ) {
+				++ end;
+			}
+			text_.insert( text_.end(), _input.begin() + _inputPos, _input.begin() + end );
+			_inputPos = end;
+		}
+		char32_t c( read_unicode_character() );
+		if ( c == 0 ) {
+			return ( false );
+		}
+		if ( c == endMarker[matched] ) {
+			if ( ++ matched == endMarkerSize ) {
+				return ( true );
+			}
+			continue;
+		}
+		text_.insert( text_.end(), endMarker, endMarker + matched );
+		matched = ( c == endMarker[0] ) ? 1 : 0;
+		if ( matched == 0 ) {
+			text_.push_back( c );
+		}
+	}
+}
+
+char32_t Terminal::read_unicode_character( void ) {
+	while ( _inputPos == static_cast<int>( _input.size() ) ) {
+		if ( ! read_input() ) {
+			return ( 0 );
+		}
+	}
+	return ( _input[static_cast<size_t>( _inputPos ++ )] );
 }
 
 #endif	// #ifndef _WIN32
@@ -262,6 +436,25 @@ void Terminal::emulate_key_press( char32_t keyCode_ ) {
 	_keyPresses.push_back( keyCode_ );
 }
 
+bool Terminal::has_input( void ) {
+	if ( ! _keyPresses.empty() ) {
+		return ( true );
+	}
+#ifdef _WIN32
+	DWORD count( 0 );
+	return ( GetNumberOfConsoleInputEvents( _consoleIn, &count ) && ( count > 0 ) );
+#else
+	if ( _inputPos < static_cast<int>( _input.size() ) ) {
+		return ( true );
+	}
+	pollfd pfd;
+	pfd.fd = 0;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return ( poll( &pfd, 1, 0 ) > 0 );
+#endif
+}
+
 // replxx_read_char -- read a keystroke or keychord from the keyboard, and
 // translate it
 // into an encoded "keystroke".	When convenient, extended keys are translated
@@ -272,6 +465,10 @@ void Terminal::emulate_key_press( char32_t keyCode_ ) {
 // means "invalid key".
 //
 char32_t Terminal::read_char( void ) {
+#ifndef _WIN32
+	/* do not leave a half drawn screen while waiting for a key */
+	flush_frame();
+#endif
 	if ( !_keyPresses.empty() ) {
 		char32_t keyPress( _keyPresses.front() );
 		_keyPresses.pop_front();
@@ -456,7 +653,11 @@ char32_t Terminal::read_char( void ) {
 	}
 #endif	// __REPLXX_DEBUG__
 
-	c = EscapeSequenceProcessing::doDispatch(c);
+	c = EscapeSequenceProcessing::doDispatch( *this, c );
+	/* end marker of a paste we did not see start of is not a key */
+	if ( c == PASTE_END_KEY ) {
+		return ( read_char() );
+	}
 #endif	// #_WIN32
 	return ( cleanupCtrl( c ) );
 }
@@ -465,6 +666,7 @@ char32_t Terminal::read_char( void ) {
  * Clear the screen ONLY (no redisplay of anything)
  */
 void Terminal::clear_screen( CLEAR_SCREEN clearScreen_ ) {
+	++ _generation;
 #ifdef _WIN32
 	COORD coord = {0, 0};
 	CONSOLE_SCREEN_BUFFER_INFO inf;
@@ -481,12 +683,12 @@ void Terminal::clear_screen( CLEAR_SCREEN clearScreen_ ) {
 		&count
 	);
 #else
-	if ( clearScreen_ == CLEAR_SCREEN::WHOLE ) {
-		char const clearCode[] = "\033c\033[H\033[2J\033[0m";
-		static_cast<void>( write(1, clearCode, sizeof ( clearCode ) - 1) >= 0 );
+	char const* clearCode( clearScreen_ == CLEAR_SCREEN::WHOLE ? "\033c\033[H\033[2J\033[0m" : "\033[J" );
+	size_t clearCodeSize( strlen( clearCode ) );
+	if ( _frameDepth > 0 ) {
+		_frame.append( clearCode, clearCodeSize );
 	} else {
-		char const clearCode[] = "\033[J";
-		static_cast<void>( write(1, clearCode, sizeof ( clearCode ) - 1) >= 0 );
+		static_cast<void>( write( 1, clearCode, clearCodeSize ) >= 0 );
 	}
 #endif
 }
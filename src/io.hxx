@@ -2,6 +2,8 @@
 #define REPLXX_IO_HXX_INCLUDED 1
 
 #include <deque>
+#include <vector>
+#include <string>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -14,6 +16,7 @@ namespace replxx {
 class Terminal {
 public:
 	typedef std::deque<char32_t> key_presses_t;
+	typedef std::vector<char32_t> input_t;
 private:
 #ifdef _WIN32
 	HANDLE _consoleOut;
@@ -27,6 +30,16 @@ private:
 #endif
 	bool _rawMode; /* for destructor to check if restore is needed */
 	key_presses_t _keyPresses;
+	unsigned long long _generation; /* counts output calls */
+	std::string _output;  /* write32() conversion buffer, reused */
+#ifndef _WIN32
+	input_t _input;       /* decoded characters of the last read(), not consumed yet */
+	int _inputPos;
+	char _pending[4];     /* incomplete UTF-8 sequence at the end of the last read() */
+	int _pendingCount;
+	std::string _frame;   /* output collected since begin_frame(), not written yet */
+	int _frameDepth;
+#endif
 public:
 	enum class CLEAR_SCREEN {
 		WHOLE,
@@ -37,18 +50,59 @@ public:
 	~Terminal( void );
 	void write32( char32_t const*, int );
 	void write8( void const*, int );
+	/*! \brief Collect output in memory until the matching end_frame().
+	 *
+	 * A redraw written with a single write() reaches a remote terminal
+	 * in one packet and is never seen half done.  Frames nest, collected
+	 * output is also written before waiting for a keystroke.
+	 * Output is not collected on Windows, where the console is driven
+	 * by API calls as much as by text.
+	 */
+	void begin_frame( void );
+	void end_frame( void );
+	/*! \brief Tell if anything was written since a past point.
+	 *
+	 * \return Value that changes with every output call.
+	 */
+	unsigned long long generation( void ) const {
+		return ( _generation );
+	}
 	int get_screen_columns(void);
 	int get_screen_rows(void);
 	int enable_raw_mode(void);
 	void disable_raw_mode(void);
 	char32_t read_char(void);
+	/*! \brief Check if a keystroke can be read without waiting.
+	 */
+	bool has_input( void );
 	void clear_screen( CLEAR_SCREEN );
 	void emulate_key_press( char32_t );
 #ifdef _WIN32
 	void jump_cursor( int, int );
 	void clear_section( int );
+#else
+	/*! \brief Read a single Unicode character from the keyboard.
+	 *
+	 * Input is read in chunks of whatever is available and decoded
+	 * all at once, characters are then served from the buffer.
+	 *
+	 * \return The character or 0 on end of input or error.
+	 */
+	char32_t read_unicode_character( void );
+	/*! \brief Read bracketed paste contents.
+	 *
+	 * Reads characters following the paste start marker up to the end marker.
+	 *
+	 * \param text_[out] - pasted text is appended here.
+	 * \return False if input ended before the end marker.
+	 */
+	bool read_paste( input_t& text_ );
 #endif
 private:
+#ifndef _WIN32
+	bool read_input( void );
+	void flush_frame( void );
+#endif
 	Terminal( Terminal const& ) = delete;
 	Terminal& operator = ( Terminal const& ) = delete;
 	Terminal( Terminal&& ) = delete;
@@ -56,7 +110,6 @@ private:
 };
 
 void beep();
-char32_t read_unicode_character(void);
 
 namespace tty {
 
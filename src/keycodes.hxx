@@ -49,6 +49,8 @@ static const int END_KEY = 0x10C00000;
 static const int DELETE_KEY = 0x10E00000;
 static const int PAGE_UP_KEY = 0x11000000;
 static const int PAGE_DOWN_KEY = 0x11200000;
+static const int PASTE_START_KEY = 0x11400000;	// bracketed paste follows
+static const int PASTE_END_KEY = 0x11600000;	// stray end of bracketed paste, ignored
 
 #endif
 
@@ -0,0 +1,210 @@
+#include <cstring>
+#include <algorithm>
+
+#include "linearena.hxx"
+#include "compression.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+LineArena::LineArena( int chunkSize_ )
+	: _chunks()
+	, _firstChunk( 0 )
+	, _chunkSize( chunkSize_ )
+	, _hotChunks( 0 )
+	, _inflatedLimit( 1 )
+	, _inflated()
+	, _allocated( 0 ) {
+}
+
+LineArena::Line LineArena::store( char const* data_, int length_ ) {
+	int required( length_ + 1 );
+	bool opened( false );
+	if (
+		_chunks.empty()
+		|| ! _chunks.back()._data
+		|| _chunks.back()._frozen
+		|| ( ( _chunks.back()._capacity - _chunks.back()._used ) < required )
+	) {
+		Chunk chunk;
+		chunk._capacity = max( _chunkSize, required );
+		chunk._data.reset( new char[chunk._capacity] );
+		chunk._used = 0;
+		chunk._live = 0;
+		chunk._packedSize = 0;
+		chunk._frozen = false;
+		_allocated += chunk._capacity;
+		_chunks.push_back( std::move( chunk ) );
+		opened = true;
+	}
+	Chunk& chunk( _chunks.back() );
+	Line line;
+	line._chunk = _firstChunk + static_cast<int>( _chunks.size() ) - 1;
+	line._offset = chunk._used;
+	line._length = length_;
+	memcpy( chunk._data.get() + chunk._used, data_, length_ );
+	chunk._data[chunk._used + length_] = 0;
+	chunk._used += required;
+	++ chunk._live;
+	/* the chunk falling out of the hot window is compressed only after the copy, data_ may point into it */
+	int cold( static_cast<int>( _chunks.size() ) - 1 - _hotChunks );
+	if ( opened && ( _hotChunks > 0 ) && ( cold >= 0 ) ) {
+		pack( _chunks[cold] );
+	}
+	return ( line );
+}
+
+void LineArena::release( Line const& line_ ) {
+	int idx( line_._chunk - _firstChunk );
+	Chunk& chunk( _chunks[idx] );
+	bool last( idx == static_cast<int>( _chunks.size() ) - 1 );
+	if ( last && ( ( line_._offset + line_._length + 1 ) == chunk._used ) ) {
+		chunk._used = line_._offset;
+	}
+	if ( -- chunk._live > 0 ) {
+		return;
+	}
+	if ( last ) {
+		chunk._used = 0;
+	} else {
+		_allocated -= ( chunk._data ? chunk._capacity : 0 ) + chunk._packedSize;
+		chunk._data.reset();
+		chunk._packed.reset();
+		chunk._capacity = 0;
+		chunk._packedSize = 0;
+	}
+	while ( ( _chunks.size() > 1 ) && ( _chunks.front()._live == 0 ) ) {
+		_allocated -= _chunks.front()._data ? _chunks.front()._capacity : 0;
+		_chunks.pop_front();
+		++ _firstChunk;
+	}
+}
+
+void LineArena::clear( void ) {
+	_firstChunk += static_cast<int>( _chunks.size() );
+	_chunks.clear();
+	_inflated.clear();
+	_allocated = 0;
+}
+
+void LineArena::set_compression( int hotChunks_, int inflatedLimit_ ) {
+	_hotChunks = max( hotChunks_, 0 );
+	_inflatedLimit = max( inflatedLimit_, 1 );
+	for ( int id : _inflated ) {
+		int idx( id - _firstChunk );
+		if ( ( idx < 0 ) || ( idx >= static_cast<int>( _chunks.size() ) ) ) {
+			continue;
+		}
+		Chunk& chunk( _chunks[idx] );
+		if ( chunk._packed && chunk._data ) {
+			chunk._data.reset();
+			_allocated -= chunk._capacity;
+		}
+	}
+	_inflated.clear();
+	int cold( _hotChunks > 0 ? static_cast<int>( _chunks.size() ) - _hotChunks : 0 );
+	for ( int i( 0 ); i < static_cast<int>( _chunks.size() ); ++ i ) {
+		if ( i < cold ) {
+			pack( _chunks[i] );
+		} else {
+			unpack( _chunks[i] );
+		}
+	}
+}
+
+/*
+ * Chunks that do not get any smaller are left as they are.
+ * A compressed chunk only needs _used bytes once decompressed,
+ * which becomes its capacity.
+ */
+void LineArena::pack( Chunk& chunk_ ) {
+	if ( ! chunk_._data || chunk_._packed || ( chunk_._live == 0 ) ) {
+		return;
+	}
+	std::unique_ptr<char[]> buffer( new char[lz_bound( chunk_._used )] );
+	int size( lz_compress( chunk_._data.get(), chunk_._used, buffer.get() ) );
+	if ( size >= chunk_._used ) {
+		return;
+	}
+	chunk_._packed.reset( new char[size] );
+	memcpy( chunk_._packed.get(), buffer.get(), static_cast<size_t>( size ) );
+	chunk_._packedSize = size;
+	_allocated += size - chunk_._capacity;
+	chunk_._capacity = chunk_._used;
+	chunk_._data.reset();
+}
+
+void LineArena::unpack( Chunk& chunk_ ) {
+	if ( ! chunk_._packed ) {
+		return;
+	}
+	if ( ! chunk_._data ) {
+		chunk_._data.reset( new char[chunk_._capacity] );
+		lz_decompress( chunk_._packed.get(), chunk_._packedSize, chunk_._data.get(), chunk_._used );
+		_allocated += chunk_._capacity;
+	}
+	_allocated -= chunk_._packedSize;
+	chunk_._packed.reset();
+	chunk_._packedSize = 0;
+}
+
+/*
+ * Only the last chunk ever gets new lines, freezing it is enough
+ * to keep the snapshot from seeing bytes change underneath.
+ */
+LineArena::Snapshot LineArena::snapshot( void ) {
+	Snapshot snapshot;
+	snapshot._firstChunk = _firstChunk;
+	snapshot._chunks.reserve( _chunks.size() );
+	for ( Chunk const& chunk : _chunks ) {
+		snapshot._chunks.push_back( Snapshot::Chunk{ chunk._data, chunk._data ? nullptr : chunk._packed, chunk._used, chunk._packedSize } );
+	}
+	if ( ! _chunks.empty() ) {
+		_chunks.back()._frozen = true;
+	}
+	return ( snapshot );
+}
+
+LineArena::Snapshot::Snapshot( void )
+	: _chunks()
+	, _firstChunk( 0 )
+	, _inflated()
+	, _inflatedId( -1 ) {
+}
+
+char const* LineArena::Snapshot::get( Line const& line_ ) const {
+	Chunk const& chunk( _chunks[line_._chunk - _firstChunk] );
+	if ( chunk._data ) {
+		return ( chunk._data.get() + line_._offset );
+	}
+	if ( _inflatedId != line_._chunk ) {
+		_inflated.reset( new char[chunk._used] );
+		lz_decompress( chunk._packed.get(), chunk._packedSize, _inflated.get(), chunk._used );
+		_inflatedId = line_._chunk;
+	}
+	return ( _inflated.get() + line_._offset );
+}
+
+char const* LineArena::inflate( int id_ ) const {
+	Chunk const& chunk( _chunks[id_ - _firstChunk] );
+	chunk._data.reset( new char[chunk._capacity] );
+	lz_decompress( chunk._packed.get(), chunk._packedSize, chunk._data.get(), chunk._used );
+	_allocated += chunk._capacity;
+	_inflated.push_back( id_ );
+	while ( static_cast<int>( _inflated.size() ) > _inflatedLimit ) {
+		int idx( _inflated.front() - _firstChunk );
+		_inflated.pop_front();
+		if ( ( idx < 0 ) || ( idx >= static_cast<int>( _chunks.size() ) ) ) {
+			continue;
+		}
+		Chunk const& victim( _chunks[idx] );
+		if ( victim._packed && victim._data ) {
+			victim._data.reset();
+			_allocated -= victim._capacity;
+		}
+	}
+	return ( chunk._data.get() );
+}
+
+}
@@ -0,0 +1,118 @@
+#ifndef REPLXX_LINEARENA_HXX_INCLUDED
+#define REPLXX_LINEARENA_HXX_INCLUDED 1
+
+#include <deque>
+#include <vector>
+#include <memory>
+
+namespace replxx {
+
+/*
+ * Storage for history lines.
+ *
+ * Line bytes are packed (NUL terminated) into large contiguous chunks
+ * and addressed by small offset/length records, so loading a big history
+ * does a handful of allocations instead of one per line.
+ * A chunk is freed as soon as the last line it holds is released.
+ *
+ * With compression enabled only the newest chunks are kept as they are,
+ * older (cold) ones are compressed as they fall out of that window and
+ * decompressed again on access.  A few decompressed cold chunks are
+ * kept around, the least recently decompressed one is dropped first.
+ *
+ * Chunk contents are shared with snapshots, which keep them alive,
+ * the chunk being filled at the time is never written to again.
+ */
+class LineArena {
+public:
+	struct Line {
+		int _chunk;  // chunk id
+		int _offset; // byte offset within the chunk
+		int _length; // line length in bytes, without the terminator
+	};
+	/*
+	 * Contents of the arena at the time it was taken, readable from
+	 * any (single) thread whatever happens to the arena later on.
+	 * Cold chunks are decompressed one at a time on access.
+	 */
+	class Snapshot {
+	private:
+		struct Chunk {
+			std::shared_ptr<char[]> _data;
+			std::shared_ptr<char[]> _packed;
+			int _used;
+			int _packedSize;
+		};
+		std::vector<Chunk> _chunks;
+		int _firstChunk;
+		mutable std::unique_ptr<char[]> _inflated; // contents of one cold chunk
+		mutable int _inflatedId;
+	public:
+		Snapshot( void );
+		/*! \brief Get text of given line, as stored when the snapshot was taken.
+		 *
+		 * The pointer is valid until the next call.
+		 */
+		char const* get( Line const& ) const;
+	private:
+		friend class LineArena;
+	};
+private:
+	struct Chunk {
+		mutable std::shared_ptr<char[]> _data; // null while a cold chunk is not decompressed
+		std::shared_ptr<char[]> _packed; // compressed form of a cold chunk
+		int _capacity;
+		int _used;
+		int _live; // number of lines stored in this chunk
+		int _packedSize;
+		bool _frozen; // shared with a snapshot, no more lines go in
+	};
+	typedef std::deque<Chunk> chunks_t;
+	typedef std::deque<int> inflated_t;
+	chunks_t _chunks;
+	int _firstChunk; // id of _chunks.front()
+	int _chunkSize;
+	int _hotChunks; // number of newest chunks never compressed, 0 disables compression
+	int _inflatedLimit; // decompressed cold chunks kept at most
+	mutable inflated_t _inflated; // ids of decompressed cold chunks, oldest first
+	mutable long long _allocated;
+public:
+	explicit LineArena( int chunkSize_ = 64 * 1024 );
+	Line store( char const* data_, int length_ );
+	void release( Line const& );
+	/*! \brief Get text of given line.
+	 *
+	 * The pointer is valid until the line is released or, for lines
+	 * in compressed chunks, until a few other cold chunks are accessed.
+	 */
+	char const* get( Line const& line_ ) const {
+		Chunk const& chunk( _chunks[line_._chunk - _firstChunk] );
+		return ( ( chunk._data ? chunk._data.get() : inflate( line_._chunk ) ) + line_._offset );
+	}
+	long long allocated( void ) const {
+		return ( _allocated );
+	}
+	/*! \brief Keep older chunks compressed.
+	 *
+	 * \param hotChunks_ - number of newest chunks left uncompressed, 0 disables compression.
+	 * \param inflatedLimit_ - number of decompressed cold chunks to keep around.
+	 */
+	void set_compression( int hotChunks_, int inflatedLimit_ );
+	bool is_compressed( void ) const {
+		return ( _hotChunks > 0 );
+	}
+	/*! \brief Take a snapshot sharing contents with this arena.
+	 */
+	Snapshot snapshot( void );
+	void clear( void );
+private:
+	char const* inflate( int ) const;
+	void pack( Chunk& );
+	void unpack( Chunk& );
+	LineArena( LineArena const& ) = delete;
+	LineArena& operator = ( LineArena const& ) = delete;
+};
+
+}
+
+#endif
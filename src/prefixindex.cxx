@@ -0,0 +1,149 @@
+#include <algorithm>
+
+#include "prefixindex.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+inline unsigned long long edge( int node_, char byte_ ) {
+	return ( ( static_cast<unsigned long long>( node_ ) << 8 ) | static_cast<unsigned char>( byte_ ) );
+}
+
+}
+
+PrefixIndex::PrefixIndex( void )
+	: _nodes( 1, Node{ postings_t(), 0 } )
+	, _children()
+	, _free() {
+}
+
+int PrefixIndex::child( int node_, char byte_ ) const {
+	children_t::const_iterator it( _children.find( edge( node_, byte_ ) ) );
+	return ( it != _children.end() ? it->second : -1 );
+}
+
+void PrefixIndex::add( serial_t serial_, char const* data_, int length_ ) {
+	int node( 0 );
+	_nodes[0]._serials.push_back( serial_ );
+	for ( int i( 0 ); ( i < length_ ) && ( i < MAX_DEPTH ); ++ i ) {
+		int next( child( node, data_[i] ) );
+		if ( next < 0 ) {
+			if ( ! _free.empty() ) {
+				next = _free.back();
+				_free.pop_back();
+			} else {
+				next = static_cast<int>( _nodes.size() );
+				_nodes.push_back( Node{ postings_t(), 0 } );
+			}
+			_children.insert( make_pair( edge( node, data_[i] ), next ) );
+		}
+		node = next;
+		_nodes[node]._serials.push_back( serial_ );
+	}
+}
+
+/*
+ * Walk the path of given line applying \e remove_ to every node on it,
+ * nodes left without any line are unlinked and recycled.
+ */
+template<typename remove_t>
+void PrefixIndex::remove( char const* data_, int length_, remove_t remove_ ) {
+	int parent( -1 );
+	int node( 0 );
+	for ( int i( 0 ); node >= 0; ++ i ) {
+		Node& n( _nodes[node] );
+		remove_( n );
+		int next( ( i < length_ ) && ( i < MAX_DEPTH ) ? child( node, data_[i] ) : -1 );
+		if ( ( node > 0 ) && ( n._first == static_cast<int>( n._serials.size() ) ) ) {
+			_children.erase( edge( parent, data_[i - 1] ) );
+			postings_t().swap( n._serials );
+			n._first = 0;
+			_free.push_back( node );
+		}
+		parent = node;
+		node = next;
+	}
+}
+
+void PrefixIndex::remove_last( serial_t serial_, char const* data_, int length_ ) {
+	remove(
+		data_, length_,
+		[serial_]( Node& n_ ) {
+			while ( ( n_._first < static_cast<int>( n_._serials.size() ) ) && ( n_._serials.back() >= serial_ ) ) {
+				n_._serials.pop_back();
+			}
+		}
+	);
+}
+
+void PrefixIndex::remove_first( serial_t serial_, char const* data_, int length_ ) {
+	remove(
+		data_, length_,
+		[serial_]( Node& n_ ) {
+			while ( ( n_._first < static_cast<int>( n_._serials.size() ) ) && ( n_._serials[n_._first] <= serial_ ) ) {
+				++ n_._first;
+			}
+			if ( ( n_._first * 2 ) >= static_cast<int>( n_._serials.size() ) ) {
+				n_._serials.erase( n_._serials.begin(), n_._serials.begin() + n_._first );
+				n_._first = 0;
+			}
+		}
+	);
+}
+
+bool PrefixIndex::find( char const* prefix_, int length_, serial_t from_, bool back_, accept_t const& accept_, serial_t& found_ ) const {
+	int node( 0 );
+	for ( int i( 0 ); ( i < length_ ) && ( i < MAX_DEPTH ) && ( node >= 0 ); ++ i ) {
+		node = child( node, prefix_[i] );
+	}
+	if ( node < 0 ) {
+		return ( false );
+	}
+	postings_t::const_iterator first( _nodes[node]._serials.begin() + _nodes[node]._first );
+	postings_t::const_iterator last( _nodes[node]._serials.end() );
+	auto visit = [&accept_, &found_]( serial_t serial_ ) {
+		if ( accept_( serial_ ) ) {
+			found_ = serial_;
+			return ( true );
+		}
+		return ( false );
+	};
+	if ( back_ ) {
+		postings_t::const_iterator pivot( lower_bound( first, last, from_ ) );
+		for ( postings_t::const_iterator it( pivot ); it != first; ) {
+			if ( visit( *-- it ) ) {
+				return ( true );
+			}
+		}
+		for ( postings_t::const_iterator it( last ); ( it != pivot ) && ( *( it - 1 ) != from_ ); ) {
+			if ( visit( *-- it ) ) {
+				return ( true );
+			}
+		}
+	} else {
+		postings_t::const_iterator pivot( upper_bound( first, last, from_ ) );
+		for ( postings_t::const_iterator it( pivot ); it != last; ++ it ) {
+			if ( visit( *it ) ) {
+				return ( true );
+			}
+		}
+		for ( postings_t::const_iterator it( first ); ( it != pivot ) && ( *it != from_ ); ++ it ) {
+			if ( visit( *it ) ) {
+				return ( true );
+			}
+		}
+	}
+	return ( false );
+}
+
+void PrefixIndex::clear( void ) {
+	_nodes.assign( 1, Node{ postings_t(), 0 } );
+	_children.clear();
+	_free.clear();
+}
+
+}
+
@@ -0,0 +1,68 @@
+#ifndef REPLXX_PREFIXINDEX_HXX_INCLUDED
+#define REPLXX_PREFIXINDEX_HXX_INCLUDED 1
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+namespace replxx {
+
+/*
+ * Prefix trie over history lines.
+ *
+ * Each node keeps a sorted list of serial numbers of the lines starting
+ * with the node's prefix, so lines sharing a prefix can be enumerated in
+ * recency order.  Depth is capped at MAX_DEPTH bytes, candidates for
+ * longer prefixes have to be verified by the caller.
+ * Lines are expected to be added with increasing serial numbers
+ * and evicted oldest first.  Serials of lines removed from the middle
+ * are simply left behind, they go away together with the first older
+ * or newer line removed from the same node.
+ */
+class PrefixIndex {
+public:
+	typedef unsigned int serial_t;
+	typedef std::function<bool ( serial_t )> accept_t;
+	static int const MAX_DEPTH = 16;
+private:
+	typedef std::vector<serial_t> postings_t;
+	struct Node {
+		postings_t _serials;
+		int _first; // _serials before this one belong to evicted lines
+	};
+	typedef std::vector<Node> nodes_t;
+	typedef std::unordered_map<unsigned long long, int> children_t;
+	nodes_t _nodes;        // _nodes[0] is the root
+	children_t _children;  // ( parent << 8 | byte ) -> child
+	std::vector<int> _free; // recycled node ids
+public:
+	PrefixIndex( void );
+	void add( serial_t, char const*, int );
+	/*! \brief Forget the most recently added line (and anything newer).
+	 */
+	void remove_last( serial_t, char const*, int );
+	/*! \brief Forget the oldest line (and anything older).
+	 */
+	void remove_first( serial_t, char const*, int );
+	/*! \brief Find nearest candidate line starting with given prefix.
+	 *
+	 * Candidates are visited circularly, starting next to serial \e from_
+	 * towards older lines if \e back_ is set, towards newer ones otherwise,
+	 * until \e accept_ returns true.  Line \e from_ itself is never visited.
+	 *
+	 * \return True iff a candidate was accepted, its serial is stored in \e found_.
+	 */
+	bool find( char const* prefix_, int length_, serial_t from_, bool back_, accept_t const& accept_, serial_t& found_ ) const;
+	void clear( void );
+private:
+	int child( int, char ) const;
+	template<typename remove_t>
+	void remove( char const*, int, remove_t );
+	PrefixIndex( PrefixIndex const& ) = delete;
+	PrefixIndex& operator = ( PrefixIndex const& ) = delete;
+};
+
+}
+
+#endif
+
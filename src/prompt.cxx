@@ -114,16 +114,23 @@ void Prompt::set_text( std::string const& text_ ) {
 //
 const UnicodeString forwardSearchBasePrompt("(i-search)`");
 const UnicodeString reverseSearchBasePrompt("(reverse-i-search)`");
+const UnicodeString fuzzySearchBasePrompt("(fuzzy-search)`");
 const UnicodeString endSearchBasePrompt("': ");
 UnicodeString previousSearchText;	// remembered across invocations of replxx_input()
 
+static UnicodeString const* search_base_prompt( int direction_ ) {
+	if ( direction_ == 0 ) {
+		return ( &fuzzySearchBasePrompt );
+	}
+	return ( ( direction_ > 0 ) ? &forwardSearchBasePrompt : &reverseSearchBasePrompt );
+}
+
 DynamicPrompt::DynamicPrompt( Terminal& terminal_, int initialDirection )
 	: Prompt( terminal_ )
 	, _searchText()
 	, _direction( initialDirection ) {
 	_cursorRowOffset = 0;
-	const UnicodeString* basePrompt =
-			(_direction > 0) ? &forwardSearchBasePrompt : &reverseSearchBasePrompt;
+	const UnicodeString* basePrompt = search_base_prompt( _direction );
 	size_t promptStartLength = basePrompt->length();
 	_characterCount = static_cast<int>(promptStartLength + endSearchBasePrompt.length());
 	_byteCount = _characterCount;
@@ -138,8 +145,7 @@ DynamicPrompt::DynamicPrompt( Terminal& terminal_, int initialDirection )
 }
 
 void DynamicPrompt::updateSearchPrompt(void) {
-	const UnicodeString* basePrompt =
-			(_direction > 0) ? &forwardSearchBasePrompt : &reverseSearchBasePrompt;
+	const UnicodeString* basePrompt = search_base_prompt( _direction );
 	size_t promptStartLength = basePrompt->length();
 	_characterCount = static_cast<int>(promptStartLength + _searchText.length() +
 																 endSearchBasePrompt.length());
@@ -38,7 +38,7 @@ extern UnicodeString previousSearchText; // remembered across invocations of rep
 //
 struct DynamicPrompt : public Prompt {
 	UnicodeString _searchText; // text we are searching for
-	int _direction;            // current search _direction, 1=forward, -1=reverse
+	int _direction;            // current search _direction, 1=forward, -1=reverse, 0=fuzzy
 
 	DynamicPrompt( Terminal&, int initialDirection );
 	void updateSearchPrompt(void);
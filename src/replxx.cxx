@@ -151,6 +151,14 @@ int Replxx::history_load( std::string const& filename ) {
 	return ( _impl->history_load( filename ) );
 }
 
+int Replxx::history_sync( void ) {
+	return ( _impl->history_sync() );
+}
+
+void Replxx::set_history_async_save( std::string const& filename, int syncInterval ) {
+	_impl->set_history_async_save( filename, syncInterval );
+}
+
 int Replxx::history_size( void ) const {
 	return ( _impl->history_size() );
 }
@@ -159,6 +167,14 @@ std::string const& Replxx::history_line( int index ) {
 	return ( _impl->history_line( index ) );
 }
 
+long long Replxx::history_timestamp( int index ) const {
+	return ( _impl->history_timestamp( index ) );
+}
+
+int Replxx::history_scan( history_visitor_t const& visitor, std::string_view prefix, std::string_view substring ) const {
+	return ( _impl->history_scan( visitor, prefix, substring ) );
+}
+
 void Replxx::set_preload_buffer( std::string const& preloadText ) {
 	_impl->set_preload_buffer( preloadText );
 }
@@ -191,10 +207,58 @@ void Replxx::set_no_color( bool val ) {
 	_impl->set_no_color( val );
 }
 
+void Replxx::set_input_coalescing( int maxLatency ) {
+	_impl->set_input_coalescing( maxLatency );
+}
+
+void Replxx::set_differential_rendering( bool val ) {
+	_impl->set_differential_rendering( val );
+}
+
 void Replxx::set_max_history_size( int len ) {
 	_impl->set_max_history_size( len );
 }
 
+void Replxx::set_history_append_only( bool val ) {
+	_impl->set_history_append_only( val );
+}
+
+void Replxx::set_history_shared( bool val ) {
+	_impl->set_history_shared( val );
+}
+
+void Replxx::set_unique_history( bool val ) {
+	_impl->set_unique_history( val );
+}
+
+void Replxx::set_history_binary( bool val ) {
+	_impl->set_history_binary( val );
+}
+
+void Replxx::set_history_lazy_load( int lines ) {
+	_impl->set_history_lazy_load( lines );
+}
+
+void Replxx::set_history_frecency( bool val ) {
+	_impl->set_history_frecency( val );
+}
+
+void Replxx::set_history_decode_cache( int bytes ) {
+	_impl->set_history_decode_cache( bytes );
+}
+
+void Replxx::set_history_search_threads( int threads ) {
+	_impl->set_history_search_threads( threads );
+}
+
+void Replxx::set_history_compression( bool val ) {
+	_impl->set_history_compression( val );
+}
+
+Replxx::hints_t Replxx::history_frecent( std::string const& prefix, int count ) const {
+	return ( _impl->history_frecent( prefix, count ) );
+}
+
 void Replxx::clear_screen( void ) {
 	_impl->clear_screen( 0 );
 }
@@ -357,6 +421,57 @@ void replxx_set_max_history_size( ::Replxx* replxx_, int len ) {
 	replxx->set_max_history_size( len );
 }
 
+void replxx_set_history_append_only( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_append_only( val ? true : false );
+}
+
+void replxx_set_history_shared( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_shared( val ? true : false );
+}
+
+void replxx_set_unique_history( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_unique_history( val ? true : false );
+}
+
+void replxx_set_history_binary( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_binary( val ? true : false );
+}
+
+void replxx_set_history_lazy_load( ::Replxx* replxx_, int lines ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_lazy_load( lines );
+}
+
+void replxx_set_history_frecency( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_frecency( val ? true : false );
+}
+
+void replxx_set_history_decode_cache( ::Replxx* replxx_, int bytes ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_decode_cache( bytes );
+}
+
+void replxx_set_history_search_threads( ::Replxx* replxx_, int threads ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_search_threads( threads );
+}
+
+void replxx_set_history_compression( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_compression( val ? true : false );
+}
+
+void replxx_history_frecent( ::Replxx* replxx_, const char* prefix, int count, replxx_hints* hints ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx::Replxx::hints_t lines( replxx->history_frecent( prefix, count ) );
+	hints->data.insert( hints->data.end(), lines.begin(), lines.end() );
+}
+
 void replxx_set_max_hint_rows( ::Replxx* replxx_, int count ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
 	replxx->set_max_hint_rows( count );
@@ -387,16 +502,29 @@ void replxx_set_no_color( ::Replxx* replxx_, int val ) {
 	replxx->set_no_color( val ? true : false );
 }
 
+void replxx_set_input_coalescing( ::Replxx* replxx_, int maxLatency ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_input_coalescing( maxLatency );
+}
+
+void replxx_set_differential_rendering( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_differential_rendering( val ? true : false );
+}
+
 void replxx_set_beep_on_ambiguous_completion( ::Replxx* replxx_, int val ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
 	replxx->set_beep_on_ambiguous_completion( val ? true : false );
 }
 
 /* Fetch a line of the history by (zero-based) index.	If the requested
- * line does not exist, NULL is returned.	The return value is a heap-allocated
- * copy of the line. */
+ * line does not exist, NULL is returned.	The returned line is owned
+ * by the library and stays valid until the entry changes or leaves history. */
 char const* replxx_history_line( ::Replxx* replxx_, int index ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	if ( ( index < 0 ) || ( index >= replxx->history_size() ) ) {
+		return ( nullptr );
+	}
 	return ( replxx->history_line( index ).c_str() );
 }
 
@@ -407,6 +535,18 @@ int replxx_history_save( ::Replxx* replxx_, const char* filename ) {
 	return ( replxx->history_save( filename ) );
 }
 
+/* Wait until background history saving writes everything queued so far.
+ * On success 0 is returned otherwise -1 is returned. */
+int replxx_history_sync( ::Replxx* replxx_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return ( replxx->history_sync() );
+}
+
+void replxx_set_history_async_save( ::Replxx* replxx_, const char* filename, int syncInterval ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_history_async_save( filename ? filename : "", syncInterval );
+}
+
 /* Load the history from the specified file. If the file does not exist
  * zero is returned and no operation is performed.
  *
@@ -422,6 +562,24 @@ int replxx_history_size( ::Replxx* replxx_ ) {
 	return ( replxx->history_size() );
 }
 
+long long replxx_history_timestamp( ::Replxx* replxx_, int index ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return ( replxx->history_timestamp( index ) );
+}
+
+int replxx_history_scan( ::Replxx* replxx_, const char* prefix, const char* substring, replxx_history_visitor_t* fn, void* userData ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return (
+		replxx->history_scan(
+			[fn, userData]( int index, std::string_view line ) {
+				return ( fn( index, line.data(), static_cast<int>( line.length() ), userData ) != 0 );
+			},
+			prefix ? prefix : "",
+			substring ? substring : ""
+		)
+	);
+}
+
 /* This special mode is used by replxx in order to print scan codes
  * on screen for debugging / development purposes. It is implemented
  * by the replxx-c-api-example program using the --keycodes option. */
@@ -38,6 +38,8 @@ using namespace std;
 
 namespace replxx {
 
+int mk_wcwidth( char32_t );
+
 #ifndef _WIN32
 
 bool gotResize = false;
@@ -47,6 +49,7 @@ bool gotResize = false;
 namespace {
 
 static int const REPLXX_MAX_HINT_ROWS( 4 );
+static int const REPLXX_MAX_FUZZY_SEARCH_ROWS( 10 );
 /*
  * All whitespaces and all non-alphanumerical characters from ASCII range
  * with an exception of an underscore ('_').
@@ -89,6 +92,7 @@ Replxx::ReplxxImpl::ReplxxImpl( FILE*, FILE*, FILE* )
 	, _prefix( 0 )
 	, _hintSelection( -1 )
 	, _history()
+	, _historyWriter()
 	, _killRing()
 	, _maxHintRows( REPLXX_MAX_HINT_ROWS )
 	, _breakChars( defaultBreakChars )
@@ -97,13 +101,22 @@ Replxx::ReplxxImpl::ReplxxImpl( FILE*, FILE*, FILE* )
 	, _completeOnEmpty( true )
 	, _beepOnAmbiguousCompletion( false )
 	, _noColor( false )
+	, _coalesceLatency( 0 )
+	, _deferRefresh( false )
+	, _refreshPending( false )
+	, _pendingHintAction( HINT_ACTION::REGENERATE )
+	, _batchStart()
+	, _differentialRendering( false )
 	, _keyPressHandlers()
 	, _terminal()
 	, _prompt( _terminal )
+	, _screen( _terminal )
 	, _completionCallback( nullptr )
 	, _highlighterCallback( nullptr )
 	, _hintCallback( nullptr )
 	, _preloadedBuffer()
+	, _paste()
+	, _pastePos( 0 )
 	, _errorMessage() {
 	using namespace std::placeholders;
 	_keyPressHandlers.insert( make_pair( ctrlChar( 'A' ),        std::bind( &ReplxxImpl::go_to_begining_of_line,     this, _1 ) ) );
@@ -158,10 +171,13 @@ Replxx::ReplxxImpl::ReplxxImpl( FILE*, FILE*, FILE* )
 	_keyPressHandlers.insert( make_pair( CTRL + DOWN_ARROW_KEY,  std::bind( &ReplxxImpl::hint_next,                  this, _1 ) ) );
 #ifndef _WIN32
 	_keyPressHandlers.insert( make_pair( ctrlChar( 'Z' ),        std::bind( &ReplxxImpl::suspend,                    this, _1 ) ) );
+	_keyPressHandlers.insert( make_pair( PASTE_START_KEY,        std::bind( &ReplxxImpl::bracketed_paste,            this, _1 ) ) );
 #endif
 	_keyPressHandlers.insert( make_pair( ctrlChar( 'I' ),        std::bind( &ReplxxImpl::complete_line,              this, _1 ) ) );
 	_keyPressHandlers.insert( make_pair( ctrlChar( 'R' ),        std::bind( &ReplxxImpl::incremental_history_search, this, _1 ) ) );
 	_keyPressHandlers.insert( make_pair( ctrlChar( 'S' ),        std::bind( &ReplxxImpl::incremental_history_search, this, _1 ) ) );
+	_keyPressHandlers.insert( make_pair( META + 'r',             std::bind( &ReplxxImpl::fuzzy_history_search,       this, _1 ) ) );
+	_keyPressHandlers.insert( make_pair( META + 'R',             std::bind( &ReplxxImpl::fuzzy_history_search,       this, _1 ) ) );
 	_keyPressHandlers.insert( make_pair( META + 'p',             std::bind( &ReplxxImpl::common_prefix_search,       this, _1 ) ) );
 	_keyPressHandlers.insert( make_pair( META + 'P',             std::bind( &ReplxxImpl::common_prefix_search,       this, _1 ) ) );
 	_keyPressHandlers.insert( make_pair( META + 'n',             std::bind( &ReplxxImpl::common_prefix_search,       this, _1 ) ) );
@@ -172,6 +188,7 @@ void Replxx::ReplxxImpl::clear( void ) {
 	_pos = 0;
 	_prefix = 0;
 	_data.clear();
+	_charWidths.clear();
 	_hintSelection = -1;
 	_hint = UnicodeString();
 	_display.clear();
@@ -191,12 +208,18 @@ Replxx::ReplxxImpl::completions_t Replxx::ReplxxImpl::call_completer( std::strin
 	return ( completions );
 }
 
+/*
+ * Without a hint callback, hints come straight from history statistics
+ * if these are kept, the whole input is the context then.
+ */
 Replxx::ReplxxImpl::hints_t Replxx::ReplxxImpl::call_hinter( std::string const& input, int& contextLen, Replxx::Color& color ) const {
-	Replxx::hints_t hintsIntermediary(
-		!! _hintCallback
-			? _hintCallback( input, contextLen, color )
-			: Replxx::hints_t()
-	);
+	Replxx::hints_t hintsIntermediary;
+	if ( !! _hintCallback ) {
+		hintsIntermediary = _hintCallback( input, contextLen, color );
+	} else if ( _history.is_frecent() && ! input.empty() ) {
+		_history.frecent( input.data(), static_cast<int>( input.length() ), max( _maxHintRows, 1 ), hintsIntermediary );
+		contextLen = _pos;
+	}
 	hints_t hints;
 	hints.reserve( hintsIntermediary.size() );
 	for ( std::string const& h : hintsIntermediary ) {
@@ -329,16 +352,13 @@ int Replxx::ReplxxImpl::print( char const* str_, int size_ ) {
 
 void Replxx::ReplxxImpl::preloadBuffer(const char* preloadText) {
 	_data.assign( preloadText );
-	_charWidths.resize( _data.length() );
-	recomputeCharacterWidths( _data.get(), _charWidths.data(), _data.length() );
+	_charWidths.assign( _data.get(), _data.length() );
 	_prefix = _pos = _data.length();
 }
 
 void Replxx::ReplxxImpl::setColor( Replxx::Color color_ ) {
-	char const* code( ansi_color( color_ ) );
-	while ( *code ) {
-		_display.push_back( *code );
-		++ code;
+	if ( ! _noColor ) {
+		_display.append( ansi_color( color_ ) );
 	}
 }
 
@@ -353,21 +373,58 @@ void Replxx::ReplxxImpl::highlight( int highlightIdx, bool error_ ) {
 	}
 	_display.clear();
 	Replxx::Color c( Replxx::Color::DEFAULT );
+	int runStart( 0 );
 	for ( int i( 0 ); i < _data.length(); ++ i ) {
 		if ( colors[i] != c ) {
+			appendString32to8( _display, _data.get() + runStart, i - runStart );
+			runStart = i;
 			c = colors[i];
 			setColor( c );
 		}
-		_display.push_back( _data[i] );
 	}
+	appendString32to8( _display, _data.get() + runStart, _data.length() - runStart );
 	setColor( Replxx::Color::DEFAULT );
 }
 
+/*
+ * Postpone the redraw while more keystrokes are waiting, up to
+ * _coalesceLatency since the first postponed one.  The final
+ * redraw of a line (HINT_ACTION::SKIP) is never postponed,
+ * it is followed by writes that expect an up to date screen.
+ */
+bool Replxx::ReplxxImpl::defer_refresh( HINT_ACTION hintAction_ ) {
+	if ( ( _coalesceLatency <= 0 ) || ( hintAction_ == HINT_ACTION::SKIP ) || ! _terminal.has_input() ) {
+		return ( false );
+	}
+	std::chrono::steady_clock::time_point now( std::chrono::steady_clock::now() );
+	if ( ! _refreshPending ) {
+		_batchStart = now;
+		_pendingHintAction = hintAction_;
+	} else if ( ( now - _batchStart ) >= std::chrono::milliseconds( _coalesceLatency ) ) {
+		return ( false );
+	} else if ( _pendingHintAction != HINT_ACTION::REGENERATE ) {
+		_pendingHintAction = hintAction_;
+	}
+	_refreshPending = true;
+	return ( true );
+}
+
+/*
+ * Bring the screen up to date, handlers that draw on their
+ * own call it first so the rest of the keystroke redraws at once.
+ */
+void Replxx::ReplxxImpl::flush_refresh( void ) {
+	_deferRefresh = false;
+	if ( _refreshPending ) {
+		refresh_line( _pendingHintAction );
+	}
+}
+
 int Replxx::ReplxxImpl::handle_hints( HINT_ACTION hintAction_ ) {
 	if ( _noColor ) {
 		return ( 0 );
 	}
-	if ( ! _hintCallback ) {
+	if ( ! _hintCallback && ! _history.is_frecent() ) {
 		return ( 0 );
 	}
 	if ( hintAction_ == HINT_ACTION::SKIP ) {
@@ -390,9 +447,7 @@ int Replxx::ReplxxImpl::handle_hints( HINT_ACTION hintAction_ ) {
 		setColor( c );
 		_hint = hints.front();
 		len = _hint.length();
-		for ( int i( contextLen ); i < len; ++ i ) {
-			_display.push_back( _hint[i] );
-		}
+		appendString32to8( _display, _hint.get() + contextLen, len - contextLen );
 		setColor( Replxx::Color::DEFAULT );
 	} else if ( _maxHintRows > 0 ) {
 		int startCol( _prompt._indentation + _pos - contextLen );
@@ -409,9 +464,7 @@ int Replxx::ReplxxImpl::handle_hints( HINT_ACTION hintAction_ ) {
 		if ( _hintSelection != -1 ) {
 			_hint = hints[_hintSelection];
 			len = min<int>( _hint.length(), maxCol - startCol - _data.length() );
-			for ( int i( contextLen ); i < len; ++ i ) {
-				_display.push_back( _hint[i] );
-			}
+			appendString32to8( _display, _hint.get() + contextLen, len - contextLen );
 		}
 		setColor( Replxx::Color::DEFAULT );
 		for ( int hintRow( 0 ); hintRow < min( hintCount, _maxHintRows ); ++ hintRow ) {
@@ -419,14 +472,12 @@ int Replxx::ReplxxImpl::handle_hints( HINT_ACTION hintAction_ ) {
 			_display.push_back( '\r' );
 #endif
 			_display.push_back( '\n' );
-			int col( 0 );
-			for ( int i( 0 ); ( i < startCol ) && ( col < maxCol ); ++ i, ++ col ) {
-				_display.push_back( ' ' );
-			}
+			int col( min( startCol, maxCol ) );
+			_display.append( static_cast<size_t>( col ), ' ' );
 			setColor( c );
-			for ( int i( _pos - contextLen ); ( i < _pos ) && ( col < maxCol ); ++ i, ++ col ) {
-				_display.push_back( _data[i] );
-			}
+			int contextShown( min( contextLen, maxCol - col ) );
+			appendString32to8( _display, _data.get() + _pos - contextLen, contextShown );
+			col += contextShown;
 			int hintNo( hintRow + _hintSelection + 1 );
 			if ( hintNo == hintCount ) {
 				continue;
@@ -434,13 +485,12 @@ int Replxx::ReplxxImpl::handle_hints( HINT_ACTION hintAction_ ) {
 				-- hintNo;
 			}
 			UnicodeString const& h( hints[hintNo % hintCount] );
-			for ( int i( contextLen ); ( i < h.length() ) && ( col < maxCol ); ++ i, ++ col ) {
-				_display.push_back( h[i] );
-			}
+			appendString32to8( _display, h.get() + contextLen, min( h.length() - contextLen, maxCol - col ) );
 			setColor( Replxx::Color::DEFAULT );
 		}
 	}
-	return ( len - contextLen );
+	/* no inline hint shown when none of many is selected */
+	return ( max( len - contextLen, 0 ) );
 }
 
 /**
@@ -450,6 +500,10 @@ int Replxx::ReplxxImpl::handle_hints( HINT_ACTION hintAction_ ) {
  * screen position
  */
 void Replxx::ReplxxImpl::refresh_line( HINT_ACTION hintAction_ ) {
+	if ( _deferRefresh && defer_refresh( hintAction_ ) ) {
+		return;
+	}
+	_refreshPending = false;
 	// check for a matching brace/bracket/paren, remember its position if found
 	int highlightIdx = -1;
 	bool indicateError = false;
@@ -511,23 +565,26 @@ void Replxx::ReplxxImpl::refresh_line( HINT_ACTION hintAction_ ) {
 	highlight( highlightIdx, indicateError );
 	int hintLen( handle_hints( hintAction_ ) );
 	// calculate the position of the end of the input line
+	int inputWidth( _charWidths.column( _data.length() ) );
 	int xEndOfInput( 0 ), yEndOfInput( 0 );
 	calculateScreenPosition(
 		_prompt._indentation, 0, _prompt.screen_columns(),
-		calculateColumnPosition( _data.get(), _data.length() ) + hintLen,
+		inputWidth + hintLen,
 		xEndOfInput, yEndOfInput
 	);
 	yEndOfInput += count( _display.begin(), _display.end(), '\n' );
 
-	// calculate the desired position of the cursor
+	// calculate the desired position of the cursor, usually at the end of input
 	int xCursorPos( 0 ), yCursorPos( 0 );
 	calculateScreenPosition(
 		_prompt._indentation, 0, _prompt.screen_columns(),
-		calculateColumnPosition(_data.get(), _pos),
+		_pos == _data.length() ? inputWidth : _charWidths.column( _pos ),
 		xCursorPos,
 		yCursorPos
 	);
 
+	// the whole redraw goes out in one write
+	_terminal.begin_frame();
 #ifdef _WIN32
 	// position at the end of the prompt, clear to end of previous input
 	_terminal.jump_cursor(
@@ -538,11 +595,7 @@ void Replxx::ReplxxImpl::refresh_line( HINT_ACTION hintAction_ ) {
 	_prompt._previousInputLen = _data.length();
 
 	// display the input line
-	if ( !_noColor ) {
-		_terminal.write32( _display.data(), _display.size() );
-	} else {
-		_terminal.write32( _data.get(), _data.length() );
-	}
+	_terminal.write8( _display.data(), static_cast<int>( _display.size() ) );
 
 	// position the cursor
 	_terminal.jump_cursor(
@@ -550,41 +603,56 @@ void Replxx::ReplxxImpl::refresh_line( HINT_ACTION hintAction_ ) {
 		-( yEndOfInput - yCursorPos )
 	);
 #else // _WIN32
-	char seq[64];
-	int cursorRowMovement = _prompt._cursorRowOffset - _prompt._extraLines;
-	if (cursorRowMovement > 0) { // move the cursor up as required
-		snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
-		_terminal.write8( seq, strlen(seq) );
-	}
-	// position at the end of the prompt, clear to end of screen
-	snprintf(
-		seq, sizeof seq, "\x1b[%dG\x1b[%c",
-		_prompt._indentation + 1, /* 1-based on VT100 */
-		'J'
+	bool modelled(
+		_differentialRendering
+		&& _screen.layout(
+			_display.data(), static_cast<int>( _display.size() ), ( xEndOfInput == 0 ) && ( yEndOfInput > 0 ),
+			_prompt._indentation, _prompt.screen_columns(), _terminal.get_screen_rows() - _prompt._extraLines
+		)
+		&& ( _screen.end_row() == yEndOfInput )
 	);
-	_terminal.write8( seq, strlen(seq) );
+	if ( modelled && _screen.is_current( _prompt._indentation, _prompt.screen_columns(), _prompt._cursorRowOffset - _prompt._extraLines ) ) {
+		// send only the cells that changed since the last redraw
+		_screen.update( yCursorPos, xCursorPos );
+	} else {
+		char seq[64];
+		int cursorRowMovement = _prompt._cursorRowOffset - _prompt._extraLines;
+		if (cursorRowMovement > 0) { // move the cursor up as required
+			snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
+			_terminal.write8( seq, strlen(seq) );
+		}
+		// position at the end of the prompt, clear to end of screen
+		snprintf(
+			seq, sizeof seq, "\x1b[%dG\x1b[%c",
+			_prompt._indentation + 1, /* 1-based on VT100 */
+			'J'
+		);
+		_terminal.write8( seq, strlen(seq) );
 
-	if ( !_noColor ) {
-		_terminal.write32( _display.data(), _display.size() );
-	} else { // highlightIdx the matching brace/bracket/parenthesis
-		_terminal.write32( _data.get(), _data.length() );
-	}
+		_terminal.write8( _display.data(), static_cast<int>( _display.size() ) );
 
-	// we have to generate our own newline on line wrap
-	if (xEndOfInput == 0 && yEndOfInput > 0) {
-		_terminal.write8( "\n", 1 );
-	}
+		// we have to generate our own newline on line wrap
+		if (xEndOfInput == 0 && yEndOfInput > 0) {
+			_terminal.write8( "\n", 1 );
+		}
 
-	// position the cursor
-	cursorRowMovement = yEndOfInput - yCursorPos;
-	if (cursorRowMovement > 0) { // move the cursor up as required
-		snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
+		// position the cursor
+		cursorRowMovement = yEndOfInput - yCursorPos;
+		if (cursorRowMovement > 0) { // move the cursor up as required
+			snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
+			_terminal.write8( seq, strlen(seq) );
+		}
+		// position the cursor within the line
+		snprintf(seq, sizeof seq, "\x1b[%dG", xCursorPos + 1); // 1-based on VT100
 		_terminal.write8( seq, strlen(seq) );
+		if ( modelled ) {
+			_screen.commit( yCursorPos, xCursorPos );
+		} else {
+			_screen.invalidate();
+		}
 	}
-	// position the cursor within the line
-	snprintf(seq, sizeof seq, "\x1b[%dG", xCursorPos + 1); // 1-based on VT100
-	_terminal.write8( seq, strlen(seq) );
 #endif
+	_terminal.end_frame();
 
 	_prompt._cursorRowOffset = _prompt._extraLines + yCursorPos; // remember row for next pass
 }
@@ -678,6 +746,8 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 		_pos -= contextLen;
 		_data.erase( _pos, contextLen );
 		_data.insert( _pos, completions[selectedCompletion], 0, longestCommonPrefix );
+		_charWidths.erase( _pos, contextLen );
+		_charWidths.insert( _pos, _data.get() + _pos, longestCommonPrefix );
 		_prefix = _pos = _pos + longestCommonPrefix;
 		refresh_line();
 		return 0;
@@ -727,6 +797,8 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 	}
 
 	// if showing the list, do it the way readline does it
+	// collect the list and the redraw below it for a single write
+	_terminal.begin_frame();
 	bool stopList( false );
 	if ( showCompletions ) {
 		int longestCompletion( 0 );
@@ -753,8 +825,7 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 		size_t rowCount = (completions.size() + columnCount - 1) / columnCount;
 		for (size_t row = 0; row < rowCount; ++row) {
 			if (row == pauseRow) {
-				printf("\n--More--");
-				fflush(stdout);
+				_terminal.write8( "\n--More--", 9 );
 				c = 0;
 				bool doBeep = false;
 				while (c != ' ' && c != '\r' && c != '\n' && c != 'y' && c != 'Y' &&
@@ -772,19 +843,19 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 					case ' ':
 					case 'y':
 					case 'Y':
-						printf("\r				\r");
+						_terminal.write8( "\r				\r", 6 );
 						pauseRow += _terminal.get_screen_rows() - 1;
 						break;
 					case '\r':
 					case '\n':
-						printf("\r				\r");
+						_terminal.write8( "\r				\r", 6 );
 						++pauseRow;
 						break;
 					case 'n':
 					case 'N':
 					case 'q':
 					case 'Q':
-						printf("\r				\r");
+						_terminal.write8( "\r				\r", 6 );
 						stopList = true;
 						break;
 					case ctrlChar('C'):
@@ -794,7 +865,7 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 						break;
 				}
 			} else {
-				printf("\n");
+				_terminal.write8( "\n", 1 );
 			}
 			if (stopList) {
 				break;
@@ -803,7 +874,6 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 				size_t index = (column * rowCount) + row;
 				if (index < completions.size()) {
 					int itemLength = static_cast<int>(completions[index].length());
-					fflush(stdout);
 
 					if ( longestCommonPrefix > 0 ) {
 						static UnicodeString const col(ansi_color(Replxx::Color::BRIGHTMAGENTA));
@@ -821,13 +891,12 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 
 					if (((column + 1) * rowCount) + row < completions.size()) {
 						for ( int k( itemLength ); k < longestCompletion; ++k ) {
-							printf( " " );
+							_terminal.write8( " ", 1 );
 						}
 					}
 				}
 			}
 		}
-		fflush(stdout);
 	}
 
 	// display the prompt on a new line, then redisplay the input buffer
@@ -843,16 +912,20 @@ int Replxx::ReplxxImpl::do_complete_line( void ) {
 #endif
 	_prompt._cursorRowOffset = _prompt._extraLines;
 	refresh_line();
+	_terminal.end_frame();
 	return 0;
 }
 
 int Replxx::ReplxxImpl::getInputLine( void ) {
+	// pick up lines other sessions added to the shared history file
+	_history.merge();
+
 	// The latest history entry is always our current buffer
 	if ( _data.length() > 0 ) {
 		_utf8Buffer.assign( _data );
-		history_add( _utf8Buffer.get() );
+		_history.add_edit_slot( _utf8Buffer.get() );
 	} else {
-		history_add( "" );
+		_history.add_edit_slot( "" );
 	}
 	_history.reset_pos();
 
@@ -880,6 +953,17 @@ int Replxx::ReplxxImpl::getInputLine( void ) {
 	// loop collecting characters, respond to line editing characters
 	NEXT next( NEXT::CONTINUE );
 	while ( next == NEXT::CONTINUE ) {
+		// redraw once the batch of waiting keystrokes is handled
+		if ( _refreshPending && ! _terminal.has_input() ) {
+			flush_refresh();
+		}
+#ifndef _WIN32
+		// lines of a multi line paste go before any further keystrokes
+		if ( _pastePos < _paste.length() ) {
+			next = insert_paste();
+			continue;
+		}
+#endif
 		int c( _terminal.read_char() ); // get a new keystroke
 #ifndef _WIN32
 		if (c == 0 && gotResize) {
@@ -908,13 +992,16 @@ int Replxx::ReplxxImpl::getInputLine( void ) {
 			continue;
 		}
 
+		_deferRefresh = true;
 		key_press_handlers_t::iterator it( _keyPressHandlers.find( c ) );
 		if ( it != _keyPressHandlers.end() ) {
 			next = it->second( c );
 		} else {
 			next = insert_character( c );
 		}
+		_deferRefresh = false;
 	}
+	flush_refresh();
 	return ( next == NEXT::RETURN ? _data.length() : -1 );
 }
 
@@ -930,12 +1017,17 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::insert_character( int c ) {
 		return ( NEXT::CONTINUE );
 	}
 	_data.insert( _pos, c );
+	_charWidths.insert( _pos, _data.get() + _pos, 1 );
 	++ _pos;
 	_prefix = _pos;
-	int inputLen = calculateColumnPosition( _data.get(), _data.length() );
-	if ( _noColor
-		|| ( ! ( !! _highlighterCallback || !! _hintCallback )
-			&& ( _prompt._indentation + inputLen < _prompt.screen_columns() )
+	int inputLen = _charWidths.column( _data.length() );
+	if (
+		! _refreshPending
+		&& ! _differentialRendering
+		&& ( _noColor
+			|| ( ! ( !! _highlighterCallback || !! _hintCallback || _history.is_frecent() )
+				&& ( _prompt._indentation + inputLen < _prompt.screen_columns() )
+			)
 		)
 	) {
 		/* Avoid a full assign of the line in the
@@ -1033,6 +1125,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::kill_word_to_left( int ) {
 		_prefix = _pos;
 		_killRing.kill( _data.get() + _pos, startingPos - _pos, false);
 		_data.erase( _pos, startingPos - _pos );
+		_charWidths.erase( _pos, startingPos - _pos );
 		refresh_line();
 	}
 	_killRing.lastAction = KillRing::actionKill;
@@ -1053,6 +1146,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::kill_word_to_right( int ) {
 		_prefix = _pos;
 		_killRing.kill( _data.get() + _pos, endingPos - _pos, true );
 		_data.erase( _pos, endingPos - _pos );
+		_charWidths.erase( _pos, endingPos - _pos );
 		refresh_line();
 	}
 	_killRing.lastAction = KillRing::actionKill;
@@ -1073,6 +1167,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::kill_to_whitespace_to_left( int ) {
 		_prefix = _pos;
 		_killRing.kill( _data.get() + _pos, startingPos - _pos, false );
 		_data.erase( _pos, startingPos - _pos );
+		_charWidths.erase( _pos, startingPos - _pos );
 		refresh_line();
 	}
 	_killRing.lastAction = KillRing::actionKill;
@@ -1082,6 +1177,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::kill_to_whitespace_to_left( int ) {
 // ctrl-K, kill from cursor to end of line
 Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::kill_to_end_of_line( int ) {
 	_killRing.kill( _data.get() + _pos, _data.length() - _pos, true );
+	_charWidths.erase( _pos, _data.length() - _pos );
 	_data.erase( _pos, _data.length() - _pos );
 	refresh_line();
 	_killRing.lastAction = KillRing::actionKill;
@@ -1095,6 +1191,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::kill_to_begining_of_line( int ) {
 		_history.reset_recall_most_recent();
 		_killRing.kill( _data.get(), _pos, false );
 		_data.erase( 0, _pos );
+		_charWidths.erase( 0, _pos );
 		_prefix = _pos = 0;
 		refresh_line();
 	}
@@ -1108,6 +1205,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::yank( int ) {
 	UnicodeString* restoredText( _killRing.yank() );
 	if ( restoredText ) {
 		_data.insert( _pos, *restoredText, 0, restoredText->length() );
+		_charWidths.insert( _pos, restoredText->get(), restoredText->length() );
 		_pos += restoredText->length();
 		_prefix = _pos;
 		refresh_line();
@@ -1134,6 +1232,8 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::yank_cycle( int ) {
 	_pos -= _killRing.lastYankSize;
 	_data.erase( _pos, _killRing.lastYankSize );
 	_data.insert( _pos, *restoredText, 0, restoredText->length() );
+	_charWidths.erase( _pos, _killRing.lastYankSize );
+	_charWidths.insert( _pos, restoredText->get(), restoredText->length() );
 	_pos += restoredText->length();
 	_prefix = _pos;
 	_killRing.lastYankSize = restoredText->length();
@@ -1216,6 +1316,8 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::transpose_characters( int ) {
 		char32_t aux = _data[leftCharPos];
 		_data[leftCharPos] = _data[leftCharPos + 1];
 		_data[leftCharPos + 1] = aux;
+		_charWidths.erase( leftCharPos, 2 );
+		_charWidths.insert( leftCharPos, _data.get() + leftCharPos, 2 );
 		if ( _pos != _data.length() ) {
 			++_pos;
 		}
@@ -1245,6 +1347,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::delete_character( int ) {
 	if ( ( _data.length() > 0 ) && ( _pos < _data.length() ) ) {
 		_history.reset_recall_most_recent();
 		_data.erase( _pos );
+		_charWidths.erase( _pos, 1 );
 		refresh_line();
 	}
 	return ( NEXT::CONTINUE );
@@ -1268,6 +1371,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::backspace_character( int ) {
 		-- _pos;
 		_prefix = _pos;
 		_data.erase( _pos );
+		_charWidths.erase( _pos, 1 );
 		refresh_line();
 	}
 	return ( NEXT::CONTINUE );
@@ -1311,7 +1415,9 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::history_move( bool previous_, int )
 	if ( ! _history.move( previous_ ) ) {
 		return ( NEXT::CONTINUE );
 	}
-	_data.assign( _history.current() );
+	History::Decoded const& decoded( _history.current_decoded() );
+	_data.assign( decoded._text );
+	_charWidths.assign_widths( decoded.widths() );
 	_prefix = _pos = _data.length();
 	refresh_line();
 	return ( NEXT::CONTINUE );
@@ -1340,7 +1446,9 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::history_jump( bool back_, int ) {
 	}
 	if ( ! _history.is_empty() ) {
 		_history.jump( back_ );
-		_data.assign( _history.current().c_str() );
+		History::Decoded const& decoded( _history.current_decoded() );
+		_data.assign( decoded._text );
+		_charWidths.assign_widths( decoded.widths() );
 		_prefix = _pos = _data.length();
 		refresh_line();
 	}
@@ -1371,6 +1479,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::hint_move( bool previous_, int ) {
 #ifndef _WIN32
 // ctrl-Z, job control
 Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::suspend( int ) {
+	flush_refresh();
 	_terminal.disable_raw_mode(); // Returning to Linux (whatever) shell, leave raw mode
 	raise(SIGSTOP);   // Break out in mid-line
 	_terminal.enable_raw_mode();  // Back from Linux shell, re-enter raw mode
@@ -1379,12 +1488,93 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::suspend( int ) {
 	refresh_line();  // Refresh the line
 	return ( NEXT::CONTINUE );
 }
+
+// ESC [ 200 ~, bracketed paste, insert pasted text as a whole
+Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::bracketed_paste( int ) {
+	_paste.clear();
+	_pastePos = 0;
+	read_paste( _paste );
+	return ( insert_paste() );
+}
+
+/*
+ * Read text of bracketed paste, keep line breaks (CR LF and lone CR
+ * become LF), turn tabs into spaces so they do not trigger completion,
+ * and drop other control characters.
+ */
+void Replxx::ReplxxImpl::read_paste( UnicodeString& text_ ) {
+	Terminal::input_t pasted;
+	/* input ending mid paste is picked up by the next read */
+	_terminal.read_paste( pasted );
+	for ( size_t i( 0 ); i < pasted.size(); ++ i ) {
+		char32_t c( pasted[i] );
+		if ( c == '\r' ) {
+			if ( ( ( i + 1 ) < pasted.size() ) && ( pasted[i + 1] == '\n' ) ) {
+				++ i;
+			}
+			c = '\n';
+		} else if ( c == '\t' ) {
+			c = ' ';
+		} else if ( ( c != '\n' ) && isControlChar( c ) ) {
+			continue;
+		}
+		text_.append( &c, 1 );
+	}
+}
+
+/*
+ * Bracketed paste during history search extends search text,
+ * line breaks become spaces.
+ */
+void Replxx::ReplxxImpl::paste_search_text( UnicodeString& searchText_ ) {
+	UnicodeString pasted;
+	read_paste( pasted );
+	for ( char32_t c : pasted ) {
+		if ( c == '\n' ) {
+			c = ' ';
+		}
+		searchText_.append( &c, 1 );
+	}
+}
+
+/*
+ * Insert pasted text up to the next line break with single
+ * width calculation and single refresh, a line break commits
+ * the line just like Enter does and the rest of the paste
+ * waits for the next input line.
+ */
+Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::insert_paste( void ) {
+	_killRing.lastAction = KillRing::actionOther;
+	_history.reset_recall_most_recent();
+	int end( _pastePos );
+	while ( ( end < _paste.length() ) && ( _paste[static_cast<size_t>( end )] != '\n' ) ) {
+		++ end;
+	}
+	int len( end - _pastePos );
+	_data.insert( _pos, _paste, _pastePos, len );
+	_charWidths.insert( _pos, _data.get() + _pos, len );
+	_pos += len;
+	_prefix = _pos;
+	if ( end < _paste.length() ) {
+		_pastePos = end + 1;
+		if ( _pastePos == _paste.length() ) {
+			_paste.clear();
+			_pastePos = 0;
+		}
+		return ( commit_line( '\n' ) );
+	}
+	_paste.clear();
+	_pastePos = 0;
+	refresh_line();
+	return ( NEXT::CONTINUE );
+}
 #endif
 
 Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::complete_line( int c ) {
 	if ( !! _completionCallback && ( _completeOnEmpty || ( _pos > 0 ) ) ) {
 		_killRing.lastAction = KillRing::actionOther;
 		_history.reset_recall_most_recent();
+		flush_refresh();
 
 		// complete_line does the actual completion and replacement
 		c = do_complete_line();
@@ -1407,14 +1597,17 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::complete_line( int c ) {
 // Alt-N, forward history search for prefix
 Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::common_prefix_search( int startChar ) {
 	_killRing.lastAction = KillRing::actionOther;
+	_utf8Buffer.assign( _data, _prefix );
+	int prefixSize( static_cast<int>( strlen( _utf8Buffer.get() ) ) );
 	_utf8Buffer.assign( _data );
-	int prefixSize( calculateColumnPosition( _data.get(), _prefix ) );
 	if (
 		_history.common_prefix_search(
 			_utf8Buffer.get(), prefixSize, ( startChar == ( META + 'p' ) ) || ( startChar == ( META + 'P' ) )
 		)
 	) {
-		_data.assign( _history.current() );
+		History::Decoded const& decoded( _history.current_decoded() );
+		_data.assign( decoded._text );
+		_charWidths.assign_widths( decoded.widths() );
 		_pos = _data.length();
 		refresh_line();
 	}
@@ -1431,6 +1624,10 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::common_prefix_search( int startChar
  * _direction
  */
 Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int startChar ) {
+	flush_refresh();
+
+	// search positions are history indexes, so take in lazily loaded entries up front
+	_history.absorb_loaded();
 
 	// if not already recalling, add the current line to the history list so we
 	// don't have to special case it
@@ -1440,9 +1637,12 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int sta
 	}
 	int historyLinePosition( _pos );
 	UnicodeString empty;
+	ColumnIndex noWidths;
 	_data.swap( empty );
+	_charWidths.swap( noWidths );
 	refresh_line(); // erase the old input first
 	_data.swap( empty );
+	_charWidths.swap( noWidths );
 
 	DynamicPrompt dp( _terminal, (startChar == ctrlChar('R')) ? -1 : 1 );
 
@@ -1557,6 +1757,13 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int sta
 			case ctrlChar('Y'): // ctrl-Y, yank killed text
 				break;
 
+#ifndef _WIN32
+			case PASTE_START_KEY:
+				paste_search_text( dp._searchText );
+				dp.updateSearchPrompt();
+				break;
+#endif
+
 			default: {
 				if (!isControlChar(c) && c <= 0x0010FFFF) { // not an action character
 					dp._searchText.insert( dp._searchText.length(), c );
@@ -1571,9 +1778,11 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int sta
 		if ( ! keepLooping ) {
 			break;
 		}
-		activeHistoryLine.assign( _history.current() );
+		activeHistoryLine.assign( _history.current_decoded()._text );
 		if ( dp._searchText.length() > 0 ) {
 			bool found = false;
+			Utf8String searchText( dp._searchText );
+			int searchTextLength( static_cast<int>( strlen( searchText.get() ) ) );
 			int historySearchIndex = _history.current_pos();
 			int lineSearchPos = historyLinePosition;
 			if ( searchAgain ) {
@@ -1592,17 +1801,18 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int sta
 					_history.reset_pos( historySearchIndex );
 					historyLinePosition = lineSearchPos;
 					break;
-				} else if ( ( dp._direction > 0 ) ? ( historySearchIndex < _history.size() ) : ( historySearchIndex > 0 ) ) {
-					historySearchIndex += dp._direction;
-					activeHistoryLine.assign( _history[historySearchIndex] );
-					lineSearchPos = ( dp._direction > 0 ) ? 0 : ( activeHistoryLine.length() - dp._searchText.length() );
-				} else {
+				}
+				// only lines that contain the search text are worth decoding
+				historySearchIndex = _history.find( searchText.get(), searchTextLength, historySearchIndex + dp._direction, dp._direction );
+				if ( historySearchIndex < 0 ) {
 					beep();
 					break;
 				}
+				activeHistoryLine.assign( _history.decoded( historySearchIndex )._text );
+				lineSearchPos = ( dp._direction > 0 ) ? 0 : ( activeHistoryLine.length() - dp._searchText.length() );
 			} // while
 		}
-		activeHistoryLine.assign( _history.current() );
+		activeHistoryLine.assign( _history.current_decoded()._text );
 		dynamicRefresh(dp, activeHistoryLine.get(), activeHistoryLine.length(), historyLinePosition); // draw user's text with our prompt
 	} // while
 
@@ -1623,7 +1833,9 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int sta
 	if ( useSearchedLine && ( activeHistoryLine.length() > 0 ) ) {
 		_history.set_recall_most_recent();
 		_data.assign( activeHistoryLine );
-		_prefix = _pos = historyLinePosition;
+		_charWidths.assign( _data.get(), _data.length() );
+		// search text may have been edited down to nothing on a shorter line
+		_prefix = _pos = min( historyLinePosition, _data.length() );
 	}
 	dynamicRefresh(pb, _data.get(), _data.length(), _pos); // redraw the original prompt with current input
 	_prompt._previousInputLen = _data.length();
@@ -1633,8 +1845,128 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::incremental_history_search( int sta
 	return ( NEXT::CONTINUE );
 }
 
+// meta-R, fuzzy history search
+/**
+ * Fuzzy history search -- take over the prompt and keyboard as the user types
+ * a search string, rank the whole history against it and list the best matches
+ * below the prompt.  Up and down arrows choose among the matches, any other
+ * action character accepts the chosen one and is passed on, ctrl-C and ctrl-G cancel.
+ */
+Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::fuzzy_history_search( int ) {
+	flush_refresh();
+	_history.absorb_loaded();
+	if ( _history.is_last() ) {
+		_utf8Buffer.assign( _data );
+		_history.update_last( _utf8Buffer.get() );
+	}
+	UnicodeString empty;
+	ColumnIndex noWidths;
+	_data.swap( empty );
+	_charWidths.swap( noWidths );
+	refresh_line(); // erase the old input first
+	_data.swap( empty );
+	_charWidths.swap( noWidths );
+
+	DynamicPrompt dp( _terminal, 0 );
+	dp._previousLen = _prompt._previousLen;
+	dp._previousInputLen = _prompt._previousInputLen;
+
+	int rows( min( REPLXX_MAX_FUZZY_SEARCH_ROWS, _terminal.get_screen_rows() - 2 ) );
+	FuzzyMatcher::matches_t matches;
+	int selection( 0 );
+	bool searchAgain( true );
+	bool useSearchedLine( true );
+	UnicodeString activeHistoryLine;
+	int c( 0 );
+	while ( true ) {
+		if ( searchAgain ) {
+			Utf8String searchText( dp._searchText );
+			_history.fuzzy_search( searchText.get(), rows, matches );
+			selection = 0;
+			searchAgain = false;
+		}
+		activeHistoryLine.clear();
+		if ( ! matches.empty() ) {
+			activeHistoryLine.assign( _history.decoded( matches[selection]._index )._text );
+		}
+		fuzzyRefresh( dp, activeHistoryLine, matches, selection );
+		c = _terminal.read_char();
+		if ( ( c == ctrlChar( 'C' ) ) || ( c == ctrlChar( 'G' ) ) ) {
+			useSearchedLine = false;
+			c = -1;
+			break;
+		} else if ( c == ctrlChar( 'L' ) ) {
+			useSearchedLine = false;
+			break;
+		} else if ( ( c == DOWN_ARROW_KEY ) || ( c == ctrlChar( 'N' ) ) ) {
+			if ( ( selection + 1 ) < static_cast<int>( matches.size() ) ) {
+				++ selection;
+			} else {
+				beep();
+			}
+		} else if ( ( c == UP_ARROW_KEY ) || ( c == ctrlChar( 'P' ) ) ) {
+			if ( selection > 0 ) {
+				-- selection;
+			} else {
+				beep();
+			}
+		} else if ( ( c == ctrlChar( 'H' ) ) || ( c == 127 ) ) {
+			if ( dp._searchText.length() > 0 ) {
+				dp._searchText.erase( dp._searchText.length() - 1 );
+				dp.updateSearchPrompt();
+				searchAgain = true;
+			} else {
+				beep();
+			}
+#ifndef _WIN32
+		} else if ( c == ctrlChar( 'Z' ) ) {
+			_terminal.disable_raw_mode();
+			raise( SIGSTOP );
+			_terminal.enable_raw_mode();
+		} else if ( c == PASTE_START_KEY ) {
+			paste_search_text( dp._searchText );
+			dp.updateSearchPrompt();
+			searchAgain = true;
+#endif
+		} else if ( ! isControlChar( c ) && ( c <= 0x0010FFFF ) ) {
+			dp._searchText.insert( dp._searchText.length(), c );
+			dp.updateSearchPrompt();
+			searchAgain = true;
+		} else {
+			break;
+		}
+	}
+
+	// leaving fuzzy search, restore previous prompt, maybe make chosen line current
+	Prompt pb( _terminal );
+	pb._characterCount = _prompt._indentation;
+	pb._byteCount = _prompt._byteCount;
+	UnicodeString tempUnicode( &_prompt._text[_prompt._lastLinePosition], pb._byteCount - _prompt._lastLinePosition );
+	pb._text = tempUnicode;
+	pb._extraLines = 0;
+	pb._indentation = _prompt._indentation;
+	pb._lastLinePosition = 0;
+	pb._previousInputLen = activeHistoryLine.length();
+	pb._cursorRowOffset = dp._cursorRowOffset;
+	pb.update_screen_columns();
+	pb._previousLen = dp._characterCount;
+	if ( useSearchedLine && ( activeHistoryLine.length() > 0 ) ) {
+		_history.reset_pos( matches[selection]._index );
+		_history.set_recall_most_recent();
+		_data.assign( activeHistoryLine );
+		_charWidths.assign( _data.get(), _data.length() );
+		_prefix = _pos = _data.length();
+	}
+	dynamicRefresh( pb, _data.get(), _data.length(), _pos ); // redraw the original prompt with current input
+	_prompt._previousInputLen = _data.length();
+	_prompt._cursorRowOffset = _prompt._extraLines + pb._cursorRowOffset;
+	_terminal.emulate_key_press( c ); // pass a character or -1 back to main loop
+	return ( NEXT::CONTINUE );
+}
+
 // ctrl-L, clear screen and redisplay line
 Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::clear_screen( int c ) {
+	_terminal.begin_frame();
 	_terminal.clear_screen( Terminal::CLEAR_SCREEN::WHOLE );
 	if ( c ) {
 		_prompt.write();
@@ -1647,6 +1979,7 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::clear_screen( int c ) {
 		_prompt._cursorRowOffset = _prompt._extraLines;
 		refresh_line();
 	}
+	_terminal.end_frame();
 	return ( NEXT::CONTINUE );
 }
 
@@ -1659,13 +1992,37 @@ bool Replxx::ReplxxImpl::is_word_break_character( char32_t char_ ) const {
 }
 
 void Replxx::ReplxxImpl::history_add( std::string const& line ) {
+	bool repeated( ! _history.is_empty() && ( _history[_history.size() - 1] == line ) );
 	_history.add( line );
+	if ( _historyWriter && ! _history.is_binary() && ! repeated && ! line.empty() ) {
+		_historyWriter->append( line.data(), static_cast<int>( line.length() ) );
+	}
 }
 
+/*
+ * With background saving enabled lines are appended as they are added,
+ * saving to the same file rewrites it with a snapshot of the history
+ * also in the background, the writer gathers the lines.
+ */
 int Replxx::ReplxxImpl::history_save( std::string const& filename ) {
+	if ( _historyWriter && ! _history.is_binary() && ( filename == _historyWriter->filename() ) ) {
+		_historyWriter->rewrite( _history.text_snapshot() );
+		return ( 0 );
+	}
 	return ( _history.save( filename ) );
 }
 
+int Replxx::ReplxxImpl::history_sync( void ) {
+	return ( _historyWriter ? _historyWriter->sync() : 0 );
+}
+
+void Replxx::ReplxxImpl::set_history_async_save( std::string const& filename, int syncInterval ) {
+	_historyWriter.reset();
+	if ( ! filename.empty() ) {
+		_historyWriter.reset( new HistoryWriter( filename, syncInterval ) );
+	}
+}
+
 int Replxx::ReplxxImpl::history_load( std::string const& filename ) {
 	return ( _history.load( filename ) );
 }
@@ -1675,7 +2032,27 @@ int Replxx::ReplxxImpl::history_size() const {
 }
 
 std::string const& Replxx::ReplxxImpl::history_line( int index ) {
-	return ( _history[index] );
+	return ( _history.materialized( index ) );
+}
+
+long long Replxx::ReplxxImpl::history_timestamp( int index ) const {
+	if ( ( index < 0 ) || ( index >= _history.size() ) ) {
+		return ( -1 );
+	}
+	return ( _history.timestamp( index ) );
+}
+
+int Replxx::ReplxxImpl::history_scan( Replxx::history_visitor_t const& visitor, std::string_view prefix, std::string_view substring ) {
+	_history.absorb_loaded( true );
+	return (
+		_history.scan(
+			prefix.data(), static_cast<int>( prefix.length() ),
+			substring.data(), static_cast<int>( substring.length() ),
+			[&visitor]( int index, char const* line, int length ) {
+				return ( visitor( index, std::string_view( line, static_cast<size_t>( length ) ) ) );
+			}
+		)
+	);
 }
 
 void Replxx::ReplxxImpl::set_completion_callback( Replxx::completion_callback_t const& fn ) {
@@ -1694,6 +2071,48 @@ void Replxx::ReplxxImpl::set_max_history_size( int len ) {
 	_history.set_max_size( len );
 }
 
+void Replxx::ReplxxImpl::set_history_append_only( bool val ) {
+	_history.set_append_only( val );
+}
+
+void Replxx::ReplxxImpl::set_history_shared( bool val ) {
+	_history.set_shared( val );
+}
+
+void Replxx::ReplxxImpl::set_unique_history( bool val ) {
+	_history.set_unique( val );
+}
+
+void Replxx::ReplxxImpl::set_history_binary( bool val ) {
+	_history.set_binary( val );
+}
+
+void Replxx::ReplxxImpl::set_history_lazy_load( int lines ) {
+	_history.set_lazy_load( lines );
+}
+
+void Replxx::ReplxxImpl::set_history_frecency( bool val ) {
+	_history.set_frecency( val );
+}
+
+void Replxx::ReplxxImpl::set_history_decode_cache( int bytes ) {
+	_history.set_decoded_cache_budget( bytes );
+}
+
+void Replxx::ReplxxImpl::set_history_search_threads( int threads ) {
+	_history.set_search_threads( threads );
+}
+
+void Replxx::ReplxxImpl::set_history_compression( bool val ) {
+	_history.set_compression( val );
+}
+
+Replxx::hints_t Replxx::ReplxxImpl::history_frecent( std::string const& prefix, int count ) const {
+	Replxx::hints_t lines;
+	_history.frecent( prefix.data(), static_cast<int>( prefix.length() ), count, lines );
+	return ( lines );
+}
+
 void Replxx::ReplxxImpl::set_completion_count_cutoff( int count ) {
 	_completionCountCutoff = count;
 }
@@ -1722,6 +2141,14 @@ void Replxx::ReplxxImpl::set_no_color( bool val ) {
 	_noColor = val;
 }
 
+void Replxx::ReplxxImpl::set_input_coalescing( int maxLatency ) {
+	_coalesceLatency = maxLatency;
+}
+
+void Replxx::ReplxxImpl::set_differential_rendering( bool val ) {
+	_differentialRendering = val;
+}
+
 /**
  * Display the dynamic incremental search prompt and the current user input
  * line.
@@ -1754,6 +2181,7 @@ void Replxx::ReplxxImpl::dynamicRefresh(Prompt& pi, char32_t* buf32, int len, in
 		yCursorPos
 	);
 
+	_terminal.begin_frame();
 #ifdef _WIN32
 	// position at the start of the prompt, clear to end of previous input
 	_terminal.jump_cursor(
@@ -1807,9 +2235,60 @@ void Replxx::ReplxxImpl::dynamicRefresh(Prompt& pi, char32_t* buf32, int len, in
 	snprintf(seq, sizeof seq, "\x1b[%dG", xCursorPos + 1); // 1-based on VT100
 	_terminal.write8( seq, strlen( seq ) );
 #endif
+	_terminal.end_frame();
 
 	pi._cursorRowOffset = pi._extraLines + yCursorPos; // remember row for next pass
 }
 
+/**
+ * Display the fuzzy search prompt with chosen entry and list the best
+ * matches below it, the cursor is left at the end of the chosen entry.
+ */
+void Replxx::ReplxxImpl::fuzzyRefresh( DynamicPrompt& dp, UnicodeString& line, FuzzyMatcher::matches_t const& matches, int selection ) {
+	_terminal.begin_frame();
+	dynamicRefresh( dp, line.get(), line.length(), line.length() );
+	int xEndOfPrompt( 0 ), yEndOfPrompt( 0 );
+	calculateScreenPosition( 0, 0, dp.screen_columns(), dp._characterCount, xEndOfPrompt, yEndOfPrompt );
+	int xEndOfInput( 0 ), yEndOfInput( 0 );
+	calculateScreenPosition(
+		xEndOfPrompt, yEndOfPrompt, dp.screen_columns(),
+		calculateColumnPosition( line.get(), line.length() ), xEndOfInput, yEndOfInput
+	);
+#ifdef _WIN32
+	_terminal.clear_screen( Terminal::CLEAR_SCREEN::TO_END );
+#endif
+	int maxCol( dp.screen_columns() - 1 );
+	UnicodeString row;
+	for ( int i( 0 ); i < static_cast<int>( matches.size() ); ++ i ) {
+		row.assign( i == selection ? "\n> " : "\n  " );
+		UnicodeString const& entry( _history.decoded( matches[i]._index )._text );
+		/* rows must not wrap, the cursor goes back up by their count */
+		int width( 2 );
+		for ( char32_t ch : entry ) {
+			if ( isControlChar( ch ) ) {
+				ch = ' ';
+			}
+			int charWidth( mk_wcwidth( ch ) );
+			if ( ( width + charWidth ) > maxCol ) {
+				break;
+			}
+			row.append( &ch, 1 );
+			width += charWidth;
+		}
+		_terminal.write32( row.get(), row.length() );
+	}
+	int rows( static_cast<int>( matches.size() ) );
+	if ( rows > 0 ) {
+#ifdef _WIN32
+		_terminal.jump_cursor( xEndOfInput, -rows );
+#else
+		char seq[64];
+		snprintf( seq, sizeof seq, "\x1b[%dA\x1b[%dG", rows, xEndOfInput + 1 ); // 1-based on VT100
+		_terminal.write8( seq, strlen( seq ) );
+#endif
+	}
+	_terminal.end_frame();
+}
+
 }
 
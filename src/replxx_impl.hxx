@@ -33,15 +33,19 @@
 
 #include <vector>
 #include <memory>
+#include <chrono>
 #include <string>
 #include <unordered_map>
 
 #include "replxx.hxx"
 #include "history.hxx"
+#include "historywriter.hxx"
 #include "killring.hxx"
 #include "utf8string.hxx"
 #include "prompt.hxx"
 #include "io.hxx"
+#include "columnindex.hxx"
+#include "virtualscreen.hxx"
 
 namespace replxx {
 
@@ -51,8 +55,7 @@ public:
 	typedef std::vector<UnicodeString> hints_t;
 	typedef std::unique_ptr<char[]> utf8_buffer_t;
 	typedef std::unique_ptr<char32_t[]> input_buffer_t;
-	typedef std::vector<char> char_widths_t;
-	typedef std::vector<char32_t> display_t;
+	typedef std::string display_t;
 	enum class HINT_ACTION {
 		REGENERATE,
 		REPAINT,
@@ -68,13 +71,14 @@ public:
 private:
 	Utf8String     _utf8Buffer;
 	UnicodeString  _data;
-	char_widths_t  _charWidths; // character widths from mk_wcwidth()
-	display_t      _display;
+	ColumnIndex    _charWidths; // character widths of _data and their prefix sums
+	display_t      _display;    // input line as sent to terminal, color codes and UTF-8 text
 	UnicodeString  _hint;
 	int _pos;    // character position in buffer ( 0 <= _pos <= _len )
 	int _prefix; // prefix length used in common prefix search
 	int _hintSelection; // Currently selected hint.
 	History _history;
+	std::unique_ptr<HistoryWriter> _historyWriter; // background saving, if enabled
 	KillRing _killRing;
 	int _maxHintRows;
 	char const* _breakChars;
@@ -83,13 +87,22 @@ private:
 	bool _completeOnEmpty;
 	bool _beepOnAmbiguousCompletion;
 	bool _noColor;
+	int _coalesceLatency;   // longest redraw delay in milliseconds, 0 redraws after every key
+	bool _deferRefresh;     // a keystroke is being handled, refresh_line() may be deferred
+	bool _refreshPending;   // screen lags behind the buffer
+	HINT_ACTION _pendingHintAction;
+	std::chrono::steady_clock::time_point _batchStart; // first deferred refresh of the batch
+	bool _differentialRendering; // redraw only what changed since the last refresh_line()
 	key_press_handlers_t _keyPressHandlers;
 	Terminal _terminal;
 	Prompt _prompt;
+	VirtualScreen _screen;
 	Replxx::completion_callback_t _completionCallback;
 	Replxx::highlighter_callback_t _highlighterCallback;
 	Replxx::hint_callback_t _hintCallback;
 	std::string _preloadedBuffer; // used with set_preload_buffer
+	UnicodeString _paste; // bracketed paste lines not inserted yet
+	int _pastePos;        // start of not inserted part of _paste
 	std::string _errorMessage;
 public:
 	ReplxxImpl( FILE*, FILE*, FILE* );
@@ -100,7 +113,11 @@ public:
 	void history_add( std::string const& line );
 	int history_save( std::string const& filename );
 	int history_load( std::string const& filename );
+	int history_sync( void );
+	void set_history_async_save( std::string const& filename, int syncInterval );
 	std::string const& history_line( int index );
+	long long history_timestamp( int index ) const;
+	int history_scan( Replxx::history_visitor_t const& visitor, std::string_view prefix, std::string_view substring );
 	int history_size() const;
 	void set_preload_buffer(std::string const& preloadText);
 	void set_word_break_characters( char const* wordBreakers );
@@ -109,7 +126,19 @@ public:
 	void set_complete_on_empty( bool val );
 	void set_beep_on_ambiguous_completion( bool val );
 	void set_no_color( bool val );
+	void set_input_coalescing( int maxLatency );
+	void set_differential_rendering( bool val );
 	void set_max_history_size( int len );
+	void set_history_append_only( bool val );
+	void set_history_shared( bool val );
+	void set_unique_history( bool val );
+	void set_history_binary( bool val );
+	void set_history_lazy_load( int lines );
+	void set_history_frecency( bool val );
+	void set_history_decode_cache( int bytes );
+	void set_history_search_threads( int threads );
+	void set_history_compression( bool val );
+	Replxx::hints_t history_frecent( std::string const& prefix, int count ) const;
 	void set_completion_count_cutoff( int len );
 	int install_window_change_handler( void );
 	completions_t call_completer( std::string const& input, int& ) const;
@@ -157,13 +186,20 @@ private:
 	NEXT hint_move( bool, int );
 #ifndef _WIN32
 	NEXT suspend( int );
+	NEXT bracketed_paste( int );
+	NEXT insert_paste( void );
+	void read_paste( UnicodeString& );
+	void paste_search_text( UnicodeString& );
 #endif
 	NEXT complete_line( int );
 	NEXT incremental_history_search( int startChar );
+	NEXT fuzzy_history_search( int );
 	NEXT common_prefix_search( int startChar );
 	char const* read_from_stdin( void );
 	int do_complete_line( void );
 	void refresh_line( HINT_ACTION = HINT_ACTION::REGENERATE );
+	bool defer_refresh( HINT_ACTION );
+	void flush_refresh( void );
 	void highlight( int, bool );
 	int handle_hints( HINT_ACTION );
 	void setColor( Replxx::Color );
@@ -171,6 +207,7 @@ private:
 	void clear();
 	bool is_word_break_character( char32_t ) const;
 	void dynamicRefresh(Prompt& pi, char32_t* buf32, int len, int pos);
+	void fuzzyRefresh( DynamicPrompt&, UnicodeString&, FuzzyMatcher::matches_t const&, int );
 };
 
 }
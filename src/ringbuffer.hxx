@@ -0,0 +1,292 @@
+#ifndef REPLXX_RINGBUFFER_HXX_INCLUDED
+#define REPLXX_RINGBUFFER_HXX_INCLUDED 1
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+namespace replxx {
+
+/*
+ * Fixed capacity circular buffer indexed from the oldest element (0)
+ * to the newest one (size() - 1).
+ *
+ * Physical storage grows lazily up to the capacity, once the buffer
+ * is full push_back() overwrites the oldest element in place.
+ *
+ * Elements erased from the middle leave holes behind, indexing skips
+ * them with a binary search over the hole positions.  Holes are squeezed
+ * out in a single pass once there are capacity / 32 of them, which keeps
+ * erase() amortized constant time.
+ */
+template<typename T>
+class RingBuffer {
+public:
+	typedef std::vector<T> data_t;
+	class const_iterator {
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef int difference_type;
+		typedef T const* pointer;
+		typedef T const& reference;
+	private:
+		RingBuffer const* _owner;
+		int _index;
+		int _pos;  // position counting holes
+		int _hole; // first hole past _pos
+	public:
+		const_iterator( RingBuffer const* owner_, int index_ )
+			: _owner( owner_ )
+			, _index( index_ )
+			, _pos( owner_->position( index_ ) )
+			, _hole( _pos - index_ ) {
+		}
+		T const& operator * ( void ) const {
+			return ( _owner->_data[_owner->physical( _pos )] );
+		}
+		T const* operator -> ( void ) const {
+			return ( &_owner->_data[_owner->physical( _pos )] );
+		}
+		const_iterator& operator ++ ( void ) {
+			++ _index;
+			++ _pos;
+			holes_t const& holes( _owner->_holes );
+			while ( ( _hole < static_cast<int>( holes.size() ) ) && ( ( holes[_hole] - _owner->_base ) == _pos ) ) {
+				++ _pos;
+				++ _hole;
+			}
+			return ( *this );
+		}
+		const_iterator& operator -- ( void ) {
+			*this = const_iterator( _owner, _index - 1 );
+			return ( *this );
+		}
+		const_iterator& operator += ( int n_ ) {
+			*this = const_iterator( _owner, _index + n_ );
+			return ( *this );
+		}
+		const_iterator operator + ( int n_ ) const {
+			return ( const_iterator( _owner, _index + n_ ) );
+		}
+		int operator - ( const_iterator const& other_ ) const {
+			return ( _index - other_._index );
+		}
+		bool operator == ( const_iterator const& other_ ) const {
+			return ( _index == other_._index );
+		}
+		bool operator != ( const_iterator const& other_ ) const {
+			return ( _index != other_._index );
+		}
+	};
+private:
+	typedef std::vector<long long> holes_t;
+	data_t _data;      // physical storage
+	int _capacity;
+	int _head;         // physical index of the oldest element
+	int _size;
+	int _span;         // elements and holes between them
+	long long _base;   // running number of the oldest element
+	holes_t _holes;    // running numbers of holes, ascending
+public:
+	explicit RingBuffer( int capacity_ = 0 )
+		: _data()
+		, _capacity( capacity_ )
+		, _head( 0 )
+		, _size( 0 )
+		, _span( 0 )
+		, _base( 0 )
+		, _holes() {
+	}
+	int size( void ) const {
+		return ( _size );
+	}
+	int capacity( void ) const {
+		return ( _capacity );
+	}
+	bool empty( void ) const {
+		return ( _size == 0 );
+	}
+	bool full( void ) const {
+		return ( _size == _capacity );
+	}
+	T const& operator[] ( int idx_ ) const {
+		return ( _data[physical( position( idx_ ) )] );
+	}
+	T& operator[] ( int idx_ ) {
+		return ( _data[physical( position( idx_ ) )] );
+	}
+	T const& front( void ) const {
+		return ( _data[_head] );
+	}
+	T const& back( void ) const {
+		return ( _data[physical( _span - 1 )] );
+	}
+	T& back( void ) {
+		return ( _data[physical( _span - 1 )] );
+	}
+	/*! \brief Append an element, evicting the oldest one if the buffer is full.
+	 */
+	void push_back( T const& val_ ) {
+		T tmp( val_ );
+		push_back( std::move( tmp ) );
+	}
+	void push_back( T&& val_ ) {
+		if ( _capacity <= 0 ) {
+			return;
+		}
+		if ( _size == _capacity ) {
+			erase_front( 1 );
+		}
+		if ( _span == static_cast<int>( _data.size() ) ) {
+			if ( _holes.empty() || ( static_cast<int>( _data.size() ) < ( _capacity + max_holes() ) ) ) {
+				linearize();
+				_data.push_back( std::move( val_ ) );
+				++ _span;
+				++ _size;
+				return;
+			}
+			compact();
+		}
+		_data[physical( _span )] = std::move( val_ );
+		++ _span;
+		++ _size;
+	}
+	void pop_back( void ) {
+		-- _size;
+		-- _span;
+		_data[physical( _span )] = T();
+		while ( ! _holes.empty() && ( _holes.back() == ( _base + _span - 1 ) ) ) {
+			_holes.pop_back();
+			-- _span;
+		}
+	}
+	/*! \brief Remove \e count_ oldest elements.
+	 */
+	void erase_front( int count_ ) {
+		for ( int i( 0 ); i < count_; ++ i ) {
+			_data[_head] = T();
+			advance();
+			-- _size;
+			while ( ! _holes.empty() && ( _holes.front() == _base ) ) {
+				_holes.erase( _holes.begin() );
+				advance();
+			}
+		}
+	}
+	/*! \brief Remove element at given position.
+	 */
+	void erase( int idx_ ) {
+		if ( idx_ == 0 ) {
+			erase_front( 1 );
+			return;
+		}
+		if ( idx_ == ( _size - 1 ) ) {
+			pop_back();
+			return;
+		}
+		int pos( position( idx_ ) );
+		_data[physical( pos )] = T();
+		_holes.insert( std::upper_bound( _holes.begin(), _holes.end(), _base + pos ), _base + pos );
+		-- _size;
+		if ( static_cast<int>( _holes.size() ) >= max_holes() ) {
+			compact();
+		}
+	}
+	/*! \brief Change capacity keeping the newest elements.
+	 */
+	void set_capacity( int capacity_ ) {
+		compact();
+		if ( _size > capacity_ ) {
+			_data.erase( _data.begin(), _data.begin() + ( _size - capacity_ ) );
+			_size = capacity_;
+			_span = capacity_;
+		}
+		if ( static_cast<int>( _data.size() ) > _size ) {
+			_data.resize( _size );
+		}
+		_capacity = capacity_;
+	}
+	void clear( void ) {
+		_data.clear();
+		_head = 0;
+		_size = 0;
+		_span = 0;
+		_base = 0;
+		_holes.clear();
+	}
+	const_iterator begin( void ) const {
+		return ( const_iterator( this, 0 ) );
+	}
+	const_iterator end( void ) const {
+		return ( const_iterator( this, _size ) );
+	}
+private:
+	int max_holes( void ) const {
+		return ( std::max( 16, _capacity / 32 ) );
+	}
+	/*
+	 * Position (counting holes) of the element with given index,
+	 * there are _holes[m] - _base - m elements in front of hole m.
+	 */
+	int position( int idx_ ) const {
+		if ( _holes.empty() ) {
+			return ( idx_ );
+		}
+		int lo( 0 );
+		int hi( static_cast<int>( _holes.size() ) );
+		while ( lo < hi ) {
+			int mid( lo + ( hi - lo ) / 2 );
+			if ( ( _holes[mid] - _base - mid ) <= idx_ ) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		return ( idx_ + lo );
+	}
+	int physical( int pos_ ) const {
+		int p( _head + pos_ );
+		int n( static_cast<int>( _data.size() ) );
+		return ( p >= n ? p - n : p );
+	}
+	void advance( void ) {
+		if ( ++ _head == static_cast<int>( _data.size() ) ) {
+			_head = 0;
+		}
+		++ _base;
+		-- _span;
+	}
+	void linearize( void ) {
+		if ( _head != 0 ) {
+			std::rotate( _data.begin(), _data.begin() + _head, _data.end() );
+			_head = 0;
+		}
+	}
+	/*
+	 * Squeeze the holes out moving whole runs of elements between them.
+	 */
+	void compact( void ) {
+		linearize();
+		if ( _holes.empty() ) {
+			return;
+		}
+		typename data_t::iterator data( _data.begin() );
+		int to( 0 );
+		int from( 0 );
+		for ( long long hole : _holes ) {
+			int pos( static_cast<int>( hole - _base ) );
+			std::move( data + from, data + pos, data + to );
+			to += pos - from;
+			from = pos + 1;
+		}
+		std::move( data + from, data + _span, data + to );
+		std::fill( data + _size, data + _span, T() );
+		_span = _size;
+		_holes.clear();
+	}
+};
+
+}
+
+#endif
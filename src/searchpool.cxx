@@ -0,0 +1,113 @@
+#include "searchpool.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+SearchPool::SearchPool( int threads_ )
+	: _threads( threads_ > 1 ? threads_ : 1 )
+	, _workers()
+	, _mutex()
+	, _wakeUp()
+	, _finished()
+	, _match( nullptr )
+	, _count( 0 )
+	, _shards( 0 )
+	, _nextShard( 0 )
+	, _bestShard( 0 )
+	, _found()
+	, _job( 0 )
+	, _busy( 0 )
+	, _stop( false ) {
+}
+
+SearchPool::~SearchPool( void ) {
+	{
+		unique_lock<mutex> l( _mutex );
+		_stop = true;
+	}
+	_wakeUp.notify_all();
+	for ( thread& w : _workers ) {
+		w.join();
+	}
+}
+
+int SearchPool::nearest( int count_, match_t const& match_ ) {
+	if ( count_ <= 0 ) {
+		return ( -1 );
+	}
+	while ( static_cast<int>( _workers.size() ) < ( _threads - 1 ) ) {
+		_workers.emplace_back( &SearchPool::run, this );
+	}
+	{
+		unique_lock<mutex> l( _mutex );
+		_match = &match_;
+		_count = count_;
+		_shards = ( count_ + SHARD_SIZE - 1 ) / SHARD_SIZE;
+		_found.assign( static_cast<size_t>( _shards ), -1 );
+		_nextShard = 0;
+		_bestShard = _shards;
+		_busy = static_cast<int>( _workers.size() );
+		++ _job;
+	}
+	_wakeUp.notify_all();
+	work();
+	unique_lock<mutex> l( _mutex );
+	while ( _busy > 0 ) {
+		_finished.wait( l );
+	}
+	_match = nullptr;
+	int best( _bestShard.load() );
+	return ( best < _shards ? _found[static_cast<size_t>( best )] : -1 );
+}
+
+void SearchPool::run( void ) {
+	int job( 0 );
+	while ( true ) {
+		{
+			unique_lock<mutex> l( _mutex );
+			while ( ! _stop && ( _job == job ) ) {
+				_wakeUp.wait( l );
+			}
+			if ( _stop ) {
+				return;
+			}
+			job = _job;
+		}
+		work();
+		{
+			unique_lock<mutex> l( _mutex );
+			-- _busy;
+		}
+		_finished.notify_one();
+	}
+}
+
+/*
+ * A shard is abandoned as soon as a nearer one has a match,
+ * which is checked every few hundred positions.
+ */
+void SearchPool::work( void ) {
+	int const checkInterval( 256 );
+	while ( true ) {
+		int shard( _nextShard.fetch_add( 1 ) );
+		if ( ( shard >= _shards ) || ( shard > _bestShard.load( memory_order_relaxed ) ) ) {
+			return;
+		}
+		int end( min( _count, ( shard + 1 ) * SHARD_SIZE ) );
+		for ( int pos( shard * SHARD_SIZE ); pos < end; ++ pos ) {
+			if ( ( ( pos % checkInterval ) == 0 ) && ( _bestShard.load( memory_order_relaxed ) < shard ) ) {
+				break;
+			}
+			if ( ( *_match )( pos ) ) {
+				_found[static_cast<size_t>( shard )] = pos;
+				int best( _bestShard.load() );
+				while ( ( shard < best ) && ! _bestShard.compare_exchange_weak( best, shard ) ) {
+				}
+				break;
+			}
+		}
+	}
+}
+
+}
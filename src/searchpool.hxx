@@ -0,0 +1,67 @@
+#ifndef REPLXX_SEARCHPOOL_HXX_INCLUDED
+#define REPLXX_SEARCHPOOL_HXX_INCLUDED 1
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace replxx {
+
+/*
+ * Small thread pool finding the nearest match in a sequence.
+ *
+ * The sequence is cut into shards handed out to threads in order of
+ * distance from its start.  Once a shard has a match, shards farther
+ * away are skipped or abandoned, while nearer ones are still scanned
+ * to the end, so the result is always what a sequential scan would find.
+ */
+class SearchPool {
+public:
+	typedef std::function<bool ( int )> match_t;
+	static int const SHARD_SIZE = 8192;
+private:
+	int _threads;
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _wakeUp;   // new job or stop request
+	std::condition_variable _finished; // all workers left the job
+	match_t const* _match;
+	int _count;
+	int _shards;
+	std::atomic<int> _nextShard;
+	std::atomic<int> _bestShard;       // nearest shard with a match so far
+	std::vector<int> _found;           // first match in every shard
+	int _job;
+	int _busy;
+	bool _stop;
+public:
+	/*! \brief Create pool of given size.
+	 *
+	 * The thread calling nearest() takes part in the search, so \e threads_ - 1
+	 * worker threads are started, lazily on the first search.
+	 */
+	explicit SearchPool( int threads_ );
+	~SearchPool( void );
+	/*! \brief Find nearest position satisfying predicate.
+	 *
+	 * \param count_ - length of the sequence.
+	 * \param match_ - predicate called with positions in [0, count_), concurrently.
+	 * \return Lowest position \e match_ accepts or -1 if there is none.
+	 */
+	int nearest( int count_, match_t const& match_ );
+	int threads( void ) const {
+		return ( _threads );
+	}
+private:
+	void run( void );
+	void work( void );
+	SearchPool( SearchPool const& ) = delete;
+	SearchPool& operator = ( SearchPool const& ) = delete;
+};
+
+}
+
+#endif
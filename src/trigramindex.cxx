@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "trigramindex.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+TrigramIndex::TrigramIndex( void )
+	: _index()
+	, _postings( 0 )
+	, _grams() {
+}
+
+void TrigramIndex::grams( char const* data_, int length_ ) {
+	_grams.clear();
+	unsigned char const* p( reinterpret_cast<unsigned char const*>( data_ ) );
+	for ( int i( 0 ); i <= ( length_ - GRAM_SIZE ); ++ i ) {
+		_grams.push_back( ( static_cast<unsigned int>( p[i] ) << 16 ) | ( static_cast<unsigned int>( p[i + 1] ) << 8 ) | p[i + 2] );
+	}
+	sort( _grams.begin(), _grams.end() );
+	_grams.erase( unique( _grams.begin(), _grams.end() ), _grams.end() );
+}
+
+void TrigramIndex::add( serial_t serial_, char const* data_, int length_ ) {
+	grams( data_, length_ );
+	for ( unsigned int g : _grams ) {
+		_index[g].push_back( serial_ );
+	}
+	_postings += static_cast<long long>( _grams.size() );
+}
+
+void TrigramIndex::remove_last( serial_t serial_, char const* data_, int length_ ) {
+	grams( data_, length_ );
+	for ( unsigned int g : _grams ) {
+		index_t::iterator it( _index.find( g ) );
+		if ( ( it == _index.end() ) || it->second.empty() || ( it->second.back() != serial_ ) ) {
+			continue;
+		}
+		it->second.pop_back();
+		-- _postings;
+		if ( it->second.empty() ) {
+			_index.erase( it );
+		}
+	}
+}
+
+void TrigramIndex::compact( serial_t firstLive_ ) {
+	for ( index_t::iterator it( _index.begin() ); it != _index.end(); ) {
+		postings_t& p( it->second );
+		postings_t::iterator live( lower_bound( p.begin(), p.end(), firstLive_ ) );
+		_postings -= static_cast<long long>( live - p.begin() );
+		p.erase( p.begin(), live );
+		if ( p.empty() ) {
+			it = _index.erase( it );
+		} else {
+			p.shrink_to_fit();
+			++ it;
+		}
+	}
+}
+
+bool TrigramIndex::find( char const* text_, int length_, serial_t from_, int direction_, accept_t const& accept_, serial_t& found_ ) {
+	grams( text_, length_ );
+	std::vector<postings_t const*> lists;
+	for ( unsigned int g : _grams ) {
+		index_t::const_iterator it( _index.find( g ) );
+		if ( it == _index.end() ) {
+			return ( false );
+		}
+		lists.push_back( &it->second );
+	}
+	if ( lists.empty() ) {
+		return ( false );
+	}
+	sort(
+		lists.begin(), lists.end(),
+		[]( postings_t const* l_, postings_t const* r_ ) {
+			return ( l_->size() < r_->size() );
+		}
+	);
+	postings_t const& rarest( *lists.front() );
+	auto in_all = [&lists]( serial_t serial_ ) {
+		for ( size_t i( 1 ); i < lists.size(); ++ i ) {
+			if ( ! binary_search( lists[i]->begin(), lists[i]->end(), serial_ ) ) {
+				return ( false );
+			}
+		}
+		return ( true );
+	};
+	if ( direction_ > 0 ) {
+		for ( postings_t::const_iterator it( lower_bound( rarest.begin(), rarest.end(), from_ ) ); it != rarest.end(); ++ it ) {
+			if ( in_all( *it ) && accept_( *it ) ) {
+				found_ = *it;
+				return ( true );
+			}
+		}
+	} else {
+		for ( postings_t::const_iterator it( upper_bound( rarest.begin(), rarest.end(), from_ ) ); it != rarest.begin(); ) {
+			-- it;
+			if ( in_all( *it ) && accept_( *it ) ) {
+				found_ = *it;
+				return ( true );
+			}
+		}
+	}
+	return ( false );
+}
+
+void TrigramIndex::clear( void ) {
+	_index.clear();
+	_postings = 0;
+}
+
+}
+
@@ -0,0 +1,62 @@
+#ifndef REPLXX_TRIGRAMINDEX_HXX_INCLUDED
+#define REPLXX_TRIGRAMINDEX_HXX_INCLUDED 1
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+namespace replxx {
+
+/*
+ * Substring search index over history lines.
+ *
+ * Every distinct 3 byte sequence of a line maps to a sorted list
+ * of serial numbers of the lines containing it.  Lines are expected
+ * to be added with increasing serial numbers, so maintaining the
+ * index is a matter of appending to (or popping from) the lists.
+ * Only lines present in all lists of the searched text can contain it,
+ * the caller still has to verify the candidates.
+ */
+class TrigramIndex {
+public:
+	typedef unsigned int serial_t;
+	typedef std::function<bool ( serial_t )> accept_t;
+	static int const GRAM_SIZE = 3;
+private:
+	typedef std::vector<serial_t> postings_t;
+	typedef std::unordered_map<unsigned int, postings_t> index_t;
+	index_t _index;
+	long long _postings;
+	std::vector<unsigned int> _grams; // scratch buffer
+public:
+	TrigramIndex( void );
+	void add( serial_t, char const*, int );
+	/*! \brief Forget the most recently added line.
+	 */
+	void remove_last( serial_t, char const*, int );
+	/*! \brief Drop entries of all lines older than \e firstLive_.
+	 */
+	void compact( serial_t firstLive_ );
+	/*! \brief Find nearest candidate line for given text.
+	 *
+	 * Candidates are visited starting at serial \e from_ (inclusive) towards
+	 * newer lines if \e direction_ is positive, towards older ones otherwise,
+	 * until \e accept_ returns true.
+	 *
+	 * \return True iff a candidate was accepted, its serial is stored in \e found_.
+	 */
+	bool find( char const* text_, int length_, serial_t from_, int direction_, accept_t const& accept_, serial_t& found_ );
+	long long postings( void ) const {
+		return ( _postings );
+	}
+	void clear( void );
+private:
+	void grams( char const*, int );
+	TrigramIndex( TrigramIndex const& ) = delete;
+	TrigramIndex& operator = ( TrigramIndex const& ) = delete;
+};
+
+}
+
+#endif
+
@@ -31,21 +31,6 @@ int cleanupCtrl(int c) {
 	return c;
 }
 
-/**
- * Recompute widths of all characters in a char32_t buffer
- * @param text					input buffer of Unicode characters
- * @param widths				output buffer of character widths
- * @param charCount		 number of characters in buffer
- */
-int mk_wcwidth(char32_t ucs);
-
-void recomputeCharacterWidths(const char32_t* text, char* widths,
-																		 int charCount) {
-	for (int i = 0; i < charCount; ++i) {
-		widths[i] = mk_wcwidth(text[i]);
-	}
-}
-
 /**
  * Calculate a new screen position given a starting position, screen width and
  * character count
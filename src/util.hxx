@@ -11,7 +11,6 @@ inline bool isControlChar(char32_t testChar) {
 }
 int cleanupCtrl(int c);
 
-void recomputeCharacterWidths( char32_t const* text, char* widths, int charCount );
 void calculateScreenPosition( int x, int y, int screenColumns, int charCount, int& xOut, int& yOut );
 int calculateColumnPosition( char32_t* buf32, int len );
 char const* ansi_color( Replxx::Color );
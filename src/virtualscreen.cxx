@@ -0,0 +1,274 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "virtualscreen.hxx"
+#include "conversion.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+int mk_wcwidth( char32_t );
+
+namespace {
+
+/* Right half of a wide character, also stands for prompt columns. */
+VirtualScreen::Cell const BLANK_CELL = { 0, 0, 0 };
+
+/* Decode next character of text made by appendString32to8(). */
+char32_t next_character( char const*& it_, char const* end_ ) {
+	char32_t c( static_cast<unsigned char>( *it_ ) );
+	++ it_;
+	if ( ( c < 0x80 ) || locale::is8BitEncoding ) {
+		return ( c );
+	}
+	int following( c >= 0xF0 ? 3 : ( c >= 0xE0 ? 2 : 1 ) );
+	c &= ( 0x3F >> following );
+	for ( ; ( following > 0 ) && ( it_ != end_ ); -- following, ++ it_ ) {
+		c = ( c << 6 ) | ( static_cast<unsigned char>( *it_ ) & 0x3F );
+	}
+	return ( c );
+}
+
+}
+
+VirtualScreen::VirtualScreen( Terminal& terminal_ )
+	: _terminal( terminal_ )
+	, _rows()
+	, _next()
+	, _attributes( 1, "\033[0m" )
+	, _indentation( 0 )
+	, _columns( 0 )
+	, _nextIndentation( 0 )
+	, _nextColumns( 0 )
+	, _cursorRow( 0 )
+	, _cursorColumn( 0 )
+	, _rowsReached( 0 )
+	, _generation( 0 )
+	, _valid( false )
+	, _row( 0 )
+	, _column( 0 )
+	, _pendingWrap( false )
+	, _attribute( 0 ) {
+}
+
+int VirtualScreen::attribute( char const* code_, int size_ ) {
+	for ( int i( 0 ); i < static_cast<int>( _attributes.size() ); ++ i ) {
+		if ( _attributes[static_cast<size_t>( i )].compare( 0, string::npos, code_, static_cast<size_t>( size_ ) ) == 0 ) {
+			return ( i );
+		}
+	}
+	_attributes.emplace_back( code_, static_cast<size_t>( size_ ) );
+	return ( static_cast<int>( _attributes.size() ) - 1 );
+}
+
+bool VirtualScreen::layout( char const* display_, int size_, bool newline_, int indentation_, int columns_, int maxRows_ ) {
+	_next.clear();
+	_next.emplace_back( static_cast<size_t>( indentation_ ), BLANK_CELL );
+	_nextIndentation = indentation_;
+	_nextColumns = columns_;
+	int attr( 0 );
+	bool pendingWrap( false );
+	char const* end( display_ + size_ );
+	/* the trailing line break goes through the same path as the ones in hints */
+	for ( char const* it( display_ ); ( it != end ) || newline_; ) {
+		if ( it == end ) {
+			newline_ = false;
+		}
+		char32_t c( it != end ? next_character( it, end ) : '\n' );
+		if ( c == '\033' ) {
+			char const* codeEnd( static_cast<char const*>( memchr( it, 'm', static_cast<size_t>( end - it ) ) ) );
+			if ( ! codeEnd ) {
+				return ( false );
+			}
+			attr = attribute( it - 1, static_cast<int>( codeEnd - it ) + 2 );
+			it = codeEnd + 1;
+			continue;
+		}
+		if ( c == '\n' ) {
+			_next.emplace_back();
+			pendingWrap = false;
+			continue;
+		}
+		int width( mk_wcwidth( c ) );
+		if ( ( width < 1 ) || ( width > 2 ) ) {
+			return ( false );
+		}
+		if ( pendingWrap ) {
+			_next.emplace_back();
+			pendingWrap = false;
+		}
+		row_t& row( _next.back() );
+		if ( static_cast<int>( row.size() ) + width > columns_ ) {
+			return ( false );
+		}
+		Cell cell = { c, width, attr };
+		row.push_back( cell );
+		if ( width == 2 ) {
+			Cell rightHalf = { 0, 0, attr };
+			row.push_back( rightHalf );
+		}
+		pendingWrap = static_cast<int>( row.size() ) == columns_;
+	}
+	return ( static_cast<int>( _next.size() ) <= maxRows_ );
+}
+
+bool VirtualScreen::is_current( int indentation_, int columns_, int cursorRow_ ) const {
+	return (
+		_valid
+		&& ( _generation == _terminal.generation() )
+		&& ( indentation_ == _indentation )
+		&& ( columns_ == _columns )
+		&& ( cursorRow_ == _cursorRow )
+	);
+}
+
+void VirtualScreen::emit( char const* seq_ ) {
+	_terminal.write8( seq_, static_cast<int>( strlen( seq_ ) ) );
+}
+
+void VirtualScreen::set_attribute( int attribute_ ) {
+	if ( attribute_ != _attribute ) {
+		string const& code( _attributes[static_cast<size_t>( attribute_ )] );
+		_terminal.write8( code.data(), static_cast<int>( code.length() ) );
+		_attribute = attribute_;
+	}
+}
+
+/*
+ * Rows the cursor has been on are known to exist and are reached
+ * with a cursor down, new ones are made with line breaks, which
+ * scroll the screen when needed.
+ */
+void VirtualScreen::move_to( int row_, int column_ ) {
+	char seq[32];
+	if ( _pendingWrap ) {
+		_pendingWrap = false;
+		if ( ( row_ == ( _row + 1 ) ) && ( column_ == 0 ) ) {
+			emit( "\n" );
+			++ _row;
+			_column = 0;
+			_rowsReached = max( _rowsReached, _row + 1 );
+			return;
+		}
+		/* the terminal still has to be told to leave the last column */
+		_column = -1;
+	}
+	if ( row_ < _row ) {
+		snprintf( seq, sizeof ( seq ), "\033[%dA", _row - row_ );
+		emit( seq );
+		_row = row_;
+	} else if ( row_ > _row ) {
+		int existing( min( row_, _rowsReached - 1 ) );
+		if ( existing > _row ) {
+			snprintf( seq, sizeof ( seq ), "\033[%dB", existing - _row );
+			emit( seq );
+			_row = existing;
+		}
+		while ( _row < row_ ) {
+			emit( "\n" );
+			++ _row;
+			_column = 0;
+		}
+		_rowsReached = max( _rowsReached, _row + 1 );
+	}
+	if ( column_ != _column ) {
+		snprintf( seq, sizeof ( seq ), "\033[%dG", column_ + 1 ); // 1-based on VT100
+		emit( seq );
+		_column = column_;
+	}
+}
+
+void VirtualScreen::put( Cell const& cell_ ) {
+	if ( _pendingWrap ) {
+		++ _row;
+		_column = 0;
+		_pendingWrap = false;
+		_rowsReached = max( _rowsReached, _row + 1 );
+	}
+	set_attribute( cell_._attribute );
+	_terminal.write32( &cell_._char, 1 );
+	_column += cell_._width;
+	if ( _column == _columns ) {
+		_column = _columns - 1;
+		_pendingWrap = true;
+	}
+}
+
+void VirtualScreen::update( int cursorRow_, int cursorColumn_ ) {
+	_row = _cursorRow;
+	_column = _cursorColumn;
+	_pendingWrap = false;
+	_attribute = 0;
+	for ( int r( 0 ); r < static_cast<int>( _next.size() ); ++ r ) {
+		row_t const& n( _next[static_cast<size_t>( r )] );
+		row_t const* o( r < static_cast<int>( _rows.size() ) ? &_rows[static_cast<size_t>( r )] : nullptr );
+		int newSize( static_cast<int>( n.size() ) );
+		int oldSize( o ? static_cast<int>( o->size() ) : 0 );
+		int from( 0 );
+		while ( ( from < min( newSize, oldSize ) ) && ( n[static_cast<size_t>( from )] == ( *o )[static_cast<size_t>( from )] ) ) {
+			++ from;
+		}
+		if ( ( from == newSize ) && ( newSize == oldSize ) ) {
+			continue;
+		}
+		/* never start in the middle of a wide character */
+		while (
+			( from > 0 ) && ( ( r > 0 ) || ( from > _indentation ) )
+			&& (
+				( ( from < newSize ) && ( n[static_cast<size_t>( from )]._width == 0 ) )
+				|| ( ( from < oldSize ) && ( ( *o )[static_cast<size_t>( from )]._width == 0 ) )
+			)
+		) {
+			-- from;
+		}
+		int to( newSize );
+		if ( newSize == oldSize ) {
+			while ( ( to > from ) && ( n[static_cast<size_t>( to - 1 )] == ( *o )[static_cast<size_t>( to - 1 )] ) ) {
+				-- to;
+			}
+			if ( ( to < newSize ) && ( n[static_cast<size_t>( to )]._width == 0 ) ) {
+				++ to;
+			}
+		}
+		if ( from < to ) {
+			move_to( r, from );
+			for ( int i( from ); i < to; ++ i ) {
+				if ( n[static_cast<size_t>( i )]._width > 0 ) {
+					put( n[static_cast<size_t>( i )] );
+				}
+			}
+		}
+		if ( newSize < oldSize ) {
+			/* erasing fills with current background color */
+			set_attribute( 0 );
+			move_to( r, newSize );
+			emit( "\033[K" );
+		}
+	}
+	set_attribute( 0 );
+	if ( _rows.size() > _next.size() ) {
+		move_to( static_cast<int>( _next.size() ), 0 );
+		emit( "\033[J" );
+	}
+	move_to( cursorRow_, cursorColumn_ );
+	_rows.swap( _next );
+	_cursorRow = cursorRow_;
+	_cursorColumn = cursorColumn_;
+	_generation = _terminal.generation();
+}
+
+void VirtualScreen::commit( int cursorRow_, int cursorColumn_ ) {
+	_rows.swap( _next );
+	_indentation = _nextIndentation;
+	_columns = _nextColumns;
+	_cursorRow = cursorRow_;
+	_cursorColumn = cursorColumn_;
+	_rowsReached = static_cast<int>( _rows.size() );
+	_generation = _terminal.generation();
+	_valid = true;
+}
+
+}
+
@@ -0,0 +1,102 @@
+#ifndef REPLXX_VIRTUALSCREEN_HXX_INCLUDED
+#define REPLXX_VIRTUALSCREEN_HXX_INCLUDED 1
+
+#include <vector>
+#include <string>
+
+#include "io.hxx"
+
+namespace replxx {
+
+/*
+ * Model of the screen area refresh_line() draws after the prompt:
+ * input, inline hint and hint rows.  Cells are remembered as they
+ * were last drawn, so the next redraw can send only changed spans
+ * and the cursor moves needed to reach them.
+ *
+ * Rows are numbered from the last line of the prompt, the first
+ * row starts with placeholder cells standing for the prompt.
+ */
+class VirtualScreen {
+public:
+	struct Cell {
+		char32_t _char;  // 0 for the prompt and the right half of a wide character
+		int _width;      // columns taken, 0 for the right half of a wide character
+		int _attribute;  // color code, index in _attributes
+		bool operator == ( Cell const& other_ ) const {
+			return ( ( _char == other_._char ) && ( _width == other_._width ) && ( _attribute == other_._attribute ) );
+		}
+		bool operator != ( Cell const& other_ ) const {
+			return ( ! ( *this == other_ ) );
+		}
+	};
+	typedef std::vector<Cell> row_t;
+	typedef std::vector<row_t> rows_t;
+	typedef std::vector<std::string> attributes_t;
+private:
+	Terminal& _terminal;
+	rows_t _rows;              // cells as last drawn
+	rows_t _next;              // cells to draw, laid out by layout()
+	attributes_t _attributes;  // color codes seen so far, reset first
+	int _indentation;          // prompt width the rows were laid out for
+	int _columns;              // screen width the rows were laid out for
+	int _nextIndentation;
+	int _nextColumns;
+	int _cursorRow;            // cursor position as left by the last redraw
+	int _cursorColumn;
+	int _rowsReached;          // rows known to exist on screen, cursor can move down through them
+	unsigned long long _generation; // Terminal::generation() after the last redraw
+	bool _valid;
+	/* terminal state while update() runs */
+	int _row;
+	int _column;
+	bool _pendingWrap;         // last column was written, the terminal wraps on next character
+	int _attribute;
+public:
+	VirtualScreen( Terminal& );
+	/*! \brief Lay out text the way a full redraw would put it on screen.
+	 *
+	 * \param display_ - UTF-8 text to draw, may contain color codes and line breaks.
+	 * \param newline_ - full redraw ends with a line break.
+	 * \param maxRows_ - rows available below the prompt.
+	 * \return False if layout cannot be predicted (control and zero width
+	 * characters, wide characters split by line wrap, text taller than the screen).
+	 */
+	bool layout( char const* display_, int size_, bool newline_, int indentation_, int columns_, int maxRows_ );
+	/*! \brief Row the last laid out text ends at.
+	 */
+	int end_row( void ) const {
+		return ( static_cast<int>( _next.size() ) - 1 );
+	}
+	/*! \brief Tell if the screen still shows what was last drawn.
+	 *
+	 * Any output not made by update() or followed by commit() makes
+	 * the model stale, as does change of prompt or screen width.
+	 */
+	bool is_current( int indentation_, int columns_, int cursorRow_ ) const;
+	/*! \brief Draw the laid out text over the remembered one.
+	 *
+	 * Writes only the changed spans, clears what is no longer there
+	 * and leaves the cursor at given position.
+	 */
+	void update( int cursorRow_, int cursorColumn_ );
+	/*! \brief Remember laid out text as drawn in full.
+	 */
+	void commit( int cursorRow_, int cursorColumn_ );
+	void invalidate( void ) {
+		_valid = false;
+	}
+private:
+	int attribute( char const*, int );
+	void move_to( int, int );
+	void set_attribute( int );
+	void put( Cell const& );
+	void emit( char const* );
+	VirtualScreen( VirtualScreen const& ) = delete;
+	VirtualScreen& operator = ( VirtualScreen const& ) = delete;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <columnindex.hxx>
+#include <unicodestring.hxx>
+#include <util.hxx>
+
+#include <random>
+
+namespace replxx {
+
+  namespace {
+
+    /* narrow, wide, zero width and non-printable characters */
+    char32_t const SAMPLE[] = { U'a', U'Z', U' ', U'ą', U'界', U'\U0001F600', U'́', U'\x01' };
+
+    char32_t random_character( std::mt19937& rng_ ) {
+      return ( SAMPLE[rng_() % ( sizeof ( SAMPLE ) / sizeof ( SAMPLE[0] ) )] );
+    }
+
+    void expect_columns( ColumnIndex const& index_, UnicodeString& text_ ) {
+      ASSERT_EQ( index_.length(), text_.length() );
+      for ( int pos( 0 ); pos <= text_.length(); ++ pos ) {
+        ASSERT_EQ( index_.column( pos ), pos > 0 ? calculateColumnPosition( text_.get(), pos ) : 0 ) << "at " << pos;
+      }
+    }
+
+  }
+
+  TEST( columnindex_test, follows_edits ) {
+    std::mt19937 rng( 42 );
+    ColumnIndex index;
+    UnicodeString text;
+    for ( int step( 0 ); step < 2000; ++ step ) {
+      int pos( static_cast<int>( rng() % static_cast<unsigned>( text.length() + 1 ) ) );
+      if ( ( rng() % 3 ) || ( text.length() == 0 ) ) {
+        int len( static_cast<int>( rng() % 5 ) + 1 );
+        UnicodeString inserted;
+        for ( int i( 0 ); i < len; ++ i ) {
+          char32_t c( random_character( rng ) );
+          inserted.append( &c, 1 );
+        }
+        text.insert( pos, inserted, 0, len );
+        index.insert( pos, inserted.get(), len );
+      } else {
+        int len( std::min( static_cast<int>( rng() % 4 ) + 1, text.length() - pos ) );
+        text.erase( pos, len );
+        index.erase( pos, len );
+      }
+      /* queries of the edited part only, the rest is built later */
+      if ( step % 7 ) {
+        ASSERT_EQ( index.column( pos ), pos > 0 ? calculateColumnPosition( text.get(), pos ) : 0 );
+      } else {
+        expect_columns( index, text );
+      }
+    }
+    index.assign( text.get(), text.length() );
+    expect_columns( index, text );
+    ColumnIndex copy;
+    copy.insert( 0, text.get(), 3 );
+    EXPECT_EQ( copy.column( 3 ), calculateColumnPosition( text.get(), 3 ) );
+    copy.assign_widths( index );
+    expect_columns( copy, text );
+    index.clear();
+    EXPECT_EQ( index.length(), 0 );
+    EXPECT_EQ( index.column( 10 ), 0 );
+  }
+
+}
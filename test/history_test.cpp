@@ -1,5 +1,18 @@
 #include <gtest/gtest.h>
 #include <history.hxx>
+#include <compression.hxx>
+#include <historywriter.hxx>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 namespace replxx {
 
@@ -27,4 +40,1006 @@ namespace replxx {
 
   }
 
-}
\ No newline at end of file
+  TEST(history_test, append_only_save) {
+
+    char const file[] = "./history_test_append.txt";
+    auto content = [&file]() {
+      std::ifstream f( file );
+      std::stringstream ss;
+      ss << f.rdbuf();
+      return ss.str();
+    };
+    remove( file );
+    History p_hist;
+    p_hist.set_max_size( 3 );
+    p_hist.set_append_only( true );
+    p_hist.add( "one" );
+    p_hist.add( "two" );
+    EXPECT_EQ( p_hist.save( file ), 0 );
+    EXPECT_EQ( content(), "one\ntwo\n" );
+    p_hist.add( "three" );
+    EXPECT_EQ( p_hist.save( file ), 0 );
+    EXPECT_EQ( content(), "one\ntwo\nthree\n" );
+    p_hist.add( "four" );
+    p_hist.add( "five" );
+    p_hist.add( "six" );
+    p_hist.add( "seven" );
+    // file would exceed twice the maximum size, it gets compacted
+    EXPECT_EQ( p_hist.save( file ), 0 );
+    EXPECT_EQ( content(), "four\nfive\nsix\nseven\n" );
+
+    History loaded;
+    loaded.set_append_only( true );
+    EXPECT_EQ( loaded.load( file ), 0 );
+    loaded.add( "eight" );
+    EXPECT_EQ( loaded.save( file ), 0 );
+    EXPECT_EQ( content(), "four\nfive\nsix\nseven\neight\n" );
+    remove( file );
+
+  }
+
+  TEST(history_test, shared_history_merge) {
+
+    char const file[] = "./history_test_shared.txt";
+    auto content = [&file]() {
+      std::ifstream f( file );
+      std::stringstream ss;
+      ss << f.rdbuf();
+      return ss.str();
+    };
+    remove( file );
+    History first;
+    History second;
+    first.set_shared( true );
+    second.set_shared( true );
+    first.add( "one" );
+    EXPECT_EQ( first.save( file ), 0 );
+    EXPECT_EQ( second.load( file ), 0 );
+    ASSERT_EQ( second.size(), 1 );
+    first.add( "two" );
+    EXPECT_EQ( first.save( file ), 0 );
+    second.add( "three" );
+    EXPECT_EQ( second.merge(), 1 );
+    ASSERT_EQ( second.size(), 3 );
+    EXPECT_EQ( second[1], "two" );
+    EXPECT_EQ( second[2], "three" );
+    EXPECT_EQ( second.save( file ), 0 );
+    EXPECT_EQ( content(), "one\ntwo\nthree\n" );
+    {
+      /* a line still being written is not picked up */
+      std::ofstream f( file, std::ios::app );
+      f << "four\nfi";
+    }
+    EXPECT_EQ( first.merge(), 2 );
+    ASSERT_EQ( first.size(), 4 );
+    EXPECT_EQ( first[3], "four" );
+    {
+      std::ofstream f( file, std::ios::app );
+      f << "ve\n";
+    }
+    EXPECT_EQ( first.merge(), 1 );
+    EXPECT_EQ( first[4], "five" );
+    EXPECT_EQ( first.merge(), 0 );
+    /* compaction by one session does not confuse the other */
+    second.set_max_size( 2 );
+    second.add( "six" );
+    second.add( "seven" );
+    EXPECT_EQ( second.save( file ), 0 );
+    EXPECT_EQ( content(), "five\nsix\nseven\n" );
+    EXPECT_EQ( first.merge(), 0 );
+    first.add( "eight" );
+    EXPECT_EQ( first.save( file ), 0 );
+    EXPECT_EQ( content(), "five\nsix\nseven\neight\n" );
+    EXPECT_EQ( second.merge(), 1 );
+    EXPECT_EQ( second[second.size() - 1], "eight" );
+    remove( file );
+
+  }
+
+  TEST(history_test, background_writer) {
+
+    char const file[] = "./history_test_writer.txt";
+    auto content = [&file]() {
+      std::ifstream f( file );
+      std::stringstream ss;
+      ss << f.rdbuf();
+      return ss.str();
+    };
+    remove( file );
+    {
+      HistoryWriter writer( file, -1 );
+      writer.append( "one", 3 );
+      writer.append( "two", 3 );
+      EXPECT_EQ( writer.sync(), 0 );
+      EXPECT_EQ( content(), "one\ntwo\n" );
+      writer.rewrite( []( std::string& contents_ ) { contents_.append( "two\nthree\n" ); } );
+      writer.append( "four", 4 );
+    }
+    /* destruction flushes whatever is queued */
+    EXPECT_EQ( content(), "two\nthree\nfour\n" );
+    {
+      HistoryWriter writer( file, 0 );
+      for ( int i( 0 ); i < 10000; ++ i ) {
+        std::string line( std::to_string( i ) );
+        writer.append( line.data(), static_cast<int>( line.length() ) );
+      }
+      EXPECT_EQ( writer.sync(), 0 );
+    }
+    std::ifstream f( file );
+    std::string line;
+    int lines( 0 );
+    while ( std::getline( f, line ) ) {
+      if ( lines >= 3 ) {
+        EXPECT_EQ( line, std::to_string( lines - 3 ) );
+      }
+      ++ lines;
+    }
+    EXPECT_EQ( lines, 10003 );
+    remove( file );
+    {
+      HistoryWriter writer( "./no/such/directory/history.txt", 0 );
+      writer.append( "x", 1 );
+      EXPECT_EQ( writer.sync(), -1 );
+      EXPECT_EQ( writer.sync(), 0 );
+    }
+
+  }
+
+  TEST(history_test, text_snapshot) {
+
+    for ( bool compress : { false, true } ) {
+      History h;
+      h.set_max_size( 15000 );
+      h.set_compression( compress );
+      for ( int i( 0 ); i < 20000; ++ i ) {
+        h.add( "make -C build/" + std::to_string( i % 113 ) + " target_" + std::to_string( i ) );
+      }
+      h.add_edit_slot( "being edited" );
+      std::string expected;
+      for ( int i( 0 ); i < h.size(); ++ i ) {
+        expected.append( h[i] ).append( 1, '\n' );
+      }
+      std::function<void ( std::string& )> snapshot( h.text_snapshot() );
+      /* lines going away or written over the edit slot do not show */
+      h.drop_last();
+      for ( int i( 0 ); i < 15000; ++ i ) {
+        h.add( "ls " + std::to_string( i ) );
+      }
+      std::string contents;
+      std::thread writer( [&snapshot, &contents]() { snapshot( contents ); } );
+      writer.join();
+      EXPECT_EQ( contents, expected ) << "compress " << compress;
+    }
+
+  }
+
+  TEST(history_test, eviction_keeps_order) {
+
+    History p_hist;
+    p_hist.set_max_size( 3 );
+    for ( int i( 0 ); i < 10; ++ i ) {
+      p_hist.add( std::to_string( i ) );
+    }
+    ASSERT_EQ( p_hist.size(), 4 );
+    for ( int i( 0 ); i < 4; ++ i ) {
+      EXPECT_EQ( p_hist[i], std::to_string( 6 + i ) );
+    }
+    p_hist.drop_last();
+    p_hist.add( "x" );
+    EXPECT_EQ( p_hist[0], "6" );
+    EXPECT_EQ( p_hist[3], "x" );
+    p_hist.set_max_size( 2 );
+    ASSERT_EQ( p_hist.size(), 2 );
+    EXPECT_EQ( p_hist[0], "8" );
+    EXPECT_EQ( p_hist[1], "x" );
+    p_hist.add( "y" );
+    p_hist.add( "z" );
+    ASSERT_EQ( p_hist.size(), 3 );
+    EXPECT_EQ( p_hist[0], "x" );
+    EXPECT_EQ( p_hist[2], "z" );
+
+  }
+
+  TEST(history_test, ring_buffer_erase) {
+
+    RingBuffer<int> ring( 40 );
+    std::deque<int> model;
+    unsigned seed( 1 );
+    auto next = [&seed]( unsigned mod ) {
+      seed = seed * 1103515245u + 12345u;
+      return ( static_cast<int>( ( seed >> 8 ) % mod ) );
+    };
+    for ( int i( 0 ); i < 20000; ++ i ) {
+      int op( next( 10 ) );
+      if ( ( op < 5 ) || model.empty() ) {
+        ring.push_back( i );
+        if ( static_cast<int>( model.size() ) == ring.capacity() ) {
+          model.pop_front();
+        }
+        model.push_back( i );
+      } else if ( op < 8 ) {
+        int idx( next( static_cast<unsigned>( model.size() ) ) );
+        ring.erase( idx );
+        model.erase( model.begin() + idx );
+      } else if ( op == 8 ) {
+        ring.pop_back();
+        model.pop_back();
+      } else if ( i % 7 == 0 ) {
+        int capacity( 1 + next( 60 ) );
+        ring.set_capacity( capacity );
+        while ( static_cast<int>( model.size() ) > capacity ) {
+          model.pop_front();
+        }
+      } else {
+        ring.erase_front( 1 );
+        model.pop_front();
+      }
+      ASSERT_EQ( ring.size(), static_cast<int>( model.size() ) );
+      if ( ! model.empty() ) {
+        EXPECT_EQ( ring.front(), model.front() );
+        EXPECT_EQ( ring.back(), model.back() );
+      }
+      std::deque<int>::const_iterator m( model.begin() );
+      int idx( 0 );
+      for ( int v : ring ) {
+        EXPECT_EQ( v, *m );
+        EXPECT_EQ( ring[idx], *m );
+        ++ m;
+        ++ idx;
+      }
+    }
+
+  }
+
+  TEST(history_test, unique_matches_model) {
+
+    std::vector<std::string> model;
+    int maxSize( 12 );
+    auto model_add = [&model, &maxSize]( std::string const& line ) {
+      if ( ! model.empty() && ( model.back() == line ) ) {
+        return;
+      }
+      if ( ! line.empty() ) {
+        model.erase( std::remove( model.begin(), model.end(), line ), model.end() );
+      }
+      if ( static_cast<int>( model.size() ) > maxSize ) {
+        model.erase( model.begin() );
+      }
+      model.push_back( line );
+    };
+    auto check = [&model]( History const& hist ) {
+      ASSERT_EQ( hist.size(), static_cast<int>( model.size() ) );
+      for ( int i( 0 ); i < hist.size(); ++ i ) {
+        EXPECT_EQ( hist[i], model[static_cast<size_t>( i )] );
+      }
+    };
+    History p_hist;
+    p_hist.set_max_size( maxSize );
+    p_hist.set_unique( true );
+    for ( int i( 0 ); i < 500; ++ i ) {
+      std::string line( i % 11 == 0 ? "" : "line " + std::to_string( ( i * 7919 ) % 23 ) );
+      p_hist.add( line );
+      model_add( line );
+      if ( i % 50 == 0 ) {
+        maxSize = 5 + i % 17;
+        p_hist.set_max_size( maxSize );
+        if ( static_cast<int>( model.size() ) > maxSize ) {
+          model.erase( model.begin(), model.end() - maxSize );
+        }
+      }
+      if ( i % 37 == 0 ) {
+        int expected( -1 );
+        for ( int j( p_hist.size() - 1 ); ( j >= 0 ) && ( expected < 0 ); -- j ) {
+          expected = p_hist[j].find( "line 1" ) != std::string::npos ? j : -1;
+        }
+        EXPECT_EQ( p_hist.find( "line 1", 6, p_hist.size() - 1, -1 ), expected );
+        p_hist.reset_pos( p_hist.size() - 1 );
+        EXPECT_EQ( p_hist.common_prefix_search( "line 1", 6, true ), expected >= 0 );
+      }
+      check( p_hist );
+    }
+
+    /* load gives the same result as adding lines one by one */
+    char const file[] = "./history_test_unique.txt";
+    {
+      std::ofstream f( file );
+      for ( int i( 0 ); i < 300; ++ i ) {
+        f << "cmd " << ( i * i ) % 40 << "\n";
+      }
+    }
+    model.clear();
+    maxSize = 20;
+    for ( int i( 0 ); i < 300; ++ i ) {
+      model_add( "cmd " + std::to_string( ( i * i ) % 40 ) );
+    }
+    History loaded;
+    loaded.set_max_size( maxSize );
+    loaded.set_unique( true );
+    EXPECT_EQ( loaded.load( file ), 0 );
+    check( loaded );
+    remove( file );
+
+    /* enabling the policy drops older duplicates */
+    History plain;
+    plain.set_max_size( 10 );
+    for ( char const* line : { "a", "b", "a", "c", "b", "a" } ) {
+      plain.add( line );
+    }
+    plain.set_unique( true );
+    ASSERT_EQ( plain.size(), 3 );
+    EXPECT_EQ( plain[0], "c" );
+    EXPECT_EQ( plain[1], "b" );
+    EXPECT_EQ( plain[2], "a" );
+    plain.add( "c" );
+    EXPECT_EQ( plain[2], "c" );
+    EXPECT_EQ( plain.size(), 3 );
+
+    /* edit slot is not a duplicate of anything */
+    History edited;
+    edited.set_max_size( 10 );
+    edited.set_unique( true );
+    for ( char const* line : { "ls", "make", "git" } ) {
+      edited.add( line );
+    }
+    edited.add_edit_slot( "ls" );
+    ASSERT_EQ( edited.size(), 4 );
+    edited.update_last( "make" );
+    edited.drop_last();
+    ASSERT_EQ( edited.size(), 3 );
+    EXPECT_EQ( edited[0], "ls" );
+    EXPECT_EQ( edited[1], "make" );
+    EXPECT_EQ( edited[2], "git" );
+    edited.add( "ls" );
+    ASSERT_EQ( edited.size(), 3 );
+    EXPECT_EQ( edited[2], "ls" );
+
+  }
+
+  TEST(history_test, arena_storage) {
+
+    History p_hist;
+    std::string longLine( 100000, 'x' );
+    p_hist.add( "short" );
+    p_hist.add( longLine );
+    p_hist.add( "" );
+    p_hist.update_last( "edited" );
+    ASSERT_EQ( p_hist.size(), 3 );
+    EXPECT_EQ( p_hist[0], "short" );
+    EXPECT_EQ( p_hist[1], longLine );
+    EXPECT_EQ( p_hist.line_length( 1 ), 100000 );
+    EXPECT_STREQ( p_hist.line( 2 ), "edited" );
+    long long used( p_hist.memory_usage() );
+    EXPECT_GT( used, 100000 );
+    p_hist.set_max_size( 1 );
+    EXPECT_LT( p_hist.memory_usage(), used );
+    EXPECT_EQ( p_hist[0], "edited" );
+
+  }
+
+  TEST(history_test, load_keeps_tail) {
+
+    char const file[] = "./history_test_load.txt";
+    {
+      std::ofstream f( file );
+      f << "one\n\ntwo\r\ntwo\nthree\nfour\nfour\r\n\nfive\nsix";
+    }
+    History full;
+    full.set_max_size( 100 );
+    EXPECT_EQ( full.load( file ), 0 );
+    ASSERT_EQ( full.size(), 6 );
+    EXPECT_EQ( full[1], "two" );
+    EXPECT_EQ( full[5], "six" );
+    for ( int maxSize : { 0, 1, 2, 3, 5, 6 } ) {
+      History tail;
+      tail.set_max_size( maxSize );
+      EXPECT_EQ( tail.load( file ), 0 );
+      History expected;
+      expected.set_max_size( maxSize );
+      for ( int i( 0 ); i < full.size(); ++ i ) {
+        expected.add( full[i] );
+      }
+      ASSERT_EQ( tail.size(), expected.size() );
+      for ( int i( 0 ); i < tail.size(); ++ i ) {
+        EXPECT_EQ( tail[i], expected[i] );
+      }
+    }
+    History dup;
+    dup.set_max_size( 2 );
+    dup.add( "five" );
+    EXPECT_EQ( dup.load( file ), 0 );
+    ASSERT_EQ( dup.size(), 3 );
+    EXPECT_EQ( dup[0], "four" );
+    EXPECT_EQ( dup[2], "six" );
+    remove( file );
+    EXPECT_EQ( full.load( file ), -1 );
+
+  }
+
+  TEST(history_test, binary_round_trip) {
+
+    char const text[] = "./history_test_binary.txt";
+    char const binary[] = "./history_test_binary.bin";
+    History h;
+    h.set_max_size( 100 );
+    char const* lines[] = { "one", "two", "two", "three", "\xd0\xb6\xd1\x83\xd0\xba", "four" };
+    long long stamp( 1000 );
+    for ( char const* l : lines ) {
+      h.add( l, static_cast<int>( strlen( l ) ), stamp ++ );
+    }
+    h.set_binary( true );
+    EXPECT_EQ( h.save( binary ), 0 );
+    History loaded;
+    loaded.set_max_size( 100 );
+    EXPECT_EQ( loaded.load( binary ), 0 );
+    ASSERT_EQ( loaded.size(), h.size() );
+    for ( int i( 0 ); i < h.size(); ++ i ) {
+      EXPECT_EQ( loaded[i], h[i] );
+      EXPECT_EQ( loaded.timestamp( i ), h.timestamp( i ) );
+    }
+    /* only the newest entries are read */
+    History tail;
+    tail.set_max_size( 3 );
+    EXPECT_EQ( tail.load( binary ), 0 );
+    ASSERT_EQ( tail.size(), 4 );
+    EXPECT_EQ( tail[0], "two" );
+    EXPECT_EQ( tail[3], "four" );
+    EXPECT_EQ( tail.timestamp( 0 ), 1001 );
+    EXPECT_EQ( tail.timestamp( 3 ), 1005 );
+    /* and back to text, timestamps are gone */
+    EXPECT_EQ( loaded.save( text ), 0 );
+    History plain;
+    plain.set_max_size( 100 );
+    EXPECT_EQ( plain.load( text ), 0 );
+    ASSERT_EQ( plain.size(), h.size() );
+    EXPECT_EQ( plain[4], h[4] );
+    EXPECT_EQ( plain.timestamp( 4 ), 0 );
+    /* damaged file is rejected */
+    {
+      std::fstream f( binary, std::ios::in | std::ios::out | std::ios::binary );
+      f.seekp( -1, std::ios::end );
+      f.put( '?' );
+    }
+    History broken;
+    EXPECT_EQ( broken.load( binary ), -1 );
+    EXPECT_EQ( broken.size(), 0 );
+    remove( text );
+    remove( binary );
+
+  }
+
+  TEST(history_test, lazy_load_matches_full_load) {
+
+    char const file[] = "./history_test_lazy.txt";
+    {
+      std::ofstream f( file );
+      for ( int i( 0 ); i < 500; ++ i ) {
+        f << "cmd " << ( i % 37 ) << "\n" << ( i % 5 == 0 ? "\n" : "" ) << ( i % 7 == 0 ? "same\nsame\n" : "" );
+      }
+    }
+    for ( bool unique : { false, true } ) {
+      for ( int maxSize : { 10, 100, 1000 } ) {
+        History full;
+        full.set_unique( unique );
+        full.set_max_size( maxSize );
+        EXPECT_EQ( full.load( file ), 0 );
+        History lazy;
+        lazy.set_unique( unique );
+        lazy.set_max_size( maxSize );
+        lazy.set_lazy_load( 5 );
+        EXPECT_EQ( lazy.load( file ), 0 );
+        ASSERT_LE( lazy.size(), 5 );
+        lazy.reset_pos();
+        lazy.move( true );
+        std::string recalled( lazy.current() );
+        lazy.absorb_loaded( true );
+        /* current position keeps pointing at the same entry */
+        EXPECT_EQ( std::string( lazy.current() ), recalled );
+        ASSERT_EQ( lazy.size(), full.size() );
+        for ( int i( 0 ); i < full.size(); ++ i ) {
+          EXPECT_EQ( lazy[i], full[i] );
+        }
+        EXPECT_EQ( lazy.find( "cmd 3", 5, lazy.size() - 1, -1 ), full.find( "cmd 3", 5, full.size() - 1, -1 ) );
+      }
+    }
+    /* lines added in the meantime stay the newest ones */
+    History lazy;
+    lazy.set_max_size( 20 );
+    lazy.set_lazy_load( 3 );
+    EXPECT_EQ( lazy.load( file ), 0 );
+    lazy.add( "fresh" );
+    lazy.absorb_loaded( true );
+    ASSERT_EQ( lazy.size(), 21 );
+    EXPECT_EQ( lazy[20], "fresh" );
+    EXPECT_EQ( lazy[19], "cmd 18" );
+    remove( file );
+
+  }
+
+  TEST(history_test, frecency_ranks_prefix) {
+
+    History h;
+    h.set_max_size( 6 );
+    h.set_frecency( true );
+    long long now( time( nullptr ) );
+    h.add( "git status", 10, now - 10 * 86400 );
+    h.add( "git status", 10, now - 9 * 86400 );
+    h.add( "git push", 8, now - 60 );
+    h.add( "git status", 10, now - 8 * 86400 );
+    h.add( "gitk", 4, now - 30 );
+    h.add( "ls", 2, now - 20 );
+    FrecencyIndex::lines_t lines;
+    /* consecutive duplicates are not added, so git status counts twice */
+    h.frecent( "git", 3, 10, lines );
+    ASSERT_EQ( lines.size(), 3u );
+    EXPECT_EQ( lines[0], "gitk" );
+    EXPECT_EQ( lines[1], "git push" );
+    EXPECT_EQ( lines[2], "git status" );
+    h.frecent( "git", 3, 1, lines );
+    ASSERT_EQ( lines.size(), 1u );
+    EXPECT_EQ( lines[0], "gitk" );
+    h.frecent( "ls", 2, 10, lines );
+    EXPECT_TRUE( lines.empty() );
+    h.add( "git status", 10, now );
+    h.frecent( "git s", 5, 10, lines );
+    ASSERT_EQ( lines.size(), 1u );
+    /* evicted entries give their uses back */
+    h.set_max_size( 2 );
+    h.frecent( "git", 3, 10, lines );
+    ASSERT_EQ( lines.size(), 1u );
+    EXPECT_EQ( lines[0], "git status" );
+    h.frecent( "", 0, 10, lines );
+    EXPECT_EQ( lines.size(), 2u );
+    History u;
+    u.set_unique( true );
+    u.set_frecency( true );
+    for ( char const* l : { "make", "make test", "make", "make test", "make" } ) {
+      u.add( l );
+    }
+    u.frecent( "ma", 2, 10, lines );
+    ASSERT_EQ( lines.size(), 2u );
+    EXPECT_EQ( lines[0], "make" );
+    EXPECT_EQ( lines[1], "make test" );
+
+  }
+
+  TEST(history_test, frecency_candidates_match_scan) {
+
+    typedef std::map<std::string, FrecencyIndex::Stats> model_t;
+    FrecencyIndex index;
+    model_t model;
+    long long now( 1700000000 );
+    unsigned seed( 12345 );
+    auto rnd = [&seed]( unsigned n_ ) {
+      seed = seed * 1103515245u + 12345u;
+      return ( ( seed >> 16 ) % n_ );
+    };
+    auto expect = [&model]( std::string const& prefix_, int count_, long long now_ ) {
+      std::vector<std::pair<double, model_t::const_iterator>> hits;
+      for ( model_t::const_iterator it( model.begin() ); it != model.end(); ++ it ) {
+        if ( ( it->first.length() > prefix_.length() ) && ( it->first.compare( 0, prefix_.length(), prefix_ ) == 0 ) ) {
+          hits.emplace_back( FrecencyIndex::score( it->second, now_ ), it );
+        }
+      }
+      std::sort(
+        hits.begin(), hits.end(),
+        []( std::pair<double, model_t::const_iterator> const& l_, std::pair<double, model_t::const_iterator> const& r_ ) {
+          if ( l_.first != r_.first ) {
+            return ( l_.first > r_.first );
+          }
+          if ( l_.second->second._lastUse != r_.second->second._lastUse ) {
+            return ( l_.second->second._lastUse > r_.second->second._lastUse );
+          }
+          return ( l_.second->first < r_.second->first );
+        }
+      );
+      FrecencyIndex::lines_t lines;
+      for ( int i( 0 ); ( i < count_ ) && ( i < static_cast<int>( hits.size() ) ); ++ i ) {
+        lines.push_back( hits[static_cast<size_t>( i )].second->first );
+      }
+      return ( lines );
+    };
+    char const* prefixes[] = { "", "c", "cmd", "cmd 1", "cmd 12", "x" };
+    FrecencyIndex::lines_t lines;
+    for ( int step( 0 ); step < 4000; ++ step ) {
+      /* same second for a while, so ties are common */
+      now += rnd( 8 ) == 0 ? rnd( 20000 ) : 0;
+      /* a few lines are used most of the time */
+      std::string line( "cmd " + std::to_string( rnd( 1 + rnd( 700 ) ) ) );
+      unsigned op( rnd( 20 ) );
+      if ( op == 0 ) {
+        index.forget( line.data(), static_cast<int>( line.length() ) );
+        model.erase( line );
+      } else if ( op < 3 ) {
+        index.remove( line.data(), static_cast<int>( line.length() ) );
+        model_t::iterator it( model.find( line ) );
+        if ( ( it != model.end() ) && ( -- it->second._count <= 0 ) ) {
+          model.erase( it );
+        }
+      } else {
+        index.add( line.data(), static_cast<int>( line.length() ), now );
+        FrecencyIndex::Stats& stats( model.emplace( line, FrecencyIndex::Stats{ 0, now } ).first->second );
+        ++ stats._count;
+        stats._lastUse = std::max( stats._lastUse, now );
+      }
+      if ( ( step % 50 ) != 0 ) {
+        continue;
+      }
+      for ( char const* prefix : prefixes ) {
+        int count( static_cast<int>( 1 + rnd( 20 ) ) );
+        /* queries in the future see scores decay */
+        long long at( now + ( rnd( 2 ) == 0 ? 0 : rnd( 30 * 86400 ) ) );
+        index.top( prefix, static_cast<int>( strlen( prefix ) ), count, at, lines );
+        ASSERT_EQ( lines, expect( prefix, count, at ) ) << "step " << step << " prefix '" << prefix << "'";
+      }
+    }
+
+  }
+
+  TEST(history_test, scan_filters_in_place) {
+
+    History h;
+    h.set_max_size( 10 );
+    for ( char const* l : { "git status", "ls -la", "git push origin", "make", "git log --stat" } ) {
+      h.add( l );
+    }
+    std::vector<int> indexes;
+    auto collect( [&indexes, &h]( int index_, char const* line_, int length_ ) {
+      EXPECT_EQ( line_, h.line( index_ ) );
+      EXPECT_EQ( length_, h.line_length( index_ ) );
+      indexes.push_back( index_ );
+      return ( true );
+    } );
+    EXPECT_EQ( h.scan( "", 0, "", 0, collect ), 5 );
+    EXPECT_EQ( indexes, std::vector<int>( { 0, 1, 2, 3, 4 } ) );
+    indexes.clear();
+    EXPECT_EQ( h.scan( "git", 3, "", 0, collect ), 3 );
+    EXPECT_EQ( indexes, std::vector<int>( { 0, 2, 4 } ) );
+    indexes.clear();
+    EXPECT_EQ( h.scan( "", 0, "stat", 4, collect ), 2 );
+    EXPECT_EQ( indexes, std::vector<int>( { 0, 4 } ) );
+    indexes.clear();
+    EXPECT_EQ( h.scan( "git", 3, "o", 1, collect ), 2 );
+    EXPECT_EQ( indexes, std::vector<int>( { 2, 4 } ) );
+    indexes.clear();
+    EXPECT_EQ( h.scan( "git status --long", 17, "", 0, collect ), 0 );
+    EXPECT_TRUE( indexes.empty() );
+    int visited( 0 );
+    EXPECT_EQ( h.scan( "", 0, "", 0, [&visited]( int, char const*, int ) { return ( ++ visited < 2 ); } ), 2 );
+    EXPECT_EQ( visited, 2 );
+
+  }
+
+  TEST(history_test, decoded_cache) {
+
+    History h;
+    h.set_max_size( 10 );
+    std::string wide;
+    for ( int i( 0 ); i < 300; ++ i ) {
+      wide.append( "\xe4\xb8\xad" ); /* CJK, two columns each */
+    }
+    h.add( "plain" );
+    h.add( wide );
+    h.add( "last" );
+    for ( long long budget : { 0LL, 1000LL, 100000LL } ) {
+      h.set_decoded_cache_budget( budget );
+      for ( int round( 0 ); round < 2; ++ round ) {
+        for ( int i( 0 ); i < h.size(); ++ i ) {
+          History::Decoded const& d( h.decoded( i ) );
+          UnicodeString expected( h[i] );
+          ASSERT_EQ( d._text.length(), expected.length() );
+          EXPECT_TRUE( std::equal( expected.begin(), expected.end(), d._text.begin() ) );
+          EXPECT_EQ( d.widths().column( d.widths().length() ), i == 1 ? 600 : expected.length() );
+        }
+        EXPECT_LE( h.decoded_cache_size(), budget );
+      }
+    }
+    /* the large entry does not fit in 1000 bytes, the small ones do */
+    h.set_decoded_cache_budget( 1000 );
+    h.decoded( 0 );
+    h.decoded( 1 );
+    h.decoded( 2 );
+    EXPECT_GT( h.decoded_cache_size(), 0 );
+    EXPECT_LT( h.decoded_cache_size(), 400 );
+    /* a changed entry is decoded anew */
+    h.reset_pos();
+    EXPECT_EQ( h.current_decoded()._text.length(), 4 );
+    EXPECT_EQ( h.materialized( h.size() - 1 ), "last" );
+    h.update_last( "changed" );
+    EXPECT_EQ( h.current_decoded()._text.length(), 7 );
+    EXPECT_EQ( h.materialized( h.size() - 1 ), "changed" );
+    h.set_max_size( 1 );
+    EXPECT_EQ( h.decoded( 0 )._text.length(), 7 );
+    EXPECT_LT( h.decoded_cache_size(), 200 );
+
+  }
+
+  TEST(history_test, find_matches_scan) {
+
+    History p_hist;
+    p_hist.set_max_size( 50 );
+    auto scan = [&p_hist]( std::string const& text, int from, int direction ) {
+      for ( int i( from ); ( i >= 0 ) && ( i < p_hist.size() ); i += direction ) {
+        if ( p_hist[i].find( text ) != std::string::npos ) {
+          return ( i );
+        }
+      }
+      return ( -1 );
+    };
+    char const* needles[] = { "a", "ab", "abc", "cab", "bca", "zzz", "abcabc" };
+    for ( int i( 0 ); i < 200; ++ i ) {
+      std::string line;
+      for ( int j( 0 ); j < ( i * 7 ) % 11; ++ j ) {
+        line.append( 1, static_cast<char>( 'a' + ( i * j + j ) % 3 ) );
+      }
+      p_hist.add( line );
+      if ( i % 5 == 0 ) {
+        p_hist.update_last( line + "abc" );
+      } else if ( i % 7 == 0 ) {
+        p_hist.drop_last();
+      }
+      if ( i % 13 == 0 ) {
+        p_hist.set_max_size( 20 + i % 40 );
+      }
+      for ( char const* needle : needles ) {
+        int len( static_cast<int>( strlen( needle ) ) );
+        for ( int from( 0 ); from < p_hist.size(); from += 3 ) {
+          EXPECT_EQ( p_hist.find( needle, len, from, -1 ), scan( needle, from, -1 ) );
+          EXPECT_EQ( p_hist.find( needle, len, from, 1 ), scan( needle, from, 1 ) );
+        }
+      }
+    }
+    EXPECT_EQ( p_hist.find( "abc", 3, p_hist.size(), -1 ), -1 );
+
+  }
+
+  TEST(history_test, prefix_search_matches_scan) {
+
+    History p_hist;
+    p_hist.set_max_size( 30 );
+    auto scan = [&p_hist]( std::string const& prefix, int from, bool back ) {
+      int direct( p_hist.size() + ( back ? -1 : 1 ) );
+      for ( int i( ( from + direct ) % p_hist.size() ); i != from; i = ( i + direct ) % p_hist.size() ) {
+        if ( ( p_hist[i].compare( 0, prefix.length(), prefix ) == 0 ) && ( p_hist[i] != prefix ) ) {
+          return ( i );
+        }
+      }
+      return ( -1 );
+    };
+    char const* prefixes[] = { "", "a", "ab", "ba", "abababababababababab", "c" };
+    for ( int i( 0 ); i < 300; ++ i ) {
+      std::string line;
+      for ( int j( 0 ); j < ( i * 7 ) % 23; ++ j ) {
+        line.append( 1, static_cast<char>( 'a' + ( j % 2 ? i % 2 : ( i / 3 ) % 2 ) ) );
+      }
+      p_hist.add( line );
+      if ( i % 5 == 0 ) {
+        p_hist.update_last( line + "c" );
+      } else if ( i % 7 == 0 ) {
+        p_hist.drop_last();
+      }
+      if ( i % 17 == 0 ) {
+        p_hist.set_max_size( 10 + i % 25 );
+      }
+      for ( char const* prefix : prefixes ) {
+        for ( int from( 0 ); from < p_hist.size(); from += 2 ) {
+          for ( bool back : { true, false } ) {
+            p_hist.reset_pos( from );
+            int expected( scan( prefix, from, back ) );
+            EXPECT_EQ( p_hist.common_prefix_search( prefix, static_cast<int>( strlen( prefix ) ), back ), expected >= 0 );
+            EXPECT_EQ( p_hist.current_pos(), expected >= 0 ? expected : from );
+          }
+        }
+      }
+    }
+
+  }
+
+
+  TEST(history_test, parallel_search_matches_sequential) {
+
+    int const size( 150000 );
+    History sequential;
+    History parallel;
+    sequential.set_max_size( size );
+    parallel.set_max_size( size );
+    parallel.set_search_threads( 4 );
+    for ( int i( 0 ); i < size; ++ i ) {
+      std::string line( "cmd " + std::to_string( ( i * 7919 ) % 100003 ) );
+      if ( i % 40000 == 17 ) {
+        line.append( " rare" );
+      }
+      sequential.add( line );
+      parallel.add( line );
+    }
+    char const* needles[] = { "rare", "d 1", "1234", "x", "cmd 99999 rare", "9" };
+    for ( char const* needle : needles ) {
+      int len( static_cast<int>( strlen( needle ) ) );
+      for ( int from : { 0, 17, 40017, 99999, size - 1 } ) {
+        for ( int direction : { -1, 1 } ) {
+          EXPECT_EQ(
+            parallel.find( needle, len, from, direction ),
+            sequential.find( needle, len, from, direction )
+          ) << needle << " " << from << " " << direction;
+        }
+      }
+    }
+    char const* prefixes[] = { "cmd 1", "cmd 9999", "cmd 42 rare", "nothing" };
+    for ( char const* prefix : prefixes ) {
+      for ( int from : { 0, 80017, size - 1 } ) {
+        for ( bool back : { true, false } ) {
+          sequential.reset_pos( from );
+          parallel.reset_pos( from );
+          EXPECT_EQ(
+            parallel.common_prefix_search( prefix, static_cast<int>( strlen( prefix ) ), back ),
+            sequential.common_prefix_search( prefix, static_cast<int>( strlen( prefix ) ), back )
+          );
+          EXPECT_EQ( parallel.current_pos(), sequential.current_pos() ) << prefix << " " << from << " " << back;
+        }
+      }
+    }
+
+  }
+
+  /* ranking every entry by hand, best count_ first */
+  void expect_fuzzy_ranking( History& h_, char const* query_, int count_ ) {
+    FuzzyMatcher matcher( query_ );
+    FuzzyMatcher::matches_t expected;
+    for ( int i( 0 ); i < h_.size(); ++ i ) {
+      int score( 0 );
+      if ( ( h_.line_length( i ) > 0 ) && matcher.match( h_.line( i ), h_.line_length( i ), score ) ) {
+        expected.push_back( FuzzyMatcher::Match{ i, score } );
+      }
+    }
+    std::sort( expected.begin(), expected.end(), FuzzyMatcher::better );
+    expected.resize( std::min<size_t>( expected.size(), static_cast<size_t>( count_ ) ) );
+    FuzzyMatcher::matches_t matches;
+    h_.fuzzy_search( query_, count_, matches, 1 );
+    ASSERT_EQ( matches.size(), expected.size() ) << query_;
+    for ( size_t i( 0 ); i < matches.size(); ++ i ) {
+      EXPECT_EQ( matches[i]._index, expected[i]._index ) << query_;
+      EXPECT_EQ( matches[i]._score, expected[i]._score ) << query_;
+    }
+  }
+
+  TEST(history_test, fuzzy_search_ranks) {
+
+    History p_hist;
+    p_hist.set_max_size( 2000 );
+    p_hist.add( "git commit --amend" );
+    p_hist.add( "grep -r commit src" );
+    p_hist.add( "ls -la" );
+    p_hist.add( "git checkout master" );
+    FuzzyMatcher::matches_t matches;
+    p_hist.fuzzy_search( "gcm", 10, matches, 1 );
+    ASSERT_EQ( matches.size(), 3 );
+    EXPECT_EQ( matches[0]._index, 3 );
+    for ( FuzzyMatcher::Match const& m : matches ) {
+      EXPECT_NE( m._index, 2 );
+    }
+    for ( int i( 0 ); i < 1500; ++ i ) {
+      p_hist.add( "long line number " + std::to_string( i ) + " with some padding text " + std::to_string( i * 7 ) );
+    }
+    for ( char const* query : { "", "lnp", "99", "LONG", "git", "xyz" } ) {
+      FuzzyMatcher::matches_t single;
+      FuzzyMatcher::matches_t parallel;
+      p_hist.fuzzy_search( query, 20, single, 1 );
+      p_hist.fuzzy_search( query, 20, parallel, 4 );
+      ASSERT_EQ( single.size(), parallel.size() );
+      for ( size_t i( 0 ); i < single.size(); ++ i ) {
+        EXPECT_EQ( single[i]._index, parallel[i]._index );
+        EXPECT_EQ( single[i]._score, parallel[i]._score );
+      }
+    }
+    p_hist.fuzzy_search( "xyz", 20, matches, 1 );
+    EXPECT_TRUE( matches.empty() );
+    p_hist.fuzzy_search( "dngtxt", 20, matches, 1 );
+    EXPECT_EQ( matches.size(), 20 );
+
+    /* scan stopped early gives the same result as ranking every entry */
+    p_hist.set_max_size( 20000 );
+    for ( int i( 0 ); i < 10000; ++ i ) {
+      p_hist.add( ( i % 3 ? "make target" : "l" ) + std::to_string( i ) );
+    }
+    for ( char const* query : { "", "l", "m", "mt", "l99" } ) {
+      expect_fuzzy_ranking( p_hist, query, 10 );
+    }
+
+    /* the index follows erased, evicted and changed entries */
+    History u;
+    u.set_unique( true );
+    u.set_max_size( 300 );
+    u.add( "seed" );
+    u.fuzzy_search( "s", 1, matches, 1 );
+    for ( int i( 0 ); i < 2000; ++ i ) {
+      u.add( "cmd " + std::to_string( i % 401 ) + ( i % 5 ? " --verbose" : "" ) );
+      if ( i % 97 == 0 ) {
+        u.add( "" );
+        u.update_last( "Zap " + std::to_string( i ) );
+      }
+      if ( i % 250 == 0 ) {
+        expect_fuzzy_ranking( u, "c9v", 10 );
+      }
+    }
+    for ( char const* query : { "", "c9", "v", "cmd 4", "zap", "Zap 1", "zq" } ) {
+      expect_fuzzy_ranking( u, query, 10 );
+    }
+
+  }
+
+
+  TEST(history_test, compressed_history) {
+
+    std::string sample;
+    for ( int i( 0 ); i < 1000; ++ i ) {
+      sample.append( "git commit -m 'change " ).append( std::to_string( i % 97 ) ).append( "'\n" );
+    }
+    sample.append( 300, 'x' ).append( "\x01\x02\x03" );
+    std::vector<char> packed( static_cast<size_t>( lz_bound( static_cast<int>( sample.length() ) ) ) );
+    int packedSize( lz_compress( sample.data(), static_cast<int>( sample.length() ), packed.data() ) );
+    EXPECT_LT( packedSize, static_cast<int>( sample.length() ) / 4 );
+    std::string unpacked( sample.length(), 0 );
+    EXPECT_TRUE( lz_decompress( packed.data(), packedSize, &unpacked[0], static_cast<int>( unpacked.length() ) ) );
+    EXPECT_EQ( unpacked, sample );
+    EXPECT_FALSE( lz_decompress( packed.data(), packedSize - 1, &unpacked[0], static_cast<int>( unpacked.length() ) ) );
+    EXPECT_FALSE( lz_decompress( packed.data(), packedSize, &unpacked[0], static_cast<int>( unpacked.length() ) - 1 ) );
+
+    char const binary[] = "./history_test_compressed.bin";
+    History plain;
+    History h;
+    plain.set_max_size( 40000 );
+    h.set_max_size( 40000 );
+    h.set_compression( true );
+    for ( int i( 0 ); i < 50000; ++ i ) {
+      std::string line( "make -C build/" + std::to_string( i % 1013 ) + " target_" + std::to_string( i ) );
+      plain.add( line.data(), static_cast<int>( line.length() ), 1000 + i );
+      h.add( line.data(), static_cast<int>( line.length() ), 1000 + i );
+    }
+    EXPECT_LT( h.memory_usage(), plain.memory_usage() * 2 / 3 );
+    ASSERT_EQ( h.size(), plain.size() );
+    for ( int i( 0 ); i < h.size(); i += 7 ) {
+      EXPECT_EQ( h[i], plain[i] );
+      EXPECT_EQ( h[h.size() - 1 - i], plain[plain.size() - 1 - i] );
+    }
+    char const needle[] = "target_12345";
+    EXPECT_EQ( h.find( needle, 12, h.size() - 1, -1 ), plain.find( needle, 12, plain.size() - 1, -1 ) );
+    FuzzyMatcher::matches_t expected;
+    FuzzyMatcher::matches_t matches;
+    plain.fuzzy_search( "b/5t9", 5, expected, 0 );
+    h.fuzzy_search( "b/5t9", 5, matches, 0 );
+    ASSERT_EQ( matches.size(), expected.size() );
+    for ( size_t i( 0 ); i < matches.size(); ++ i ) {
+      EXPECT_EQ( matches[i]._index, expected[i]._index );
+    }
+    /* binary file is compressed too, also when only its tail is loaded */
+    h.set_binary( true );
+    EXPECT_EQ( h.save( binary ), 0 );
+    plain.set_binary( true );
+    EXPECT_EQ( plain.save( "./history_test_uncompressed.bin" ), 0 );
+    std::ifstream packedFile( binary, std::ios::binary | std::ios::ate );
+    std::ifstream plainFile( "./history_test_uncompressed.bin", std::ios::binary | std::ios::ate );
+    EXPECT_LT( packedFile.tellg(), plainFile.tellg() * 2 / 3 );
+    remove( "./history_test_uncompressed.bin" );
+    History loaded;
+    loaded.set_max_size( 40000 );
+    EXPECT_EQ( loaded.load( binary ), 0 );
+    ASSERT_EQ( loaded.size(), h.size() );
+    for ( int i( 0 ); i < h.size(); i += 13 ) {
+      EXPECT_EQ( loaded[i], h[i] );
+      EXPECT_EQ( loaded.timestamp( i ), h.timestamp( i ) );
+    }
+    History tail;
+    tail.set_max_size( 9 );
+    EXPECT_EQ( tail.load( binary ), 0 );
+    ASSERT_EQ( tail.size(), 10 );
+    EXPECT_EQ( tail[9], h[h.size() - 1] );
+    EXPECT_EQ( tail.timestamp( 0 ), h.timestamp( h.size() - 10 ) );
+    /* turning compression off restores plain storage */
+    h.set_compression( false );
+    EXPECT_LE( h.memory_usage(), plain.memory_usage() );
+    EXPECT_EQ( h[0], plain[0] );
+    EXPECT_EQ( h[h.size() / 2], plain[plain.size() / 2] );
+    remove( binary );
+
+  }
+
+}
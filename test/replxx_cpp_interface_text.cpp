@@ -212,6 +212,10 @@ int utf8str_codepoint_len( char const* s, int utf8len ) {
     EXPECT_EQ(1, p_replxx->history_size());
     // History_line is 0 based
     EXPECT_EQ("My first history", p_replxx->history_line(0));
+    // text history files carry no timestamps, there is no entry past the last one
+    EXPECT_EQ(0, p_replxx->history_timestamp(0));
+    EXPECT_EQ(-1, p_replxx->history_timestamp(1));
+    EXPECT_EQ(-1, p_replxx->history_timestamp(-1));
     // Clear History
     p_replxx->set_max_history_size(0);
     EXPECT_EQ(0, p_replxx->history_size());
@@ -254,6 +258,12 @@ int utf8str_codepoint_len( char const* s, int utf8len ) {
     EXPECT_EQ(4, p_replxx->history_size());
     // History_line is 0 based
     EXPECT_EQ("int 42", p_replxx->history_line(2));
+    // entries stay in place while other entries are fetched
+    std::string const& first( p_replxx->history_line(0) );
+    std::string const& second( p_replxx->history_line(1) );
+    EXPECT_EQ("first history value", first);
+    EXPECT_EQ("second \"history\" value", second);
+    EXPECT_EQ(&first, &p_replxx->history_line(0));
 
     // clear the screen
     //p_replxx->clear_screen();
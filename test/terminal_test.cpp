@@ -0,0 +1,104 @@
+#ifndef _WIN32
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "replxx.hxx"
+#include "io.hxx"
+
+namespace {
+
+int writesToTerminal( -1 ); // counted only when not negative
+
+}
+
+/*
+ * Count write() calls made to standard output,
+ * the library resolves write() to this definition.
+ */
+extern "C" ssize_t write( int fd_, void const* buf_, size_t count_ ) {
+  if ( ( fd_ == 1 ) && ( writesToTerminal >= 0 ) ) {
+    ++ writesToTerminal;
+  }
+  return ( syscall( SYS_write, fd_, buf_, count_ ) );
+}
+
+namespace {
+
+void highlight_all( std::string const&, replxx::Replxx::colors_t& colors_ ) {
+  for ( replxx::Replxx::Color& c : colors_ ) {
+    c = replxx::Replxx::Color::BRIGHTBLUE;
+  }
+}
+
+/*
+ * Type given keys into replxx running on a pseudo terminal,
+ * return number of write() calls replxx made while reading the line.
+ */
+int writes_for( std::string const& keys_ ) {
+  int master( posix_openpt( O_RDWR | O_NOCTTY ) );
+  EXPECT_GE( master, 0 );
+  EXPECT_EQ( grantpt( master ), 0 );
+  EXPECT_EQ( unlockpt( master ), 0 );
+  int slave( open( ptsname( master ), O_RDWR | O_NOCTTY ) );
+  EXPECT_GE( slave, 0 );
+  winsize ws;
+  ws.ws_row = 25;
+  ws.ws_col = 80;
+  ws.ws_xpixel = ws.ws_ypixel = 0;
+  ioctl( slave, TIOCSWINSZ, &ws );
+  std::thread reader( [master]() {
+    char buf[1024];
+    while ( read( master, buf, sizeof ( buf ) ) > 0 ) {
+    }
+  } );
+  int savedIn( dup( 0 ) );
+  int savedOut( dup( 1 ) );
+  fflush( stdout );
+  dup2( slave, 0 );
+  dup2( slave, 1 );
+  bool ttyIn( replxx::tty::in );
+  bool ttyOut( replxx::tty::out );
+  replxx::tty::in = replxx::tty::out = true;
+  int writes( 0 );
+  {
+    replxx::Replxx rx;
+    rx.set_highlighter_callback( highlight_all );
+    std::string input( keys_ + "\r" );
+    EXPECT_EQ( syscall( SYS_write, master, input.data(), input.length() ), static_cast<long>( input.length() ) );
+    writesToTerminal = 0;
+    rx.input( "> " );
+    writes = writesToTerminal;
+    writesToTerminal = -1;
+  }
+  replxx::tty::in = ttyIn;
+  replxx::tty::out = ttyOut;
+  dup2( savedIn, 0 );
+  dup2( savedOut, 1 );
+  close( savedIn );
+  close( savedOut );
+  close( slave );
+  reader.join();
+  close( master );
+  return ( writes );
+}
+
+}
+
+TEST( terminal_test, one_write_per_keystroke ) {
+  setenv( "TERM", "xterm", 1 );
+  int base( writes_for( "a" ) );
+  /* every key below is followed by a full redraw of the line */
+  EXPECT_EQ( writes_for( "abcdefghij" ) - base, 9 );
+  EXPECT_EQ( writes_for( "abcdefghij\x1b[D\x1b[D\x08\x08" ) - base, 13 );
+}
+
+#endif
@@ -60,11 +60,14 @@ keytab = {
 	"<m-l>": "\033l",
 	"<m-n>": "\033n",
 	"<m-p>": "\033p",
+	"<m-r>": "\033r",
 	"<m-u>": "\033u",
 	"<m-y>": "\033y",
 	"<m-backspace>": "\033\177",
 	"<f1>": "\033OP",
-	"<f2>": "\033OQ"
+	"<f2>": "\033OQ",
+	"<paste>": "\033[200~",
+	"</paste>": "\033[201~"
 }
 
 termseq = {
@@ -73,6 +76,7 @@ termseq = {
 	"\x1b[H": "<mvhm>",
 	"\x1b[2J": "<clr>",
 	"\x1b[J": "<ceos>",
+	"\x1b[K": "<ceol>",
 	"\x1b[0;22;30m": "<black>",
 	"\x1b[0;22;31m": "<red>",
 	"\x1b[0;22;32m": "<green>",
@@ -91,7 +95,10 @@ termseq = {
 	"\x1b[0;1;37m": "<white>",
 	"\x1b[1;32m": "<brightgreen>",
 	"\x1b[101;1;33m": "<err>",
-	"\x07": "<bell>"
+	"\x07": "<bell>",
+	# bracketed paste mode toggles around every input line
+	"\x1b[?2004h": "",
+	"\x1b[?2004l": ""
 }
 colRe = re.compile( "\\x1b\\[(\\d+)G" )
 upRe = re.compile( "\\x1b\\[(\\d+)A" )
@@ -598,6 +605,59 @@ class ReplxxTests( unittest.TestCase ):
 			"fortran\r\n",
 			command = cmd
 		)
+	def test_history_fuzzy_search( self_ ):
+		self_.check_scenario(
+			"<m-r>rpl<down><cr><c-d>",
+			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(fuzzy-search)`': final "
+			"thoughts<c33>\r\n"
+			"> final thoughts\r\n"
+			"  echo repl golf\r\n"
+			"  misc input\r\n"
+			"  charlie repl delta\r\n"
+			"  other request\r\n"
+			"  alfa repl bravo\r\n"
+			"  some command<u7><c33><c1><ceos>(fuzzy-search)`r': echo repl golf<c34>\r\n"
+			"> echo repl golf\r\n"
+			"  alfa repl bravo\r\n"
+			"  charlie repl delta\r\n"
+			"  other request<u4><c34><c1><ceos>(fuzzy-search)`rp': echo repl golf<c35>\r\n"
+			"> echo repl golf\r\n"
+			"  charlie repl delta\r\n"
+			"  alfa repl bravo<u3><c35><c1><ceos>(fuzzy-search)`rpl': echo repl "
+			"golf<c36>\r\n"
+			"> echo repl golf\r\n"
+			"  charlie repl delta\r\n"
+			"  alfa repl bravo<u3><c36><c1><ceos>(fuzzy-search)`rpl': charlie repl "
+			"delta<c40>\r\n"
+			"  echo repl golf\r\n"
+			"> charlie repl delta\r\n"
+			"  alfa repl bravo<u3><c40><c1><ceos><brightgreen>replxx<rst>> charlie repl "
+			"delta<c27><c9><ceos>charlie repl delta<rst><c27>\r\n"
+			"charlie repl delta\r\n",
+			"some command\n"
+			"alfa repl bravo\n"
+			"other request\n"
+			"charlie repl delta\n"
+			"misc input\n"
+			"echo repl golf\n"
+			"final thoughts\n"
+		)
+	def test_history_fuzzy_search_wide( self_ ):
+		self_.check_scenario(
+			"<m-r>x<cr><c-d>",
+			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(fuzzy-search)`': x ascii line that "
+			"is long<c4>\r\n"
+			"> x ascii line that\r\n"
+			"  x 日本語の入力を<u2><c4><u2><c1><ceos>(fuzzy-search)`x': x ascii line that is "
+			"long<c5>\r\n"
+			"> x ascii line that\r\n"
+			"  x 日本語の入力を<u2><c5><u2><c1><ceos><brightgreen>replxx<rst>> x ascii line that "
+			"is long<c14><u1><c9><ceos>x ascii line that is long<rst><c14>\r\n"
+			"x ascii line that is long\r\n",
+			"x 日本語の入力を編集する\n"
+			"x ascii line that is long\n",
+			dimensions = ( 25, 20 )
+		)
 	def test_history_search_backward( self_ ):
 		self_.check_scenario(
 			"<c-r>repl<c-r><cr><c-d>",
@@ -1148,6 +1208,81 @@ class ReplxxTests( unittest.TestCase ):
 			" color_gray color_brightred color_brightgreen color_yellow color_brightblue color_brightmagenta color_brightcyan color_white\n",
 			command = ReplxxTests._cSample_ + " q1 m1"
 		)
+	def test_bracketed_paste( self_ ):
+		self_.check_scenario(
+			"<paste>a\tb \x1b[Dc</paste><cr><c-d>",
+			"<c9><ceos>a b <brightmagenta>[<rst>Dc<rst><gray><rst><c16><c9><ceos>a b "
+			"<brightmagenta>[<rst>Dc<rst><c16>\r\n"
+			"a b [Dc\r\n",
+			"one\n"
+		)
+		self_.check_scenario(
+			"x<paste>first\r\nsecond</paste> third<cr><c-d>",
+			"<c9><ceos>x<rst><gray><rst><c10><c9><ceos>xfirst<rst><c15>\r\n"
+			"xfirst\r\n"
+			"<brightgreen>replxx<rst>> "
+			"<c9><ceos>second<rst><gray><rst><c15><c9><ceos>second "
+			"<rst><gray><rst><c16><c9><ceos>second t<rst><gray><rst><c17><c9><ceos>second "
+			"th<rst><gray><rst><c18><c9><ceos>second "
+			"thi<rst><gray><rst><c19><c9><ceos>second "
+			"thir<rst><gray><rst><c20><c9><ceos>second "
+			"third<rst><gray><rst><c21><c9><ceos>second third<rst><c21>\r\n"
+			"second third\r\n"
+		)
+	def test_bracketed_paste_in_search( self_ ):
+		history = "alfa repl bravo\nsome command\ncharlie repl delta\nother request\n"
+		self_.check_scenario(
+			"<c-r><paste>e r</paste>e<cr><c-d>",
+			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(reverse-i-search)`': "
+			"<c23><c1><ceos>(reverse-i-search)`e r': charlie repl "
+			"delta<c32><c1><ceos>(reverse-i-search)`e re': charlie repl "
+			"delta<c33><c1><ceos><brightgreen>replxx<rst>> charlie repl "
+			"delta<c15><c9><ceos>charlie repl delta<rst><c27>\r\n"
+			"charlie repl delta\r\n",
+			history
+		)
+		self_.check_scenario(
+			"<m-r><paste>lfa</paste><cr><c-d>",
+			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(fuzzy-search)`': other "
+			"request<c32>\r\n"
+			"> other request\r\n"
+			"  charlie repl delta\r\n"
+			"  some command\r\n"
+			"  alfa repl bravo<u4><c32><c1><ceos>(fuzzy-search)`lfa': alfa repl "
+			"bravo<c37>\r\n"
+			"> alfa repl bravo<u1><c37><c1><ceos><brightgreen>replxx<rst>> alfa repl "
+			"bravo<c24><c9><ceos>alfa repl bravo<rst><c24>\r\n"
+			"alfa repl bravo\r\n",
+			history
+		)
+		self_.check_scenario(
+			"a</paste>b<cr><c-d>",
+			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>ab<rst><c11>\r\n"
+			"ab\r\n"
+		)
+	def test_input_coalescing( self_ ):
+		self_.check_scenario(
+			"abc<left><backspace>d<cr><c-d>",
+			"<c9><ceos>adc<rst><c12>\r\n"
+			"adc\r\n",
+			command = ReplxxTests._cSample_ + " q1 l1000"
+		)
+	def test_differential_rendering( self_ ):
+		self_.check_scenario(
+			"abcd<left><left><backspace>x<end>e<cr><c-d>",
+			"<c9><ceos>a<rst><gray><rst><c10>bcd<c12><c11><c10>cd<ceol><c10>xcd<c11><c13>e\r\n"
+			"axcde\r\n",
+			command = ReplxxTests._cSample_ + " q1 r1"
+		)
+		self_.check_scenario(
+			"abcdefghi<home><del><end>j<cr><c-d>",
+			"<c9><ceos>a<rst><gray><rst><c10>bcdefgh\r\n"
+			"i<u1><c9>bcdefghi\r\n"
+			"<ceol><u1><c9>\x1b[1B<c1>j\r\n"
+			"bcdefghij\r\n",
+			command = ReplxxTests._cSample_ + " q1 r1",
+			dimensions = ( 25, 16 )
+		)
 	def test_no_terminal( self_ ):
 		res = subprocess.run( [ ReplxxTests._cSample_, "q1" ], input = b"replxx FTW!\n", stdout = subprocess.PIPE, stderr = subprocess.PIPE )
 		self_.assertSequenceEqual( res.stdout, b"starting...\nreplxx FTW!\n\nExiting Replxx\n" )